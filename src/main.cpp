@@ -4,18 +4,82 @@
 // Single macro to switch between desktop and Allosphere configurations
 #define DESKTOP
 
+// Uncomment to replicate video over UDP multicast instead of the Cuttlebone
+// state, so primary egress stays constant regardless of the replica count
+// #define MULTICAST_VIDEO
+#define MULTICAST_GROUP "239.255.42.99"
+#define MULTICAST_PORT 16001
+#define MULTICAST_FEC_OVERHEAD 0.05f // XOR parity per data chunk, 0 disables FEC
+#define SNAPSHOT_PORT 16002 // TCP: late-joining replicas fetch the latest frame and state
+
+// Uncomment (with MULTICAST_VIDEO) to replicate BC1/DXT1 blocks instead of
+// RGBA: 1/8 of the bytes on the wire, in replica uploads and in VRAM, at the
+// cost of block artifacts. Replicas upload the blocks without decompressing.
+// #define MULTICAST_BC1
+#define MULTICAST_BC1_QUALITY al::BC1Encoder::FAST // HIGH: ~8x slower, fewer artifacts
+
+// Uncomment (with MULTICAST_VIDEO, without MULTICAST_BC1) to send H.264
+// (or al::VideoEncoder::HEVC, MPEG4) over links too slow for RGBA, e.g.
+// 1 GbE: a few MB/s instead of ~500 at 2k, for a few ms of encode and
+// decode, and after a lost packet replicas hold the last picture until the
+// next keyframe. Needs al_replication built with libavcodec, otherwise the
+// primary sends RGBA. Snapshots and shared memory stay RGBA.
+// #define MULTICAST_CODEC al::VideoEncoder::H264
+#define MULTICAST_CODEC_KBPS 20000
+#define MULTICAST_CODEC_KEYFRAME_INTERVAL 60 // frames; bounds the wait after a loss
+
+// Uncomment (with MULTICAST_VIDEO) to also publish frames into a shared-memory
+// ring: replicas on the primary's host (run.sh, multi-GPU boxes) upload
+// straight from it and skip the network; other hosts use multicast
+// #define SHARED_MEMORY_VIDEO
+#define SHARED_MEMORY_NAME "/al_frames_16001"
+
+// Uncomment to feed the primary from a recording instead of the network
+// (record one with NDIVideoReceiverApp, key C)
+// #define NDI_REPLAY_FILE "ndi_capture.alrec"
+
+// Uncomment to composite several NDI sources side by side into the
+// equirectangular canvas instead of showing a single source
+// #define NDI_MOSAIC_SOURCES "Stage Left", "Stage Center", "Stage Right"
+
+// Uncomment to pull NDI video at the render rate through NDI frame sync
+// (repeats or drops frames to absorb clock drift) and mix the source's
+// audio, resampled to the audio device clock, into the primary's output
+// #define NDI_FRAME_SYNC
+
+// Uncomment to pin the render, audio and video I/O threads of this machine
+// (roles and keys in al_ThreadPlacement.hpp), e.g. on a two-socket server
+// with the GPU and NIC on node 0:
+// #define THREAD_PLACEMENT "render:node=0,cpus=0-3; audio:cpus=4,fifo=80; capture:cpus=5,nice=-10; replication_send:cpus=6,nice=-10; replication_receive:cpus=6,nice=-10; encode:node=1"
+
+// Uncomment to time the CPU and GPU stages of every frame (GPU timer queries
+// read back a few frames late, so nothing stalls). P toggles a bar overlay
+// (CPU blue, GPU orange, red line at 60 fps), T writes a Chrome trace
+// (chrome://tracing, Perfetto) to this file; it is also written on exit
+// #define FRAME_PROFILER "frame_trace.json"
+
+// Uncomment to publish every node's pipeline stats (fps, frame generation,
+// upload time, replication lag, dropped frames, queue depths) as OSC
+// messages to the primary, which prints the cluster health table whenever
+// a node turns unhealthy, and on key H. Replicas find the primary through
+// the multicast stream; without MULTICAST_VIDEO set TELEMETRY_HOST.
+// #define TELEMETRY_PORT 16003
+// #define TELEMETRY_HOST "192.168.0.10"
+
 #ifdef DESKTOP
   // Desktop configuration
   #define SAMPLE_RATE 48000
   #define AUDIO_CONFIG SAMPLE_RATE, 128, 2, 8
   #define SPATIALIZER_TYPE al::AmbisonicsSpatializer
   #define SPEAKER_LAYOUT al::StereoSpeakerLayout()
+  #define MULTICAST_INTERFACE "127.0.0.1" // loopback, primary and replicas on one host
 #else
   // Allosphere configuration
   #define SAMPLE_RATE 44100
   #define AUDIO_CONFIG SAMPLE_RATE, 256, 60, 9
   #define SPATIALIZER_TYPE al::Dbap
   #define SPEAKER_LAYOUT al::AlloSphereSpeakerLayoutCompensated()
+  #define MULTICAST_INTERFACE "0.0.0.0" // default route
 #endif
 
 #include "al/app/al_DistributedApp.hpp"
@@ -23,6 +87,34 @@
 #include "al/graphics/al_FBO.hpp"
 #include "al_ext/statedistribution/al_CuttleboneStateSimulationDomain.hpp"
 #include "videoPipe/ndi_wrapping/include/al_ext/ndi/al_NDIReceiver.hpp"
+#include "videoPipe/ndi_wrapping/include/al_ext/ndi/al_NDIRecording.hpp"
+#if defined(NDI_REPLAY_FILE) && defined(_WIN32)
+#error "NDI_REPLAY_FILE needs NDIReplaySource, which is not built on Windows"
+#endif
+#include "videoPipe/ndi_wrapping/include/al_ext/ndi/al_NDIMosaic.hpp"
+#include "videoPipe/ndi_wrapping/include/al_ext/ndi/al_FrameProfiler.hpp"
+#include "videoPipe/ndi_wrapping/include/al_ext/ndi/al_EquirectSphere.hpp"
+#include "al_ext/replication/al_SeqLock.hpp"
+#ifdef THREAD_PLACEMENT
+#include "al_ext/replication/al_ThreadPlacement.hpp"
+#endif
+#ifdef TELEMETRY_PORT
+#include <chrono>
+#include "al_ext/replication/al_Telemetry.hpp"
+#endif
+#ifdef MULTICAST_VIDEO
+#include "al_ext/replication/al_FrameMulticast.hpp"
+#include "al_ext/replication/al_FrameSnapshot.hpp"
+#include "al_ext/replication/al_FrameSharedMemory.hpp"
+#include "al_ext/replication/al_TextureCompression.hpp"
+#include "al_ext/replication/al_VideoCodec.hpp"
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#if defined(MULTICAST_CODEC) && defined(MULTICAST_BC1)
+#error "MULTICAST_CODEC and MULTICAST_BC1 are alternatives, define one"
+#endif
+#endif
 
 // Define a basic state structure to demonstrate distributed functionality
 struct SharedState {
@@ -34,20 +126,94 @@ struct SharedState {
   float cent = 0.0f;         // Cent parameter for shader
   float flux = 0.0f;         // Flux parameter for shader
   bool textureLoaded = false;
+  uint32_t frameGeneration = 0; // advances with every new video frame, 0 = none yet
   int textureWidth = 2048;  // 2k equirectangular width
   int textureHeight = 1024; // 2k equirectangular height
+#ifndef MULTICAST_VIDEO
   unsigned char textureData[2048 * 1024 * 4]; // 2k equirectangular buffer
+#endif
+};
+
+// The part of SharedState read outside onAnimate, without the frame data.
+// onAnimate publishes a copy once the step (or replication) has settled it,
+// so onSound and onDraw never see a half-updated state and never wait.
+struct ControlState {
+  float color = 0.0f;
+  float rotationAngle = 0.0f;
+  int frameCount = 0;
+  float time = 0.0f;
+  float onset = 0.0f;
+  float cent = 0.0f;
+  float flux = 0.0f;
+  bool textureLoaded = false;
 };
 
 struct MyApp: public al::DistributedAppWithState<SharedState> {
-  al::VAOMesh mesh;
+  al::VAOMesh mesh;             // placeholder sphere until the first frame
+  al::EquirectSphere equirect; // draws the video around the viewer
   al::Texture renderTexture;  // For displaying NDI video
   al::RBO rbo;                // Render buffer for depth
   al::FBO fbo;                // Frame buffer object for offscreen rendering
   al::Texture displayTexture; // For secondaries to display received texture
+  al::FBO readbackFBO;        // primary: renderTexture as a read framebuffer
+  al::FBO scaledFBO;          // primary: frames too large for textureData are scaled into this
+  al::Texture scaledTexture;
   bool displayTextureCreated = false;
+  uint32_t displayGeneration = 0; // frame generation currently in displayTexture
   al::NDIReceiver ndiReceiver; // NDI receiver for primary
+#ifdef NDI_REPLAY_FILE
+  al::NDIReplaySource ndiReplay; // recorded stand-in for ndiReceiver
+#endif
+#ifdef NDI_MOSAIC_SOURCES
+  std::vector<std::unique_ptr<al::NDIReceiver>> mosaicReceivers;
+  al::NDIMosaic mosaic; // composites mosaicReceivers into renderTexture
+#endif
+  al::NDIFrameSource* videoSource = &ndiReceiver;
+  al::SeqLock<ControlState> control; // written at the end of onAnimate
+  ControlState drawControl;          // onDraw's copy of control
+  ControlState audioControl;         // onSound's copy, kept while a load overlaps a store
   std::shared_ptr<al::CuttleboneStateSimulationDomain<SharedState, 8000>> cuttleboneDomain;
+#ifdef MULTICAST_VIDEO
+  al::FrameMulticastSender frameSender;     // primary: publishes video frames
+  al::FrameMulticastReceiver frameReceiver; // replicas: reassembles video frames
+  std::vector<unsigned char> frameBuffer;   // primary readback buffer
+  al::BC1Encoder bc1Encoder;                // primary: compresses frameBuffer
+  std::vector<unsigned char> bc1Buffer;     // primary: BC1 blocks of frameBuffer
+#ifdef MULTICAST_CODEC
+  al::VideoEncoder videoEncoder;            // primary: compresses frameBuffer
+  al::VideoEncoder::Packet videoPacket;     // primary: coded frame being published
+  al::VideoDecoder videoDecoder;            // replicas: decodes the coded frames
+#endif
+  uint32_t displayFormat = 0;               // replicas: ReplicatedFrame::Format of displayTexture
+  al::FrameSnapshotServer snapshotServer;   // primary: latest frame and state for late joiners
+  al::FrameSnapshotClient snapshotClient;   // replicas: fetches them on joining
+  bool snapshotRequested = false;
+  al::SharedFrameWriter sharedWriter;       // primary: same-host frame ring
+  al::SharedFrameReader sharedReader;       // replicas on the primary's host
+  // Shader parameters of the frame, replicated with its pixels rather than
+  // through the free-running state; on replicas those of displayGeneration
+  al::NDIFrameParams frameParams;
+  char frameMetadata[1024];                 // primary: frameParams as XML
+#endif
+#ifdef NDI_FRAME_SYNC
+  std::vector<float> ndiAudio[2];          // primary: NDI audio per output channel
+#endif
+#ifdef THREAD_PLACEMENT
+  al::ThreadPlacementConfig threadPlacement;
+  bool audioPlaced = false; // onSound has applied the audio placement
+#endif
+#ifdef FRAME_PROFILER
+  al::FrameProfiler frameProfiler;
+  bool showProfiler = false;
+#endif
+  al::FrameProfiler* profiler = nullptr; // null unless FRAME_PROFILER, scopes are then no-ops
+#ifdef TELEMETRY_PORT
+  al::TelemetryPublisher telemetry;         // every node: sends telemetrySample
+  al::TelemetryAggregator clusterHealth;    // primary: collects every node's telemetry
+  al::TelemetrySample telemetrySample;
+  int unhealthyNodes = 0;                   // primary: last count reported
+  bool telemetryRouted = false;             // replicas: sending to the primary's address
+#endif
 
   void onInit() override { // Called on app start
     std::cout << "onInit() - " << (isPrimary() ? "Primary" : "Replica") << " instance" << std::endl;
@@ -57,26 +223,187 @@ struct MyApp: public al::DistributedAppWithState<SharedState> {
       std::cerr << "ERROR: Could not start Cuttlebone. Quitting." << std::endl;
       quit();
     }
+#ifdef THREAD_PLACEMENT
+    if (!threadPlacement.parse(THREAD_PLACEMENT)) {
+      std::cerr << "ERROR: Invalid THREAD_PLACEMENT, using the default scheduling" << std::endl;
+    }
+#endif
+#ifdef TELEMETRY_PORT
+    {
+      al::TelemetryPublisher::Config config;
+      config.port = TELEMETRY_PORT;
+#ifdef TELEMETRY_HOST
+      if (!isPrimary()) config.host = TELEMETRY_HOST;
+#endif
+      telemetry.init(config);
+      telemetrySample.role = isPrimary() ? al::TelemetrySample::PRIMARY : al::TelemetrySample::REPLICA;
+      if (isPrimary()) {
+        al::TelemetryAggregator::Config healthConfig;
+        healthConfig.port = TELEMETRY_PORT;
+        if (!clusterHealth.init(healthConfig)) {
+          std::cerr << "ERROR: Could not start telemetry aggregator" << std::endl;
+        }
+      }
+    }
+#endif
+#ifdef MULTICAST_VIDEO
+    if (isPrimary()) {
+      al::FrameMulticastSender::Config config;
+      config.group = MULTICAST_GROUP;
+      config.port = MULTICAST_PORT;
+      config.interfaceAddress = MULTICAST_INTERFACE;
+      config.fecOverhead = MULTICAST_FEC_OVERHEAD;
+#ifdef THREAD_PLACEMENT
+      config.placement = threadPlacement[al::ThreadPlacementConfig::REPLICATION_SEND];
+#endif
+      if (!frameSender.init(config)) {
+        std::cerr << "ERROR: Could not start multicast video sender" << std::endl;
+      }
+      al::FrameSnapshotServer::Config snapshotConfig;
+      snapshotConfig.port = SNAPSHOT_PORT;
+      snapshotConfig.interfaceAddress = MULTICAST_INTERFACE;
+#ifdef THREAD_PLACEMENT
+      snapshotConfig.placement = threadPlacement[al::ThreadPlacementConfig::REPLICATION_SEND];
+#endif
+      if (!snapshotServer.init(snapshotConfig)) {
+        std::cerr << "ERROR: Could not start snapshot server, late replicas wait for the stream" << std::endl;
+      }
+#ifdef SHARED_MEMORY_VIDEO
+      al::SharedFrameWriter::Config sharedConfig;
+      sharedConfig.name = SHARED_MEMORY_NAME;
+      if (!sharedWriter.init(sharedConfig)) {
+        std::cerr << "ERROR: Could not create shared frame ring, local replicas use multicast" << std::endl;
+      }
+#endif
+#ifdef MULTICAST_BC1
+      al::BC1Encoder::Config bc1Config;
+      bc1Config.quality = MULTICAST_BC1_QUALITY;
+#ifdef THREAD_PLACEMENT
+      bc1Config.placement = threadPlacement[al::ThreadPlacementConfig::ENCODE];
+#endif
+      bc1Encoder.init(bc1Config);
+#endif
+#ifdef MULTICAST_CODEC
+      al::VideoEncoder::Config codecConfig;
+      codecConfig.codec = MULTICAST_CODEC;
+      codecConfig.bitrateKbps = MULTICAST_CODEC_KBPS;
+      codecConfig.keyframeInterval = MULTICAST_CODEC_KEYFRAME_INTERVAL;
+#ifdef THREAD_PLACEMENT
+      codecConfig.placement = threadPlacement[al::ThreadPlacementConfig::ENCODE];
+#endif
+      if (!videoEncoder.init(codecConfig)) {
+        std::cerr << "ERROR: Could not start video encoder, sending RGBA" << std::endl;
+      }
+#endif
+    } else {
+      bool local = false;
+#ifdef SHARED_MEMORY_VIDEO
+      al::SharedFrameReader::Config sharedConfig;
+      sharedConfig.name = SHARED_MEMORY_NAME;
+      local = sharedReader.init(sharedConfig);
+      if (local) {
+        std::cout << "Primary is on this host, reading frames from shared memory" << std::endl;
+      }
+#endif
+      al::FrameMulticastReceiver::Config config;
+      config.group = MULTICAST_GROUP;
+      config.port = MULTICAST_PORT;
+      config.interfaceAddress = MULTICAST_INTERFACE;
+#ifdef THREAD_PLACEMENT
+      config.placement = threadPlacement[al::ThreadPlacementConfig::REPLICATION_RECEIVE];
+#endif
+#ifdef MULTICAST_CODEC
+      // Every coded frame must reach the decoder in order, not just the
+      // latest one, so they are handed over on the receive thread
+      al::VideoDecoder::Config codecConfig;
+#ifdef THREAD_PLACEMENT
+      codecConfig.placement = threadPlacement[al::ThreadPlacementConfig::ENCODE];
+#endif
+      if (!local && !videoDecoder.init(codecConfig)) {
+        std::cerr << "ERROR: Could not start video decoder, only RGBA frames are shown" << std::endl;
+      }
+      frameReceiver.frameHandler([this](const al::ReplicatedFrame& frame) {
+        if (frame.format == al::ReplicatedFrame::VIDEO) videoDecoder.submit(frame);
+      });
+#endif
+      if (!local && !frameReceiver.init(config)) {
+        std::cerr << "ERROR: Could not join multicast video group" << std::endl;
+      }
+    }
+#endif
   }
 
   void onCreate() override { // Called when graphics context is available
     std::cout << "onCreate()" << std::endl;
-    // Create a textured sphere mesh for equirectangular mapping
-    al::addTexSphere(mesh, 1.0f, 64, true); // radius 1, 64 bands, skybox mode for proper orientation
+#ifdef THREAD_PLACEMENT
+    // onCreate runs on the render thread; frame buffers allocated from here
+    // on come from the render node
+    threadPlacement.apply(al::ThreadPlacementConfig::RENDER);
+#endif
+#ifdef FRAME_PROFILER
+    if (frameProfiler.init()) {
+      profiler = &frameProfiler;
+    }
+#endif
+    // The video is looked up per pixel from the view direction on a coarse
+    // proxy, so neither it nor the placeholder needs a dense mesh
+    if (!equirect.init()) {
+      std::cerr << "ERROR: Could not create the equirectangular sphere shader" << std::endl;
+    }
+    al::addSphere(mesh, 1.0, 16, 16);
     mesh.update();
 
+#ifdef NDI_REPLAY_FILE
+    if (isPrimary() && ndiReplay.open(NDI_REPLAY_FILE)) {
+      ndiReplay.loop(true);
+      videoSource = &ndiReplay;
+      std::cout << "Replaying " << ndiReplay.frameCount() << " NDI frames from "
+                << NDI_REPLAY_FILE << std::endl;
+    }
+#endif
+
+#ifdef NDI_MOSAIC_SOURCES
+    if (isPrimary() && mosaic.init(state().textureWidth, state().textureHeight)) {
+      const char* names[] = { NDI_MOSAIC_SOURCES };
+      int count = sizeof(names) / sizeof(names[0]);
+      for (int i = 0; i < count; i++) {
+        mosaicReceivers.emplace_back(new al::NDIReceiver());
+        al::NDIReceiver& receiver = *mosaicReceivers.back();
+        if (receiver.init()) {
+#ifdef THREAD_PLACEMENT
+          receiver.setThreadStart([this] { threadPlacement.apply(al::ThreadPlacementConfig::CAPTURE); });
+#endif
+          receiver.connectAsync(names[i]);
+        }
+        // Equal slices of longitude, full height
+        mosaic.addInput(&receiver, al::NDIMosaic::Region(float(i) / count, 0.0f, 1.0f / count, 1.0f));
+      }
+      videoSource = &mosaic;
+      std::cout << "Compositing " << count << " NDI sources" << std::endl;
+    }
+#endif
+
+#ifdef NDI_FRAME_SYNC
+    // Sized once here: onSound runs on the audio thread and must not allocate
+    ndiAudio[0].assign(audioIO().framesPerBuffer(), 0.0f);
+    ndiAudio[1].assign(audioIO().framesPerBuffer(), 0.0f);
+#endif
+
     // Initialize NDI receiver on primary
-    if (isPrimary()) {
+    if (isPrimary() && videoSource == &ndiReceiver) {
       if (!ndiReceiver.init()) {
         std::cerr << "Failed to initialize NDI receiver" << std::endl;
       } else {
         std::cout << "NDI receiver initialized" << std::endl;
-        // Try to connect to first available source
-        if (!ndiReceiver.connect()) {
-          std::cout << "No NDI sources found or failed to connect" << std::endl;
-        } else {
-          std::cout << "Connected to NDI source" << std::endl;
-        }
+        // Connect to the first available source in the background; the
+        // receiver reconnects by itself if the source drops
+#ifdef NDI_FRAME_SYNC
+        ndiReceiver.frameSync(true);
+#endif
+#ifdef THREAD_PLACEMENT
+        ndiReceiver.setThreadStart([this] { threadPlacement.apply(al::ThreadPlacementConfig::CAPTURE); });
+#endif
+        ndiReceiver.connectAsync();
       }
     }
 
@@ -96,6 +423,7 @@ struct MyApp: public al::DistributedAppWithState<SharedState> {
   }
 
   void onAnimate(double dt) override { // Called once before drawing
+    if (profiler) profiler->beginFrame(); // ended after the draw in onDraw
     // Primary instance updates the shared state
     if (cuttleboneDomain->isSender()) {
       state().color += 0.01f;
@@ -112,83 +440,431 @@ struct MyApp: public al::DistributedAppWithState<SharedState> {
       state().flux = sin(state().time * 0.7f) * 0.5f + 0.5f;
 
       // Update texture with NDI video
-      if (ndiReceiver.update(renderTexture)) {
+      bool newFrame;
+      {
+        al::FrameProfiler::Scope scope(profiler, "video update");
+        newFrame = videoSource->update(renderTexture);
+      }
+      if (newFrame) {
         // Update state dimensions to match the texture
         state().textureWidth = renderTexture.width();
         state().textureHeight = renderTexture.height();
+        state().frameGeneration = videoSource->generation();
+
+        // Parameters the sender attached to this frame win over the
+        // free-running ones, keeping them in step with the pixels
+        const al::NDIFrameParams& sourceParams = videoSource->frameParams();
+        state().onset = sourceParams.get("onset", state().onset);
+        state().cent = sourceParams.get("cent", state().cent);
+        state().flux = sourceParams.get("flux", state().flux);
         
         // Read texture data from GPU to CPU for transmission
-        renderTexture.bind();
-        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, state().textureData);
-        renderTexture.unbind();
+#ifdef MULTICAST_VIDEO
+        frameBuffer.resize(size_t(state().textureWidth) * state().textureHeight * 4);
+        unsigned char* pixels = frameBuffer.data();
+#if defined(SHARED_MEMORY_VIDEO) && !defined(MULTICAST_BC1)
+        // Read back straight into the shared ring; the multicast sender
+        // copies from there too
+        unsigned char* slot = sharedWriter.beginFrame(frameBuffer.size());
+        if (slot) pixels = slot;
+#endif
+#else
+        unsigned char* pixels = state().textureData;
+        // textureData is fixed at 2048x1024; scale larger frames down on the
+        // GPU, keeping the aspect ratio, instead of overrunning it
+        size_t maxPixels = sizeof(state().textureData) / 4;
+        if (size_t(state().textureWidth) * state().textureHeight > maxPixels) {
+          float scale = sqrtf(float(maxPixels) / (float(state().textureWidth) * state().textureHeight));
+          state().textureWidth = std::max(1, int(state().textureWidth * scale));
+          state().textureHeight = std::max(1, int(state().textureHeight * scale));
+        }
+#endif
+        {
+          al::FrameProfiler::Scope scope(profiler, "readback");
+#ifdef TELEMETRY_PORT
+          auto readbackStart = std::chrono::steady_clock::now();
+#endif
+          if (state().textureWidth == int(renderTexture.width()) &&
+              state().textureHeight == int(renderTexture.height())) {
+            renderTexture.bind();
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            renderTexture.unbind();
+          } else {
+            readScaled(pixels, state().textureWidth, state().textureHeight);
+          }
+#ifdef TELEMETRY_PORT
+          telemetrySample.uploadMs = std::chrono::duration<float, std::milli>(
+              std::chrono::steady_clock::now() - readbackStart).count();
+#endif
+        }
+#ifdef MULTICAST_VIDEO
+        al::FrameProfiler::Scope publishScope(profiler, "publish");
+        frameParams.clear();
+        frameParams.set("onset", state().onset);
+        frameParams.set("cent", state().cent);
+        frameParams.set("flux", state().flux);
+        size_t metadataBytes = frameParams.toXml(frameMetadata, sizeof(frameMetadata));
+        const uint8_t* metadata = (const uint8_t*)frameMetadata;
+#ifdef MULTICAST_BC1
+        bc1Buffer.resize(al::bc1Bytes(state().textureWidth, state().textureHeight));
+        bc1Encoder.encode(pixels, state().textureWidth, state().textureHeight, bc1Buffer.data());
+        frameSender.publish(bc1Buffer.data(), bc1Buffer.size(), state().textureWidth, state().textureHeight,
+                            al::ReplicatedFrame::BC1, state().frameGeneration, 0, metadata, metadataBytes);
+#ifdef SHARED_MEMORY_VIDEO
+        sharedWriter.publish(bc1Buffer.data(), bc1Buffer.size(), state().textureWidth, state().textureHeight,
+                             al::ReplicatedFrame::BC1, state().frameGeneration, 0, metadata, metadataBytes);
+#endif
+        snapshotServer.updateFrame(bc1Buffer.data(), bc1Buffer.size(), state().textureWidth, state().textureHeight,
+                                   al::ReplicatedFrame::BC1, state().frameGeneration, 0, metadata, metadataBytes);
+#else
+#ifdef MULTICAST_CODEC
+        // Picked up and published once coded, below
+        bool coded = videoEncoder.isInitialized();
+        if (coded) {
+          videoEncoder.submit(pixels, state().textureWidth, state().textureHeight, state().frameGeneration,
+                              0, metadata, metadataBytes);
+        }
+#else
+        bool coded = false;
+#endif
+        if (!coded) {
+          frameSender.publish(pixels, frameBuffer.size(), state().textureWidth, state().textureHeight,
+                              al::ReplicatedFrame::RGBA8, state().frameGeneration, 0, metadata, metadataBytes);
+        }
+        snapshotServer.updateFrame(pixels, frameBuffer.size(), state().textureWidth, state().textureHeight,
+                                   al::ReplicatedFrame::RGBA8, state().frameGeneration, 0, metadata, metadataBytes);
+#ifdef SHARED_MEMORY_VIDEO
+        if (slot) {
+          sharedWriter.commitFrame(state().textureWidth, state().textureHeight,
+                                   al::ReplicatedFrame::RGBA8, state().frameGeneration, 0, metadata, metadataBytes);
+        }
+#endif
+#endif
+#endif
+        // Mips for the sphere draw, once per new frame
+        equirect.frameUploaded(renderTexture.id(), state().frameGeneration);
         
         state().textureLoaded = true;
         std::cout << "Primary received NDI frame " << state().frameCount << " (" 
                   << state().textureWidth << "x" << state().textureHeight 
                   << ") and prepared for transmission" << std::endl;
       }
+#ifdef MULTICAST_VIDEO
+      snapshotServer.updateState(&state(), sizeof(SharedState));
+#endif
+#ifdef MULTICAST_CODEC
+      // At most one coded frame per step, see VideoEncoder::receive
+      if (videoEncoder.receive(videoPacket)) {
+        frameSender.publish(videoPacket.data.data(), videoPacket.data.size(), videoPacket.width, videoPacket.height,
+                            al::ReplicatedFrame::VIDEO, videoPacket.generation, videoPacket.timestampNs,
+                            videoPacket.metadata.data(), videoPacket.metadata.size());
+      }
+      if (videoEncoder.isInitialized() && state().frameCount % 600 == 0) {
+        al::VideoEncoder::Stats stats = videoEncoder.stats();
+        std::cout << "Video encoder: " << stats.bitrateMbps << " Mbit/s, " << stats.latencyMs << " ms latency, "
+                  << stats.framesDropped << " dropped, " << stats.keyframes << " keyframes" << std::endl;
+      }
+#endif
+#ifdef SHARED_MEMORY_VIDEO
+      sharedWriter.heartbeat(); // local replicas keep using the ring while the video is paused
+#endif
     }
     // Replicas automatically receive the updated state
+#ifdef MULTICAST_VIDEO
+    else {
+      // Late join: as soon as the stream reveals the primary's address, ask
+      // it for its latest frame and state, so a replica started mid-show
+      // does not wait to assemble a frame from multicast
+      if (!snapshotRequested && displayGeneration == 0) {
+        std::string primary = frameReceiver.senderAddress();
+        if (!primary.empty()) {
+          al::FrameSnapshotClient::Config config;
+          config.host = primary;
+          config.port = SNAPSHOT_PORT;
+          snapshotRequested = snapshotClient.request(config);
+        }
+      }
+      al::ReplicatedFrame snapshot;
+      if (snapshotClient.latestFrame(snapshot) && displayGeneration == 0) {
+        if (snapshotClient.state().size() == sizeof(SharedState)) {
+          memcpy(&state(), snapshotClient.state().data(), sizeof(SharedState));
+        }
+        showFrame(snapshot);
+        std::cout << "Late join: snapshot frame " << snapshot.generation << " after "
+                  << snapshotClient.fetchMs() << " ms" << std::endl;
+      }
+#ifdef MULTICAST_CODEC
+      if (videoDecoder.isInitialized() && state().frameCount % 600 == 0) {
+        al::VideoDecoder::Stats stats = videoDecoder.stats();
+        std::cout << "Video decoder: " << stats.bitrateMbps << " Mbit/s, " << stats.latencyMs << " ms latency, "
+                  << stats.packetsSkipped << " skipped waiting for keyframes" << std::endl;
+      }
+#endif
+    }
+#endif
+#ifdef TELEMETRY_PORT
+    publishTelemetry(dt);
+#endif
+    publishControl();
   } 
 
+  // Hands this frame's control state to onDraw and the audio thread
+  void publishControl() {
+    ControlState c;
+    c.color = state().color;
+    c.rotationAngle = state().rotationAngle;
+    c.frameCount = state().frameCount;
+    c.time = state().time;
+    c.onset = state().onset;
+    c.cent = state().cent;
+    c.flux = state().flux;
+    c.textureLoaded = state().textureLoaded;
+    control.store(c);
+  }
+
+#ifdef MULTICAST_VIDEO
+  // Replicas: the parameters that arrived with the displayed frame win over
+  // the published state's, which run free of the pixels; frames without
+  // metadata keep the state's values
+  void applyFrameParams(ControlState& c) const {
+    c.onset = frameParams.get("onset", c.onset);
+    c.cent = frameParams.get("cent", c.cent);
+    c.flux = frameParams.get("flux", c.flux);
+  }
+#endif
+
+#ifdef TELEMETRY_PORT
+  // Hands this frame's numbers to the telemetry thread; on the primary also
+  // reports the cluster whenever the number of unhealthy nodes changes
+  void publishTelemetry(double dt) {
+    if (dt > 0.0) {
+      float fps = float(1.0 / dt);
+      telemetrySample.fps = telemetrySample.fps > 0.0f ? telemetrySample.fps + 0.05f * (fps - telemetrySample.fps) : fps;
+    }
+#ifdef MULTICAST_VIDEO
+    if (isPrimary()) {
+      al::FrameMulticastSender::Stats stats = frameSender.stats();
+      telemetrySample.frameGeneration = state().frameGeneration;
+      telemetrySample.framesDropped = uint32_t(stats.framesSuperseded);
+      telemetrySample.sendQueue = stats.framesPending;
+    } else {
+      al::FrameMulticastReceiver::Stats stats = frameReceiver.stats();
+      telemetrySample.frameGeneration = displayGeneration;
+      telemetrySample.framesDropped = uint32_t(stats.framesDropped);
+      telemetrySample.receiveQueue = stats.framesAssembling;
+#ifndef TELEMETRY_HOST
+      // The primary is wherever the video comes from
+      if (!telemetryRouted) {
+        std::string primary = frameReceiver.senderAddress();
+        telemetryRouted = !primary.empty() && telemetry.destination(primary);
+      }
+#endif
+    }
+#else
+    telemetrySample.frameGeneration = isPrimary() ? state().frameGeneration : displayGeneration;
+#endif
+    telemetry.update(telemetrySample);
+
+    if (isPrimary() && clusterHealth.isInitialized() && state().frameCount % 60 == 0) {
+      int unhealthy = clusterHealth.unhealthyCount();
+      if (unhealthy != unhealthyNodes) {
+        std::cout << unhealthy << " unhealthy node(s)\n" << clusterHealth.report() << std::flush;
+        unhealthyNodes = unhealthy;
+      }
+    }
+  }
+#endif
+
+#ifdef MULTICAST_VIDEO
+  // Replicas: uploads a replicated frame into displayTexture
+  void showFrame(const al::ReplicatedFrame& frame) {
+    al::FrameProfiler::Scope scope(profiler, "texture submit");
+#ifdef TELEMETRY_PORT
+    auto uploadStart = std::chrono::steady_clock::now();
+#endif
+    bool compressed = frame.format == al::ReplicatedFrame::BC1;
+    if (!displayTextureCreated ||
+        displayTexture.width() != frame.width ||
+        displayTexture.height() != frame.height ||
+        displayFormat != frame.format) {
+      displayTexture.create2D(frame.width, frame.height,
+                              compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8);
+      displayTextureCreated = true;
+      displayFormat = frame.format;
+      std::cout << "Secondary display texture created/resized to "
+                << frame.width << "x" << frame.height << (compressed ? " BC1" : "") << std::endl;
+    }
+    if (compressed) {
+      displayTexture.bind();
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.width, frame.height,
+                                GL_COMPRESSED_RGB_S3TC_DXT1_EXT, (GLsizei)frame.bytes, frame.data);
+      displayTexture.unbind();
+    } else {
+      displayTexture.submit(frame.data, GL_RGBA, GL_UNSIGNED_BYTE);
+    }
+    displayGeneration = frame.generation;
+    equirect.frameUploaded(displayTexture.id(), frame.generation, compressed);
+    if (!frame.metadata || !frameParams.fromXml((const char*)frame.metadata, frame.metadataBytes)) {
+      frameParams.clear();
+    }
+#ifdef TELEMETRY_PORT
+    telemetrySample.uploadMs = std::chrono::duration<float, std::milli>(
+        std::chrono::steady_clock::now() - uploadStart).count();
+    telemetrySample.replicationLagMs = (al::frameClockNs() - frame.timestampNs) / 1e6f;
+#endif
+  }
+#endif
+
+  // Blits renderTexture into a width x height texture and reads that back
+  void readScaled(unsigned char* pixels, int width, int height) {
+    if (scaledTexture.width() != unsigned(width) || scaledTexture.height() != unsigned(height)) {
+      scaledTexture.create2D(width, height);
+      scaledFBO.bind();
+      scaledFBO.attachTexture2D(scaledTexture);
+      scaledFBO.unbind();
+    }
+    readbackFBO.bind();
+    readbackFBO.attachTexture2D(renderTexture);
+    readbackFBO.unbind();
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readbackFBO.id());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scaledFBO.id());
+    glBlitFramebuffer(0, 0, renderTexture.width(), renderTexture.height(), 0, 0, width, height,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, scaledFBO.id());
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
   void onDraw(al::Graphics& g) override { // Draw function  
-    g.clear(state().color); 
+    control.load(drawControl);
+    g.clear(drawControl.color); 
     
     // Enable depth testing for proper 3D rendering
     al::gl::depthTesting(true);
     
     // Display texture if available
-    if (state().textureLoaded) {
+    if (drawControl.textureLoaded) {
       g.pushMatrix();
       // For primary: display the local renderTexture
       if (cuttleboneDomain->isSender()) {
-        renderTexture.bind(0);
-        g.texture();
-        g.draw(mesh);
-        renderTexture.unbind(0);
+        al::FrameProfiler::Scope scope(profiler, "sphere draw");
+        drawEquirect(g, renderTexture);
       } else {
-        // For secondaries: display texture from received state data
-        // Recreate texture if dimensions changed
-        if (!displayTextureCreated || 
-            displayTexture.width() != state().textureWidth || 
-            displayTexture.height() != state().textureHeight) {
-          displayTexture.create2D(state().textureWidth, state().textureHeight);
-          displayTextureCreated = true;
-          std::cout << "Secondary display texture created/resized to " 
-                    << state().textureWidth << "x" << state().textureHeight << std::endl;
+#ifdef MULTICAST_VIDEO
+        // For secondaries: upload the latest frame reassembled from multicast
+        // Only a frame of a different generation is uploaded; != rather than
+        // newer so a restarted primary (generation back at 1) is picked up:
+        // the receiver starts over on its new session (ReplicationBench restart)
+        al::ReplicatedFrame frame;
+        bool received = frameReceiver.latestFrame(frame);
+#ifdef MULTICAST_CODEC
+        // Coded frames went to the decoder through frameHandler
+        if (received && frame.format == al::ReplicatedFrame::VIDEO) received = false;
+        received = videoDecoder.latestFrame(frame) || received;
+#endif
+#ifdef SHARED_MEMORY_VIDEO
+        // Same host as the primary: upload straight from the shared pages
+        received = sharedReader.latestFrame(frame) || received;
+#endif
+        if (received && frame.generation != displayGeneration) {
+          showFrame(frame);
+        }
+        applyFrameParams(drawControl);
+#else
+        // For secondaries: display texture from received state data,
+        // uploading only when the primary has published a new frame
+        if (state().frameGeneration != displayGeneration) {
+          al::FrameProfiler::Scope scope(profiler, "texture submit");
+          // Recreate texture if dimensions changed
+          if (!displayTextureCreated || 
+              displayTexture.width() != state().textureWidth || 
+              displayTexture.height() != state().textureHeight) {
+            displayTexture.create2D(state().textureWidth, state().textureHeight);
+            displayTextureCreated = true;
+            std::cout << "Secondary display texture created/resized to " 
+                      << state().textureWidth << "x" << state().textureHeight << std::endl;
+          }
+#ifdef TELEMETRY_PORT
+          auto uploadStart = std::chrono::steady_clock::now();
+#endif
+          displayTexture.submit(state().textureData, GL_RGBA, GL_UNSIGNED_BYTE);
+          displayGeneration = state().frameGeneration;
+          equirect.frameUploaded(displayTexture.id(), displayGeneration);
+#ifdef TELEMETRY_PORT
+          telemetrySample.uploadMs = std::chrono::duration<float, std::milli>(
+              std::chrono::steady_clock::now() - uploadStart).count();
+#endif
         }
-        displayTexture.submit(state().textureData, GL_RGBA, GL_UNSIGNED_BYTE);
-        displayTexture.bind(0);
-        g.texture();
-        g.draw(mesh);
-        displayTexture.unbind(0);
+#endif
+        al::FrameProfiler::Scope scope(profiler, "sphere draw");
+        drawEquirect(g, displayTexture);
       }
       g.popMatrix();
     } else {
       // Draw a simple sphere when no texture is loaded
       g.pushMatrix();
-      g.rotate(state().rotationAngle, 0, 0, 1);
-      g.color(1.0f - state().color, 0.5f, state().color);
+      g.rotate(drawControl.rotationAngle, 0, 0, 1);
+      g.color(1.0f - drawControl.color, 0.5f, drawControl.color);
       g.draw(mesh);
       g.popMatrix();
     }
     
     // Display instance type and frame count
     std::string info = cuttleboneDomain->isSender() ? "SENDER - Frame: " : "RECEIVER - Frame: ";
-    info += std::to_string(state().frameCount);
+    info += std::to_string(drawControl.frameCount);
     // Note: Text rendering would require additional setup, so we'll skip it for this basic demo
+#ifdef FRAME_PROFILER
+    if (profiler && showProfiler) {
+      al::FrameProfiler::Scope scope(profiler, "overlay");
+      profiler->drawOverlay();
+    }
+#endif
+    if (profiler) profiler->endFrame();
+  }
+
+  // Draws tex around the viewer with the current model, view and projection
+  void drawEquirect(al::Graphics& g, al::Texture& tex) {
+    al::Mat4f modelViewProjection = g.projMatrix() * g.viewMatrix() * g.modelMatrix();
+    equirect.draw(tex.id(), modelViewProjection.elems());
   }
 
   void onSound(al::AudioIOData& io) override { // Audio callback  
     static float phase = 0.0f;
     float sampleRate = io.framesPerSecond();
+#ifdef THREAD_PLACEMENT
+    if (!audioPlaced) {
+      threadPlacement.apply(al::ThreadPlacementConfig::AUDIO);
+      audioPlaced = true;
+    }
+#endif
+#ifdef NDI_FRAME_SYNC
+    // Buffers are sized in onCreate; a larger block than that is mixed
+    // only up to their size. captureAudio returns silence while
+    // disconnected and never blocks
+    bool mixNDI = isPrimary() && videoSource == &ndiReceiver;
+    int ndiFrames = 0;
+    if (mixNDI) {
+      ndiFrames = std::min((int)io.framesPerBuffer(), (int)ndiAudio[0].size());
+      float* channels[2] = { ndiAudio[0].data(), ndiAudio[1].data() };
+      ndiReceiver.captureAudio(channels, 2, ndiFrames, (int)sampleRate);
+    }
+#endif
+    // Wait-free; if the simulation is mid-store, the previous values are used
+    control.load(audioControl);
+    // Generate a simple tone based on the shared color value
+    float freq = 220.0f + (audioControl.color * 440.0f);
     while (io()) {    
-      // Generate a simple tone based on the shared color value
-      float freq = 220.0f + (state().color * 440.0f);
       float sample = sinf(phase) * 0.1f;
       phase += M_2PI * freq / sampleRate;
       if (phase > M_2PI) phase -= M_2PI;
       io.out(0) = io.out(1) = sample;
+#ifdef NDI_FRAME_SYNC
+      if ((int)io.frame() < ndiFrames) {
+        io.out(0) += ndiAudio[0][io.frame()];
+        io.out(1) += ndiAudio[1][io.frame()];
+      }
+#endif
     }
   }
 
@@ -204,9 +880,35 @@ struct MyApp: public al::DistributedAppWithState<SharedState> {
         state().frameCount = 0;
       }
     }
+#ifdef TELEMETRY_PORT
+    if (isPrimary() && k.key() == 'h') {
+      std::cout << clusterHealth.report() << std::flush;
+    }
+#endif
+#ifdef FRAME_PROFILER
+    if (profiler && k.key() == 'p') {
+      showProfiler = !showProfiler;
+      std::cout << profiler->report();
+      profiler->resetPeaks();
+    }
+    if (profiler && k.key() == 't') {
+      if (profiler->writeChromeTrace(FRAME_PROFILER)) {
+        std::cout << "Frame trace written to " << FRAME_PROFILER << std::endl;
+      }
+    }
+#endif
     return true;
   }
 
+  void onExit() override {
+#ifdef FRAME_PROFILER
+    if (profiler) {
+      std::cout << profiler->report();
+      profiler->writeChromeTrace(FRAME_PROFILER);
+    }
+#endif
+  }
+
 };
 
 int main() {
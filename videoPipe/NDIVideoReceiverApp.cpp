@@ -4,12 +4,18 @@
 #include "al/app/al_App.hpp"
 #include "al/graphics/al_Shapes.hpp"
 #include "al_ext/ndi/al_NDIReceiver.hpp"
+#ifndef _WIN32
+#include "al_ext/ndi/al_NDIRecording.hpp"
+#endif
 
 using namespace al;
 using namespace std;
 
 struct NDIVideoReceiverApp : public App {
     NDIReceiver ndiReceiver;
+#ifndef _WIN32
+    NDIRecorder recorder; // not built on Windows
+#endif
     Texture receivedTexture;
     vector<Source> availableSources;
     int selectedSourceIndex = -1;
@@ -79,6 +85,9 @@ struct NDIVideoReceiverApp : public App {
             if (frameReceived) {
                 statusMessage = "Receiving: " + to_string(receivedTexture.width()) + "x" +
                               to_string(receivedTexture.height());
+            } else if (connected && !ndiReceiver.isConnected()) {
+                statusMessage = "Reconnecting (showing last frame): " + to_string(receivedTexture.width()) + "x" +
+                              to_string(receivedTexture.height());
             } else {
                 statusMessage = "Connected (no new frame): " + to_string(receivedTexture.width()) + "x" +
                               to_string(receivedTexture.height());
@@ -97,6 +106,10 @@ struct NDIVideoReceiverApp : public App {
             if (connected) {
                 disconnectFromSource();
             }
+#ifndef _WIN32
+        } else if (k.key() == 'c' || k.key() == 'C') {
+            toggleRecording();
+#endif
         } else if (k.key() >= '1' && k.key() <= '9') {
             int index = k.key() - '1';
             if (index >= 0 && index < (int)availableSources.size()) {
@@ -136,27 +149,47 @@ struct NDIVideoReceiverApp : public App {
         const string& sourceName = availableSources[sourceIndex].name;
         cout << "Connecting to: " << sourceName << endl;
 
-        if (ndiReceiver.connect(sourceName.c_str())) {
-            connected = true;
-            selectedSourceIndex = sourceIndex;
-            statusMessage = "Connected to: " + sourceName;
-            cout << "Successfully connected to NDI source: " << sourceName << endl;
-        } else {
-            statusMessage = "Failed to connect to: " + sourceName;
-            cout << "Failed to connect to NDI source: " << sourceName << endl;
+        // The other sources act as backups if the selected one drops
+        vector<string> backups;
+        for (size_t i = 0; i < availableSources.size(); ++i) {
+            if ((int)i != sourceIndex) backups.push_back(availableSources[i].name);
         }
+        ndiReceiver.setBackupSources(backups);
+
+        // Connects in the background so the render loop keeps running
+        ndiReceiver.connectAsync(sourceName.c_str());
+        connected = true;
+        selectedSourceIndex = sourceIndex;
+        statusMessage = "Connecting to: " + sourceName;
     }
 
     void disconnectFromSource() {
-        // Note: The NDIReceiver doesn't have a disconnect method,
-        // but we can recreate the receiver
+        ndiReceiver.disconnect();
         connected = false;
         selectedSourceIndex = -1;
         statusMessage = "Disconnected";
         cout << "Disconnected from NDI source" << endl;
     }
 
+#ifndef _WIN32
+    void toggleRecording() {
+        if (recorder.isOpen()) {
+            ndiReceiver.setRecorder(nullptr);
+            cout << "Recorded " << recorder.frameCount() << " frames to " << recorder.path() << endl;
+            recorder.close();
+        } else if (recorder.open("ndi_capture.alrec")) {
+            ndiReceiver.setRecorder(&recorder);
+            cout << "Recording to " << recorder.path() << endl;
+        }
+    }
+#endif
+
     void onExit() override {
+#ifndef _WIN32
+        if (recorder.isOpen()) {
+            toggleRecording();
+        }
+#endif
         cout << "NDI Video Receiver App exited." << endl;
     }
 };
@@ -171,6 +204,9 @@ int main() {
     cout << "    R - Refresh available sources" << endl;
     cout << "    Y - Yes Connect to selected source" << endl;
     cout << "    N - No, Disconnect" << endl;
+#ifndef _WIN32
+    cout << "    C - Start/stop recording to ndi_capture.alrec" << endl;
+#endif
     cout << "    1-9 - Select source by number" << endl;
     cout << endl;
 
@@ -0,0 +1,193 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "al/graphics/al_FBO.hpp"
+#include "al/graphics/al_Texture.hpp"
+#include "al_ext/ndi/al_FrameProfiler.hpp"
+#include "al_ext/ndi/al_NDIHeadless.hpp"
+#include "al_ext/ndi/al_NDIReceiver.hpp"
+#include "al_ext/ndi/al_NDIRecording.hpp"
+#include "al_ext/ndi/al_NDISender.hpp"
+
+// Unattended throughput benchmark for the NDI pipeline on a headless
+// server (offscreen EGL context, no window).
+//
+//   NDIHeadlessBench send [width height frames]   FBO -> NDISender::sendDirect
+//   NDIHeadlessBench receive [source seconds]     NDIReceiver::update -> texture
+//   NDIHeadlessBench replay file                  NDIReplaySource -> texture
+//   NDIHeadlessBench republish file [name]        NDIReplaySource -> NDISender::send
+
+using namespace al;
+using namespace std;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char* stage, int frames, double seconds, int width, int height) {
+    double mb = (double)width * height * 4 * frames / (1024.0 * 1024.0);
+    cout << stage << ": " << frames << " frames in " << seconds << " s, "
+         << frames / seconds << " fps, " << 1000.0 * seconds / (frames ? frames : 1)
+         << " ms/frame, " << mb / seconds << " MB/s" << endl;
+}
+
+int benchSend(int width, int height, int frames) {
+    Texture tex;
+    tex.create2D(width, height);
+    FBO fbo;
+    fbo.bind();
+    fbo.attachTexture2D(tex);
+    fbo.unbind();
+
+    NDISender::VideoConfig config;
+    config.width = width;
+    config.height = height;
+    NDISender sender;
+    if (!sender.init("NDIHeadlessBench", config, true)) {
+        cout << "Failed to initialize NDI sender" << endl;
+        return 1;
+    }
+    // Measure the full path even with no receiver connected
+    NDISender::SkipPolicy skip;
+    skip.skipWithoutReceivers = false;
+    skip.skipUnchanged = false;
+    sender.skipPolicy(skip);
+    FrameProfiler profiler;
+    if (profiler.init()) sender.profiler(&profiler);
+
+    Clock::time_point start = Clock::now();
+    int sent = 0;
+    for (int i = 0; i < frames; i++) {
+        profiler.beginFrame();
+        // Animated clear so every frame differs
+        double t = i / 60.0;
+        {
+            FrameProfiler::Scope scope(&profiler, "clear");
+            fbo.bind();
+            glViewport(0, 0, width, height);
+            glClearColor(0.5 + 0.5 * sin(t * 2.0), 0.5 + 0.5 * sin(t * 2.0 + M_PI / 2),
+                         0.5 + 0.5 * sin(t * 2.0 + M_PI), 1.0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            fbo.unbind();
+        }
+
+        if (sender.sendDirect(tex)) sent++;
+        profiler.endFrame();
+    }
+    glFinish();
+    report("send", sent, secondsSince(start), width, height);
+    const NDISender::Stats& stats = sender.stats();
+    cout << "  readback " << stats.readbackMs << " ms, send " << stats.sendMs << " ms, "
+         << stats.switchCount << " rate switches" << endl;
+    cout << profiler.report();
+    return sent == frames ? 0 : 1;
+}
+
+int benchReceive(const char* source, double seconds) {
+    NDIReceiver receiver;
+    if (!receiver.init() || !receiver.connect(source)) {
+        cout << "Failed to connect to NDI source" << endl;
+        return 1;
+    }
+
+    Texture tex;
+    Clock::time_point start = Clock::now();
+    int frames = 0;
+    while (secondsSince(start) < seconds) {
+        if (receiver.update(tex)) frames++;
+    }
+    glFinish();
+    report("receive", frames, secondsSince(start), receiver.width(), receiver.height());
+    return frames > 0 ? 0 : 1;
+}
+
+int benchReplay(const char* path) {
+    NDIReplaySource replay;
+    if (!replay.open(path)) return 1;
+    replay.speed(NDIReplaySource::MAX);
+
+    Texture tex;
+    Clock::time_point start = Clock::now();
+    int frames = 0;
+    while (replay.update(tex)) frames++;
+    glFinish();
+    report("replay", frames, secondsSince(start), replay.width(), replay.height());
+    return frames > 0 ? 0 : 1;
+}
+
+int benchRepublish(const char* path, const char* name) {
+    NDIReplaySource replay;
+    if (!replay.open(path)) return 1;
+    replay.speed(NDIReplaySource::MAX);
+
+    NDISender::VideoConfig config;
+    config.clockVideo = false; // as fast as the sender takes them
+    NDISender sender;
+    if (!sender.init(name, config, false)) {
+        cout << "Failed to initialize NDI sender" << endl;
+        return 1;
+    }
+
+    // Recorded frames stay mapped while the file is open, so they are lent
+    // to NDI without copying
+    Clock::time_point start = Clock::now();
+    int frames = 0;
+    while (replay.consume([&](const NDIlib_video_frame_v2_t& frame) {
+        sender.send(frame.p_data, frame.xres, frame.yres, frame.line_stride_in_bytes,
+                    frame.FourCC, frame.timecode);
+    })) {
+        frames++;
+    }
+    sender.flush();
+    report("republish", frames, secondsSince(start), replay.width(), replay.height());
+    cout << "  send " << sender.stats().sendMs << " ms" << endl;
+    return frames > 0 ? 0 : 1;
+}
+
+void usage() {
+    cout << "Usage:" << endl;
+    cout << "  NDIHeadlessBench send [width height frames]" << endl;
+    cout << "  NDIHeadlessBench receive [source seconds]" << endl;
+    cout << "  NDIHeadlessBench replay file" << endl;
+    cout << "  NDIHeadlessBench republish file [name]" << endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    NDIHeadlessContext context;
+    if (!context.create()) {
+        cout << "Failed to create headless OpenGL context" << endl;
+        return 1;
+    }
+    cout << "Headless OpenGL renderer: " << context.renderer() << endl;
+
+    string mode = argv[1];
+    if (mode == "send") {
+        int width = argc > 2 ? atoi(argv[2]) : 1920;
+        int height = argc > 3 ? atoi(argv[3]) : 1080;
+        int frames = argc > 4 ? atoi(argv[4]) : 600;
+        return benchSend(width, height, frames);
+    } else if (mode == "receive") {
+        const char* source = argc > 2 ? argv[2] : nullptr;
+        double seconds = argc > 3 ? atof(argv[3]) : 10.0;
+        return benchReceive(source, seconds);
+    } else if (mode == "replay" && argc > 2) {
+        return benchReplay(argv[2]);
+    } else if (mode == "republish" && argc > 2) {
+        return benchRepublish(argv[2], argc > 3 ? argv[3] : "NDIHeadlessBench");
+    }
+    usage();
+    return 1;
+}
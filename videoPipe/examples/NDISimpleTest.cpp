@@ -1,11 +1,32 @@
+#include <cmath>
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <vector>
 #include "al_ext/ndi/al_NDISender.hpp"
 
 using namespace al;
 using namespace std;
 
+// CPU-rendered test pattern: moving color bars over a hue that cycles with time
+static void renderPattern(vector<uint8_t>& bgra, int width, int height, double time) {
+    int offset = (int)(time * 120.0);
+    uint8_t base[3];
+    for (int c = 0; c < 3; c++) {
+        base[c] = (uint8_t)(127.5 + 127.5 * sin(time + c * 2.094));
+    }
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = &bgra[(size_t)y * width * 4];
+        for (int x = 0; x < width; x++) {
+            bool bar = ((x + offset) / 64) % 4 == 0;
+            row[x * 4 + 0] = bar ? 255 : base[2];
+            row[x * 4 + 1] = bar ? 255 : base[1];
+            row[x * 4 + 2] = bar ? 255 : base[0];
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
+
 int main() {
     cout << "Simple NDI Test - Basic functionality test" << endl;
 
@@ -26,8 +47,13 @@ int main() {
     cout << "Use NDI monitoring tools to view the stream." << endl;
     cout << endl;
 
-    // Simple test loop - just demonstrates that NDI is working
-    // In a real application, you would render graphics and send actual frames
+    // Render on the CPU into two buffers and lend them to NDI in turn; a
+    // buffer is only drawn into again once its send has completed.
+    // NDI paces the sends to the configured 60 fps (clockVideo).
+    vector<uint8_t> buffers[2];
+    bool inFlight[2] = {false, false};
+    for (int i = 0; i < 2; i++) buffers[i].resize((size_t)config.width * config.height * 4);
+
     int frameCount = 0;
     double time = 0.0;
 
@@ -38,13 +64,24 @@ int main() {
             cout << "Test running... frame " << frameCount << " at " << time << "s" << endl;
         }
 
+        int index = frameCount % 2;
+        if (inFlight[index]) {
+            cout << "Buffer still in flight, skipping frame" << endl;
+        } else {
+            renderPattern(buffers[index], config.width, config.height, time);
+            inFlight[index] = true;
+            sender.send(buffers[index].data(), config.width, config.height, 0,
+                        NDIlib_FourCC_type_BGRA, NDIlib_send_timecode_synthesize,
+                        [&inFlight, index](const uint8_t*) { inFlight[index] = false; });
+        }
+
         frameCount++;
         time += 1.0/60.0;
-
-        // Sleep to simulate 60fps timing
-        std::this_thread::sleep_for(std::chrono::milliseconds(16));
     }
+    sender.flush();
 
+    cout << "Sent " << sender.stats().framesSent << " frames, "
+         << sender.stats().sendMs << " ms per send" << endl;
     cout << "Test completed successfully!" << endl;
     cout << "NDI sender functionality verified." << endl;
     return 0;
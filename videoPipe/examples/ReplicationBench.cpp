@@ -0,0 +1,859 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "al_ext/replication/al_FrameMulticast.hpp"
+#include "al_ext/replication/al_FrameSharedMemory.hpp"
+#include "al_ext/replication/al_FrameSnapshot.hpp"
+#include "al_ext/replication/al_TextureCompression.hpp"
+#include "al_ext/replication/al_VideoCodec.hpp"
+
+// Localhost harness for the video replication transports.
+//
+//   ReplicationBench loss [width height frames]
+//     Runs a multicast sender and two replicas over loopback with injected
+//     packet loss, with and without FEC, and reports delivery and latency.
+//
+//   ReplicationBench bc1 [width height frames]
+//     Encodes a synthetic frame to BC1 at both qualities and 1..N threads,
+//     and reports encode time, size reduction and PSNR.
+//
+//   ReplicationBench ttff [width height joins]
+//     Joins replicas to a running 60 fps stream and reports the time to
+//     their first complete frame, from multicast alone and from a snapshot
+//     requested over TCP on joining, with and without packet loss.
+//
+//   ReplicationBench shm [width height frames readers]
+//     Publishes frames at 60 fps into the same-host shared-memory ring and
+//     reads them back from several replicas, one of which stalls now and
+//     then, and reports write time, latency and integrity.
+//
+//   ReplicationBench pps [width height frames]
+//     Streams frames at 60 fps to one replica over loopback with one
+//     datagram per syscall, with sendmmsg/recvmmsg batches, with UDP GSO,
+//     and at 1500 and 9000 byte MTU chunk sizes, and reports packet rate,
+//     syscalls per frame and CPU use.
+//
+//   ReplicationBench codec [width height frames]
+//     Compresses a moving synthetic frame with each libavcodec codec at
+//     several bitrates, with and without inter coding, sends the packets
+//     to a decoding replica over loopback multicast, and reports encode
+//     and decode time, wire rate against raw RGBA8, end-to-end latency
+//     and PSNR.
+//
+//   ReplicationBench restart [width height frames]
+//     Replaces a running multicast sender with a new one whose generations
+//     start again at 1, as when the primary is restarted, and reports how
+//     long replicas take to show its frames. Then sends a replica chunks of
+//     one frame with conflicting layouts and checks they are rejected.
+
+using namespace al;
+using namespace std;
+
+namespace {
+
+const char* kGroup = "239.255.42.99";
+const char* kInterface = "127.0.0.1";
+
+uint8_t patternByte(uint32_t generation, size_t i) {
+    return (uint8_t)(i * 31 + generation);
+}
+
+void fillPattern(vector<uint8_t>& frame, uint32_t generation) {
+    for (size_t i = 0; i < frame.size(); i++) frame[i] = patternByte(generation, i);
+}
+
+bool checkPattern(const ReplicatedFrame& frame) {
+    for (size_t i = 0; i < frame.bytes; i += 4099) {
+        if (frame.data[i] != patternByte(frame.generation, i)) return false;
+    }
+    return frame.data[frame.bytes - 1] == patternByte(frame.generation, frame.bytes - 1);
+}
+
+double percentile(vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    sort(values.begin(), values.end());
+    size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+struct LossResult {
+    int delivered;
+    int corrupted;
+    vector<double> latencyMs;
+    FrameMulticastReceiver::Stats receiver;
+    FrameMulticastSender::Stats sender;
+};
+
+LossResult runLoss(uint16_t port, float dropRate, float fecOverhead,
+                   int width, int height, int frames) {
+    LossResult result;
+    result.delivered = 0;
+    result.corrupted = 0;
+
+    FrameMulticastReceiver::Config rc;
+    rc.group = kGroup;
+    rc.port = port;
+    rc.interfaceAddress = kInterface;
+    rc.dropRate = dropRate;
+
+    FrameMulticastSender::Config sc;
+    sc.group = kGroup;
+    sc.port = port;
+    sc.interfaceAddress = kInterface;
+    sc.fecOverhead = fecOverhead;
+
+    FrameMulticastReceiver replicas[2];
+    FrameMulticastSender sender;
+    for (FrameMulticastReceiver& r : replicas) r.init(rc);
+    if (!sender.init(sc)) return result;
+
+    vector<uint8_t> frame((size_t)width * height * 4);
+    auto period = chrono::microseconds(16667);
+    auto next = chrono::steady_clock::now();
+    for (uint32_t generation = 1; generation <= (uint32_t)frames + 30; generation++) {
+        // Trailing frames flush the last measured one through
+        if (generation <= (uint32_t)frames) {
+            fillPattern(frame, generation);
+            sender.publish(frame.data(), frame.size(), width, height,
+                           ReplicatedFrame::RGBA8, generation);
+        }
+        next += period;
+        while (chrono::steady_clock::now() < next) {
+            for (FrameMulticastReceiver& r : replicas) {
+                ReplicatedFrame f;
+                if (r.latestFrame(f)) {
+                    result.delivered++;
+                    if (!checkPattern(f)) result.corrupted++;
+                    result.latencyMs.push_back((f.receivedNs - f.timestampNs) / 1e6);
+                }
+            }
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+    }
+
+    result.receiver = replicas[0].stats();
+    result.sender = sender.stats();
+    return result;
+}
+
+int lossBench(int width, int height, int frames) {
+    cout << "Loss injection: " << frames << " frames of " << width << "x" << height
+         << " RGBA to 2 replicas over loopback multicast" << endl;
+    cout << setw(6) << "loss" << setw(6) << "fec" << setw(11) << "delivered"
+         << setw(8) << "corrupt" << setw(9) << "p50 ms" << setw(9) << "p99 ms"
+         << setw(9) << "max ms" << setw(8) << "nacks" << setw(10) << "rebuilt"
+         << setw(10) << "retx" << endl;
+
+    const float losses[] = {0.0f, 0.01f, 0.02f, 0.05f};
+    const float overheads[] = {0.0f, 0.05f, 0.1f};
+    uint16_t port = 16101;
+    for (float loss : losses) {
+        for (float fec : overheads) {
+            LossResult r = runLoss(port++, loss, fec, width, height, frames);
+            cout << fixed << setprecision(2)
+                 << setw(6) << loss * 100 << setw(6) << fec * 100
+                 << setw(7) << r.delivered << "/" << setw(3) << frames * 2
+                 << setw(8) << r.corrupted
+                 << setw(9) << percentile(r.latencyMs, 0.5)
+                 << setw(9) << percentile(r.latencyMs, 0.99)
+                 << setw(9) << percentile(r.latencyMs, 1.0)
+                 << setw(8) << r.receiver.nacksSent
+                 << setw(10) << r.receiver.chunksRecovered
+                 << setw(10) << r.sender.chunksRetransmitted << endl;
+        }
+    }
+    return 0;
+}
+
+// Smooth gradients with hard-edged bars and some noise, roughly like video
+void fillImage(vector<uint8_t>& rgba, int width, int height) {
+    uint32_t noise = 12345;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            noise = noise * 1664525u + 1013904223u;
+            int n = (int)(noise >> 29) - 4;
+            uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+            bool bar = (x / 64) % 5 == 0;
+            p[0] = (uint8_t)max(0, min(255, (bar ? 230 : x * 255 / width) + n));
+            p[1] = (uint8_t)max(0, min(255, (bar ? 40 : y * 255 / height) + n));
+            p[2] = (uint8_t)max(0, min(255, 128 + (int)(100 * sin(x * 0.02 + y * 0.03)) + n));
+            p[3] = 255;
+        }
+    }
+}
+
+double psnr(const vector<uint8_t>& a, const vector<uint8_t>& b) {
+    double sum = 0.0;
+    size_t samples = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (i % 4 == 3) continue;
+        double d = (double)a[i] - b[i];
+        sum += d * d;
+        samples++;
+    }
+    double mse = sum / samples;
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+int bc1Bench(int width, int height, int frames) {
+    vector<uint8_t> image((size_t)width * height * 4);
+    vector<uint8_t> blocks(bc1Bytes(width, height));
+    vector<uint8_t> decoded(image.size());
+    fillImage(image, width, height);
+
+    int cores = (int)thread::hardware_concurrency();
+    cout << "BC1 encode: " << width << "x" << height << ", " << frames << " frames, "
+         << image.size() / blocks.size() << ":1 (" << blocks.size() / 1024 << " KiB per frame), "
+         << cores << " cores" << endl;
+    cout << setw(8) << "quality" << setw(9) << "threads" << setw(10) << "ms/frame"
+         << setw(10) << "Mpix/s" << setw(9) << "PSNR" << endl;
+
+    const BC1Encoder::Quality qualities[] = {BC1Encoder::FAST, BC1Encoder::HIGH};
+    for (BC1Encoder::Quality quality : qualities) {
+        for (int threads = 1; threads <= max(1, cores); threads *= 2) {
+            BC1Encoder::Config config;
+            config.quality = quality;
+            config.threads = threads;
+            BC1Encoder encoder;
+            encoder.init(config);
+
+            double totalMs = 0.0;
+            for (int i = 0; i < frames; i++) {
+                encoder.encode(image.data(), width, height, blocks.data());
+                totalMs += encoder.lastEncodeMs();
+            }
+            decodeBC1(blocks.data(), width, height, decoded.data());
+            double ms = totalMs / frames;
+            cout << fixed << setprecision(2)
+                 << setw(8) << (quality == BC1Encoder::FAST ? "fast" : "high")
+                 << setw(9) << threads << setw(10) << ms
+                 << setw(10) << (double)width * height / (ms * 1000.0)
+                 << setw(9) << psnr(image, decoded) << endl;
+        }
+    }
+    return 0;
+}
+
+// Time from joining to the first frame, by multicast alone and by snapshot,
+// for `joins` replicas joining one after another
+struct JoinResult {
+    vector<double> multicastMs;
+    vector<double> snapshotMs;
+    int corrupted;
+};
+
+JoinResult runJoins(uint16_t port, float dropRate, int width, int height, int joins) {
+    JoinResult result;
+    result.corrupted = 0;
+
+    FrameMulticastSender::Config sc;
+    sc.group = kGroup;
+    sc.port = port;
+    sc.interfaceAddress = kInterface;
+    FrameSnapshotServer::Config snapshotConfig;
+    snapshotConfig.port = (uint16_t)(port + 1);
+    snapshotConfig.interfaceAddress = kInterface;
+
+    FrameMulticastSender sender;
+    FrameSnapshotServer server;
+    if (!sender.init(sc) || !server.init(snapshotConfig)) return result;
+
+    // The primary: publishes a frame every 16.7 ms and keeps the snapshot current
+    atomic<bool> publishing(true);
+    thread primary([&] {
+        vector<uint8_t> frame((size_t)width * height * 4);
+        auto next = chrono::steady_clock::now();
+        for (uint32_t generation = 1; publishing; generation++) {
+            fillPattern(frame, generation);
+            sender.publish(frame.data(), frame.size(), width, height, ReplicatedFrame::RGBA8, generation);
+            server.updateFrame(frame.data(), frame.size(), width, height, ReplicatedFrame::RGBA8, generation);
+            next += chrono::microseconds(16667);
+            this_thread::sleep_until(next);
+        }
+    });
+    this_thread::sleep_for(chrono::milliseconds(200));
+
+    FrameMulticastReceiver::Config rc;
+    rc.group = kGroup;
+    rc.port = port;
+    rc.interfaceAddress = kInterface;
+    rc.dropRate = dropRate;
+    FrameSnapshotClient::Config cc;
+    cc.host = kInterface;
+    cc.port = snapshotConfig.port;
+
+    for (int i = 0; i < joins; i++) {
+        auto joined = chrono::steady_clock::now();
+        FrameMulticastReceiver replica;
+        FrameSnapshotClient client;
+        replica.init(rc);
+        client.request(cc);
+
+        double multicastMs = -1.0, snapshotMs = -1.0;
+        while ((multicastMs < 0.0 || snapshotMs < 0.0) &&
+               chrono::steady_clock::now() - joined < chrono::seconds(5)) {
+            double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - joined).count();
+            ReplicatedFrame f;
+            if (multicastMs < 0.0 && replica.latestFrame(f)) {
+                multicastMs = elapsed;
+                if (!checkPattern(f)) result.corrupted++;
+            }
+            if (snapshotMs < 0.0 && client.latestFrame(f)) {
+                snapshotMs = elapsed;
+                if (!checkPattern(f)) result.corrupted++;
+            }
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+        if (multicastMs >= 0.0) result.multicastMs.push_back(multicastMs);
+        if (snapshotMs >= 0.0) result.snapshotMs.push_back(snapshotMs);
+        // Join at a different phase of the frame period each time
+        this_thread::sleep_for(chrono::milliseconds(37));
+    }
+
+    publishing = false;
+    primary.join();
+    return result;
+}
+
+int ttffBench(int width, int height, int joins) {
+    cout << "Time to first frame: " << joins << " replicas joining a 60 fps stream of "
+         << width << "x" << height << " RGBA over loopback" << endl;
+    cout << setw(6) << "loss" << setw(15) << "multicast p50" << setw(9) << "max"
+         << setw(8) << "missed" << setw(14) << "snapshot p50" << setw(9) << "max"
+         << setw(8) << "missed" << setw(9) << "corrupt" << endl;
+
+    const float losses[] = {0.0f, 0.01f, 0.05f};
+    uint16_t port = 16201;
+    for (float loss : losses) {
+        JoinResult r = runJoins(port, loss, width, height, joins);
+        port += 2;
+        cout << fixed << setprecision(2)
+             << setw(6) << loss * 100
+             << setw(15) << percentile(r.multicastMs, 0.5)
+             << setw(9) << percentile(r.multicastMs, 1.0)
+             << setw(8) << joins - (int)r.multicastMs.size()
+             << setw(14) << percentile(r.snapshotMs, 0.5)
+             << setw(9) << percentile(r.snapshotMs, 1.0)
+             << setw(8) << joins - (int)r.snapshotMs.size()
+             << setw(9) << r.corrupted << endl;
+    }
+    return 0;
+}
+
+int shmBench(int width, int height, int frames, int readers) {
+    SharedFrameWriter::Config wc;
+    wc.name = "/al_frames_bench";
+    wc.slotCount = readers + 2;
+    wc.maxFrameBytes = (size_t)width * height * 4;
+    SharedFrameWriter writer;
+    if (!writer.init(wc)) return 1;
+
+    cout << "Shared-memory ring: " << frames << " frames of " << width << "x" << height
+         << " RGBA at 60 fps, " << readers << " replicas (replica 0 stalls 40 ms every 10 frames), "
+         << wc.slotCount << " slots" << endl;
+
+    atomic<bool> running(true);
+    vector<vector<double>> latencyMs(readers);
+    vector<int> corrupted(readers, 0);
+    vector<SharedFrameReader::Stats> readerStats(readers);
+    vector<thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            SharedFrameReader::Config rc;
+            rc.name = wc.name;
+            rc.retryMs = 10;
+            SharedFrameReader reader;
+            reader.init(rc);
+            int count = 0;
+            while (running) {
+                ReplicatedFrame f;
+                if (reader.latestFrame(f)) {
+                    // Stand-in for the texture upload straight from the shared pages
+                    if (!checkPattern(f)) corrupted[r]++;
+                    latencyMs[r].push_back((frameClockNs() - f.timestampNs) / 1e6);
+                    if (r == 0 && ++count % 10 == 0) this_thread::sleep_for(chrono::milliseconds(40));
+                }
+                this_thread::sleep_for(chrono::microseconds(200));
+            }
+            reader.shutdown();
+            readerStats[r] = reader.stats();
+        });
+    }
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    vector<double> writeMs;
+    auto next = chrono::steady_clock::now();
+    for (uint32_t generation = 1; generation <= (uint32_t)frames; generation++) {
+        auto start = chrono::steady_clock::now();
+        size_t bytes = (size_t)width * height * 4;
+        uint8_t* slot = writer.beginFrame(bytes);
+        for (size_t i = 0; i < bytes; i++) slot[i] = patternByte(generation, i);
+        writer.commitFrame(width, height, ReplicatedFrame::RGBA8, generation);
+        writeMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        next += chrono::microseconds(16667);
+        this_thread::sleep_until(next);
+    }
+    running = false;
+    for (thread& t : threads) t.join();
+
+    cout << fixed << setprecision(2) << "write (fill in place) p50 " << percentile(writeMs, 0.5)
+         << " ms, overwritten pinned slots " << writer.stats().slotsOverwritten << endl;
+    cout << setw(8) << "replica" << setw(8) << "frames" << setw(9) << "p50 ms" << setw(9) << "p99 ms"
+         << setw(9) << "max ms" << setw(7) << "torn" << setw(9) << "corrupt" << endl;
+    for (int r = 0; r < readers; r++) {
+        cout << setw(8) << r << setw(8) << readerStats[r].framesRead
+             << setw(9) << percentile(latencyMs[r], 0.5)
+             << setw(9) << percentile(latencyMs[r], 0.99)
+             << setw(9) << percentile(latencyMs[r], 1.0)
+             << setw(7) << readerStats[r].framesTorn << setw(9) << corrupted[r] << endl;
+    }
+    writer.shutdown();
+    return 0;
+}
+
+double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+struct PpsCase {
+    const char* name;
+    size_t chunkBytes;
+    int sendBatch;
+    int receiveBatch;
+    bool gso;
+};
+
+int ppsBench(int width, int height, int frames) {
+    cout << "Datagram rate: " << frames << " frames of " << width << "x" << height
+         << " RGBA at 60 fps to 1 replica over loopback multicast" << endl;
+    cout << setw(22) << "" << setw(7) << "chunk" << setw(11) << "delivered" << setw(9) << "Mpkt/s"
+         << setw(9) << "Gbit/s" << setw(11) << "sends/fr" << setw(11) << "recvs/fr" << setw(7) << "CPU%" << endl;
+
+    const PpsCase cases[] = {
+        {"one per syscall", 8000, 1, 1, false},
+        {"sendmmsg/recvmmsg", 8000, 64, 32, false},
+        {"mmsg + GSO", 8000, 64, 32, true},
+        {"mmsg + GSO, 1500 MTU", chunkBytesForMtu(1500), 64, 32, true},
+        {"mmsg + GSO, 9000 MTU", chunkBytesForMtu(9000), 64, 32, true},
+    };
+    // Content is not checked here, so one frame is filled and sent repeatedly
+    vector<uint8_t> frame((size_t)width * height * 4);
+    fillPattern(frame, 1);
+    uint16_t port = 16301;
+    for (const PpsCase& c : cases) {
+        FrameMulticastReceiver::Config rc;
+        rc.group = kGroup;
+        rc.port = port;
+        rc.interfaceAddress = kInterface;
+        rc.batchSize = c.receiveBatch;
+        FrameMulticastSender::Config sc;
+        sc.group = kGroup;
+        sc.port = port++;
+        sc.interfaceAddress = kInterface;
+        sc.chunkBytes = c.chunkBytes;
+        sc.batchSize = c.sendBatch;
+        sc.segmentationOffload = c.gso;
+
+        FrameMulticastReceiver replica;
+        FrameMulticastSender sender;
+        if (!replica.init(rc) || !sender.init(sc)) return 1;
+
+        int delivered = 0;
+        double cpuStart = cpuSeconds();
+        auto start = chrono::steady_clock::now();
+        auto next = start;
+        for (uint32_t generation = 1; generation <= (uint32_t)frames + 6; generation++) {
+            if (generation <= (uint32_t)frames) {
+                sender.publish(frame.data(), frame.size(), width, height, ReplicatedFrame::RGBA8, generation);
+            }
+            next += chrono::microseconds(16667);
+            while (chrono::steady_clock::now() < next) {
+                ReplicatedFrame f;
+                if (replica.latestFrame(f)) delivered++;
+                this_thread::sleep_for(chrono::microseconds(500));
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double cpu = cpuSeconds() - cpuStart;
+
+        FrameMulticastSender::Stats ss = sender.stats();
+        FrameMulticastReceiver::Stats rs = replica.stats();
+        cout << fixed << setprecision(2) << setw(22) << c.name << setw(7) << c.chunkBytes
+             << setw(7) << delivered << "/" << setw(3) << frames
+             << setw(9) << ss.chunksSent / seconds / 1e6
+             << setw(9) << ss.bytesSent * 8 / seconds / 1e9
+             << setw(11) << (double)ss.sendCalls / frames
+             << setw(11) << (double)rs.receiveCalls / frames
+             << setw(7) << 100.0 * cpu / seconds << endl;
+    }
+    return 0;
+}
+
+// fillImage scrolled sideways 4 pixels per generation, so inter coding has motion to find
+void scrollImage(const vector<uint8_t>& base, int width, int height, uint32_t generation,
+                 vector<uint8_t>& out) {
+    int shift = (int)(generation * 4 % (uint32_t)width);
+    size_t row = (size_t)width * 4;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = &base[y * row];
+        uint8_t* dst = &out[y * row];
+        memcpy(dst, src + (size_t)shift * 4, row - (size_t)shift * 4);
+        memcpy(dst + row - (size_t)shift * 4, src, (size_t)shift * 4);
+    }
+}
+
+struct CodecCase {
+    VideoEncoder::Codec codec;
+    const char* name;
+    int bitrateKbps;
+    int keyframeInterval;
+};
+
+int codecBench(int width, int height, int frames) {
+    if (!VideoEncoder::available()) {
+        cout << "codec: al_replication was built without libavcodec" << endl;
+        return 1;
+    }
+    double rawMbps = (double)width * height * 4 * 8 * 60 / 1e6;
+    cout << "Video compression: " << frames << " frames of " << width << "x" << height
+         << " at 60 fps to 1 replica over loopback multicast, raw RGBA8 "
+         << fixed << setprecision(0) << rawMbps << " Mbit/s" << endl;
+    cout << setw(7) << "codec" << setw(8) << "kbit/s" << setw(5) << "gop" << setw(11) << "delivered"
+         << setw(8) << "skipped" << setw(9) << "enc ms" << setw(9) << "dec ms" << setw(9) << "Mbit/s"
+         << setw(8) << "ratio" << setw(9) << "p50 ms" << setw(9) << "p99 ms" << setw(8) << "PSNR" << endl;
+
+    const CodecCase cases[] = {
+        {VideoEncoder::H264, "h264", 5000, 60},
+        {VideoEncoder::H264, "h264", 20000, 60},
+        {VideoEncoder::H264, "h264", 20000, 1},
+        {VideoEncoder::HEVC, "hevc", 5000, 60},
+        {VideoEncoder::HEVC, "hevc", 20000, 60},
+        {VideoEncoder::MPEG4, "mpeg4", 20000, 60},
+        {VideoEncoder::MPEG4, "mpeg4", 20000, 1},
+    };
+    vector<uint8_t> base((size_t)width * height * 4);
+    vector<uint8_t> image(base.size());
+    vector<uint8_t> reference(base.size());
+    fillImage(base, width, height);
+    uint16_t port = 16401;
+    for (const CodecCase& c : cases) {
+        VideoEncoder::Config ec;
+        ec.codec = c.codec;
+        ec.bitrateKbps = c.bitrateKbps;
+        ec.keyframeInterval = c.keyframeInterval;
+        VideoEncoder encoder;
+        if (!encoder.init(ec)) continue;
+        VideoDecoder decoder;
+        if (!decoder.init()) return 1;
+
+        FrameMulticastReceiver::Config rc;
+        rc.group = kGroup;
+        rc.port = port;
+        rc.interfaceAddress = kInterface;
+        FrameMulticastSender::Config sc;
+        sc.group = kGroup;
+        sc.port = port++;
+        sc.interfaceAddress = kInterface;
+
+        // Every packet goes to the decoder in order, latestFrame would skip some
+        FrameMulticastReceiver replica;
+        replica.frameHandler([&decoder](const ReplicatedFrame& f) {
+            if (f.format == ReplicatedFrame::VIDEO) decoder.submit(f);
+        });
+        FrameMulticastSender sender;
+        if (!replica.init(rc) || !sender.init(sc)) return 1;
+
+        int delivered = 0;
+        double encodeMs = 0.0, decodeMs = 0.0, psnrSum = 0.0;
+        int psnrCount = 0;
+        vector<double> latencyMs;
+        VideoEncoder::Packet packet;
+        auto next = chrono::steady_clock::now();
+        for (uint32_t generation = 1; generation <= (uint32_t)frames + 30; generation++) {
+            if (generation <= (uint32_t)frames) {
+                scrollImage(base, width, height, generation, image);
+                encoder.submit(image.data(), width, height, generation);
+            }
+            next += chrono::microseconds(16667);
+            bool published = false;
+            while (chrono::steady_clock::now() < next) {
+                if (!published && encoder.receive(packet)) {
+                    sender.publish(packet.data.data(), packet.data.size(), packet.width, packet.height,
+                                   ReplicatedFrame::VIDEO, packet.generation, packet.timestampNs);
+                    encodeMs += encoder.stats().encodeMs + encoder.stats().convertMs;
+                    published = true;
+                }
+                ReplicatedFrame f;
+                if (decoder.latestFrame(f)) {
+                    delivered++;
+                    VideoDecoder::Stats ds = decoder.stats();
+                    decodeMs += ds.decodeMs + ds.convertMs;
+                    latencyMs.push_back((f.receivedNs - f.timestampNs) / 1e6);
+                    // Every eighth picture against the frame it was coded from
+                    if (f.generation % 8 == 0) {
+                        scrollImage(base, width, height, f.generation, reference);
+                        vector<uint8_t> picture(f.data, f.data + f.bytes);
+                        psnrSum += psnr(reference, picture);
+                        psnrCount++;
+                    }
+                }
+                this_thread::sleep_for(chrono::microseconds(200));
+            }
+        }
+
+        VideoEncoder::Stats es = encoder.stats();
+        VideoDecoder::Stats ds = decoder.stats();
+        double mbps = es.bytesEncoded * 8.0 / (frames / 60.0) / 1e6;
+        cout << fixed << setprecision(2) << setw(7) << c.name << setw(8) << c.bitrateKbps
+             << setw(5) << c.keyframeInterval
+             << setw(7) << delivered << "/" << setw(3) << frames
+             << setw(8) << ds.packetsSkipped
+             << setw(9) << (es.framesEncoded ? encodeMs / es.framesEncoded : 0.0)
+             << setw(9) << (delivered ? decodeMs / delivered : 0.0)
+             << setw(9) << mbps << setw(6) << setprecision(0) << rawMbps / max(mbps, 1e-6) << ":1"
+             << setprecision(2) << setw(9) << percentile(latencyMs, 0.5)
+             << setw(9) << percentile(latencyMs, 0.99)
+             << setw(8) << (psnrCount ? psnrSum / psnrCount : 0.0) << endl;
+    }
+    return 0;
+}
+
+// Frames delivered from a sender that replaced another mid-stream
+struct RestartResult {
+    int before;       // from the first sender
+    int after;        // from the second
+    int corrupted;
+    double firstMs;   // second sender's first publish to its first frame shown
+    uint64_t senderChanges;
+};
+
+RestartResult runRestart(uint16_t port, uint32_t firstGeneration, int width, int height, int frames) {
+    RestartResult result = RestartResult();
+    result.firstMs = -1.0;
+
+    FrameMulticastReceiver::Config rc;
+    rc.group = kGroup;
+    rc.port = port;
+    rc.interfaceAddress = kInterface;
+    FrameMulticastSender::Config sc;
+    sc.group = kGroup;
+    sc.port = port;
+    sc.interfaceAddress = kInterface;
+
+    FrameMulticastReceiver replica;
+    if (!replica.init(rc)) return result;
+
+    vector<uint8_t> frame((size_t)width * height * 4);
+    // The first sender has been running a while; the second starts again at 1
+    for (int run = 0; run < 2; run++) {
+        FrameMulticastSender sender;
+        if (!sender.init(sc)) return result;
+        uint32_t generation = run == 0 ? firstGeneration : 1;
+        auto start = chrono::steady_clock::now();
+        auto next = start;
+        for (int i = 0; i < frames + 6; i++, generation++) {
+            if (i < frames) {
+                fillPattern(frame, generation);
+                sender.publish(frame.data(), frame.size(), width, height, ReplicatedFrame::RGBA8, generation);
+            }
+            next += chrono::microseconds(16667);
+            while (chrono::steady_clock::now() < next) {
+                ReplicatedFrame f;
+                if (replica.latestFrame(f)) {
+                    if (!checkPattern(f)) result.corrupted++;
+                    if (run == 0) {
+                        result.before++;
+                    } else {
+                        result.after++;
+                        if (result.firstMs < 0.0) {
+                            result.firstMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                        }
+                    }
+                }
+                this_thread::sleep_for(chrono::microseconds(200));
+            }
+        }
+    }
+    result.senderChanges = replica.stats().senderChanges;
+    return result;
+}
+
+// Sends one chunk as a stray sender would, from socket s to the group
+void sendForgedChunk(int s, const sockaddr_in& group, FrameChunkHeader h, uint8_t type,
+                     uint32_t index, size_t bytes) {
+    vector<uint8_t> packet(sizeof(h) + bytes);
+    h.type = type;
+    h.chunkIndex = index;
+    memcpy(packet.data(), &h, sizeof(h));
+    for (size_t i = 0; i < bytes; i++) {
+        packet[sizeof(h) + i] = type == FrameChunkHeader::DATA ? patternByte(h.generation, index * h.chunkBytes + i) : 0;
+    }
+    sendto(s, packet.data(), packet.size(), 0, (const sockaddr*)&group, sizeof(group));
+}
+
+// Chunks of one frame (session and generation equal) whose layouts disagree
+// must be dropped, not written at the offsets of the other layout
+bool forgedLayoutCheck(uint16_t port, uint64_t& rejected, uint64_t& strays) {
+    FrameMulticastReceiver::Config rc;
+    rc.group = kGroup;
+    rc.port = port;
+    rc.interfaceAddress = kInterface;
+    FrameMulticastReceiver replica;
+    if (!replica.init(rc)) return false;
+
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    in_addr iface;
+    inet_pton(AF_INET, kInterface, &iface);
+    setsockopt(s, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface));
+    sockaddr_in group;
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_port = htons(port);
+    inet_pton(AF_INET, kGroup, &group.sin_addr);
+
+    FrameChunkHeader frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.magic = kFrameChunkMagic;
+    frame.version = kFrameProtocolVersion;
+    frame.generation = 5;
+    frame.session = 77;
+    frame.chunkBytes = 1000;
+    frame.frameBytes = 4000;
+    frame.chunkCount = 4;
+    frame.width = 1000;
+    frame.height = 1;
+    frame.format = ReplicatedFrame::RGBA8;
+    FrameChunkHeader longer = frame;
+    longer.frameBytes = 16000;
+    longer.chunkCount = 16;
+    longer.parityCount = 2;
+    longer.width = 4000;
+    FrameChunkHeader wider = frame;
+    wider.chunkBytes = 2000;
+    wider.frameBytes = 8000;
+    wider.width = 2000;
+
+    sendForgedChunk(s, group, frame, FrameChunkHeader::DATA, 0, 1000);
+    this_thread::sleep_for(chrono::milliseconds(5));
+    // Beyond the first frame's buffer at either layout's offsets
+    sendForgedChunk(s, group, longer, FrameChunkHeader::DATA, 12, 1000);
+    sendForgedChunk(s, group, longer, FrameChunkHeader::PARITY, 1, 1000);
+    sendForgedChunk(s, group, wider, FrameChunkHeader::DATA, 3, 2000);
+    strays = 3;
+    for (uint32_t i = 1; i < 4; i++) sendForgedChunk(s, group, frame, FrameChunkHeader::DATA, i, 1000);
+
+    bool ok = false;
+    for (int wait = 0; wait < 200 && !ok; wait++) {
+        ReplicatedFrame f;
+        if (replica.latestFrame(f)) {
+            ok = f.generation == 5 && f.bytes == 4000 && f.width == 1000 && checkPattern(f);
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    close(s);
+    rejected = replica.stats().chunksRejected;
+    return ok;
+}
+
+int restartBench(int width, int height, int frames) {
+    cout << "Sender restart: " << frames << " frames of " << width << "x" << height
+         << " RGBA at 60 fps from one sender, then from a new one starting at generation 1" << endl;
+    cout << setw(12) << "first gen" << setw(9) << "before" << setw(9) << "after"
+         << setw(8) << "corrupt" << setw(14) << "first ms" << setw(9) << "changes" << endl;
+
+    const uint32_t firstGenerations[] = {2, 1000, 0x7FFFFFF0u};
+    uint16_t port = 16501;
+    int failures = 0;
+    for (uint32_t first : firstGenerations) {
+        RestartResult r = runRestart(port++, first, width, height, frames);
+        cout << fixed << setprecision(2) << setw(12) << first
+             << setw(5) << r.before << "/" << setw(3) << frames
+             << setw(5) << r.after << "/" << setw(3) << frames
+             << setw(8) << r.corrupted << setw(14) << r.firstMs
+             << setw(9) << r.senderChanges << endl;
+        if (r.after == 0 || r.corrupted) failures++;
+    }
+
+    uint64_t rejected = 0;
+    uint64_t strays = 0;
+    bool layoutOk = forgedLayoutCheck(port++, rejected, strays);
+    cout << "Conflicting chunk layouts: frame " << (layoutOk ? "intact" : "LOST OR CORRUPT")
+         << ", " << rejected << "/" << strays << " stray chunks rejected" << endl;
+    if (!layoutOk || rejected != strays) failures++;
+    return failures ? 1 : 0;
+}
+
+void usage() {
+    cout << "Usage: ReplicationBench loss [width height frames]" << endl;
+    cout << "       ReplicationBench bc1 [width height frames]" << endl;
+    cout << "       ReplicationBench ttff [width height joins]" << endl;
+    cout << "       ReplicationBench shm [width height frames readers]" << endl;
+    cout << "       ReplicationBench pps [width height frames]" << endl;
+    cout << "       ReplicationBench codec [width height frames]" << endl;
+    cout << "       ReplicationBench restart [width height frames]" << endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    string mode = argv[1];
+    if (mode == "loss") {
+        int width = argc > 2 ? atoi(argv[2]) : 1024;
+        int height = argc > 3 ? atoi(argv[3]) : 512;
+        int frames = argc > 4 ? atoi(argv[4]) : 120;
+        return lossBench(width, height, frames);
+    } else if (mode == "bc1") {
+        int width = argc > 2 ? atoi(argv[2]) : 2048;
+        int height = argc > 3 ? atoi(argv[3]) : 1024;
+        int frames = argc > 4 ? atoi(argv[4]) : 30;
+        return bc1Bench(width, height, frames);
+    } else if (mode == "ttff") {
+        int width = argc > 2 ? atoi(argv[2]) : 2048;
+        int height = argc > 3 ? atoi(argv[3]) : 1024;
+        int joins = argc > 4 ? atoi(argv[4]) : 20;
+        return ttffBench(width, height, joins);
+    } else if (mode == "shm") {
+        int width = argc > 2 ? atoi(argv[2]) : 2048;
+        int height = argc > 3 ? atoi(argv[3]) : 1024;
+        int frames = argc > 4 ? atoi(argv[4]) : 120;
+        int readers = argc > 5 ? atoi(argv[5]) : 3;
+        return shmBench(width, height, frames, readers);
+    } else if (mode == "pps") {
+        int width = argc > 2 ? atoi(argv[2]) : 1280;
+        int height = argc > 3 ? atoi(argv[3]) : 720;
+        int frames = argc > 4 ? atoi(argv[4]) : 120;
+        return ppsBench(width, height, frames);
+    } else if (mode == "codec") {
+        int width = argc > 2 ? atoi(argv[2]) : 1024;
+        int height = argc > 3 ? atoi(argv[3]) : 768;
+        int frames = argc > 4 ? atoi(argv[4]) : 240;
+        return codecBench(width, height, frames);
+    } else if (mode == "restart") {
+        int width = argc > 2 ? atoi(argv[2]) : 1024;
+        int height = argc > 3 ? atoi(argv[3]) : 512;
+        int frames = argc > 4 ? atoi(argv[4]) : 60;
+        return restartBench(width, height, frames);
+    }
+    usage();
+    return 1;
+}
@@ -0,0 +1,598 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "al_ext/replication/al_FrameMulticast.hpp"
+#ifdef AL_SOAK_NDI_REPLAY
+#include "al_ext/ndi/al_NDIPixelFormat.hpp"
+#include "al_ext/ndi/al_NDIRecording.hpp"
+#endif
+
+// Soak test for the replication path before a long installation: a
+// primary and N headless replicas run as separate processes on localhost
+// for hours, while packet loss and CPU load are switched on and off, and
+// every process's memory, frame pacing and lag are logged over time.
+//
+//   ReplicationSoak [--replicas N] [--duration T] [--interval T] [--phase T]
+//                   [--size WxH] [--fps F] [--loss P] [--load N] [--fec F]
+//                   [--port P] [--report PREFIX] [--replay FILE]
+//
+//   --replicas  replica processes (3)
+//   --duration  how long to run (1h); times take an s, m or h suffix
+//   --interval  reporting interval (10s)
+//   --phase     length of each load phase (5m); phases cycle through
+//               clean, loss, load, loss+load
+//   --size      synthetic frame size (1024x768)
+//   --fps       primary frame rate (60), also the replicas' display rate
+//   --loss      fraction of datagrams each replica drops in loss phases (0.02)
+//   --load      busy threads run in load phases (one per core)
+//   --fec       FEC parity overhead on the primary (0, off)
+//   --port      multicast port (16201)
+//   --report    output prefix (soak): PREFIX.csv holds one row per process
+//               per interval, PREFIX.txt the summary that is also printed
+//   --replay    replay an NDI recording instead of the synthetic pattern,
+//               looped at its recorded pace (builds with al_ndi only)
+//
+// Each frame carries its generation and a checksum of the pixels in its
+// metadata, so replicas detect corruption whatever the source. The exit
+// status is 1 if a process died, a frame arrived corrupted or a replica
+// went a whole interval without a frame. Ctrl+C ends the run early and
+// still writes the summary.
+
+using namespace al;
+using namespace std;
+
+namespace {
+
+const char* kGroup = "239.255.42.99";
+const char* kInterface = "127.0.0.1";
+
+enum Role { kPrimary = 0, kReplica = 1 };
+
+struct Options {
+    Options()
+        : replicas(3), durationS(3600.0), intervalS(10.0), phaseS(300.0)
+        , width(1024), height(768), fps(60.0), loss(0.02f)
+        , loadThreads((int)max(1u, thread::hardware_concurrency())), fec(0.0f)
+        , port(16201), report("soak") {}
+    int replicas;
+    double durationS;
+    double intervalS;
+    double phaseS;
+    int width;
+    int height;
+    double fps;
+    float loss;
+    int loadThreads;
+    float fec;
+    uint16_t port;
+    string report;
+    string replay;
+};
+
+// Sent from each process to the harness once per interval over a pipe;
+// smaller than PIPE_BUF, so every write arrives whole
+struct IntervalReport {
+    int32_t role;
+    int32_t index;
+    uint32_t generation;  // latest published or received
+    uint32_t frames;      // published or received this interval
+    float frameMs[3];     // p50, p99, max time between frames
+    float lagMs[3];       // replicas: publish to display, p50, p99, max
+    uint64_t dropped;     // primary: superseded frames, replicas: incomplete ones
+    uint64_t corrupted;
+    uint64_t nacks;       // sent by replicas, received by the primary
+    uint64_t injectedLoss;
+    uint64_t recovered;   // chunks rebuilt from FEC parity
+};
+
+// Attached to every frame as its metadata
+struct FrameCheck {
+    uint32_t generation;
+    uint32_t checksum;
+};
+
+const char* kPhaseNames[4] = {"clean", "loss", "load", "loss+load"};
+
+volatile sig_atomic_t gStop = 0;
+
+void onSignal(int) {
+    gStop = 1;
+}
+
+int phaseAt(int64_t startNs, const Options& options) {
+    double elapsed = (steadyClockNs() - startNs) / 1e9;
+    return (int)(elapsed / options.phaseS) % 4;
+}
+
+bool lossPhase(int phase) { return (phase & 1) != 0; }
+bool loadPhase(int phase) { return (phase & 2) != 0; }
+
+// Seconds from "90", "90s", "30m" or "8h"
+bool parseDuration(const char* text, double& seconds) {
+    char* end = nullptr;
+    double value = strtod(text, &end);
+    if (end == text || value <= 0.0) return false;
+    if (*end == 'h') value *= 3600.0;
+    else if (*end == 'm') value *= 60.0;
+    else if (*end != 's' && *end != '\0') return false;
+    seconds = value;
+    return true;
+}
+
+// Sampled like ReplicationBench's pattern check, so a replica can verify
+// every frame without touching all of it
+uint32_t frameChecksum(const uint8_t* data, size_t bytes, uint32_t generation) {
+    uint32_t hash = 2166136261u ^ generation;
+    for (size_t i = 0; i < bytes; i += 4099) hash = (hash ^ data[i]) * 16777619u;
+    if (bytes) hash = (hash ^ data[bytes - 1]) * 16777619u;
+    return hash;
+}
+
+void fillPattern(vector<uint8_t>& frame, uint32_t generation) {
+    for (size_t i = 0; i < frame.size(); i++) frame[i] = (uint8_t)(i * 31 + generation);
+}
+
+float percentile(vector<float>& values, double p) {
+    if (values.empty()) return 0.0f;
+    size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+    nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void summarise(vector<float>& values, float* out) {
+    out[2] = values.empty() ? 0.0f : *max_element(values.begin(), values.end());
+    out[1] = percentile(values, 0.99);
+    out[0] = percentile(values, 0.5);
+    values.clear();
+}
+
+// Paces a process at the frame rate and sends its report at every
+// interval boundary, counted from the harness's start time
+class Ticker {
+public:
+    Ticker(int64_t startNs, const Options& options, int fd)
+        : mPeriodNs((int64_t)(1e9 / options.fps))
+        , mIntervalNs((int64_t)(options.intervalS * 1e9)), mFd(fd)
+        , mNextNs(steadyClockNs()), mNextReportNs(startNs + mIntervalNs) {}
+
+    void wait() {
+        mNextNs += mPeriodNs;
+        int64_t now = steadyClockNs();
+        // After a stall, resume the cadence instead of bursting to catch up
+        if (mNextNs < now - mPeriodNs) mNextNs = now;
+        if (mNextNs > now) this_thread::sleep_for(chrono::nanoseconds(mNextNs - now));
+    }
+
+    bool reportDue() const { return steadyClockNs() >= mNextReportNs; }
+
+    void send(const IntervalReport& report) {
+        while (mNextReportNs <= steadyClockNs()) mNextReportNs += mIntervalNs;
+        if (write(mFd, &report, sizeof(report)) != (ssize_t)sizeof(report)) gStop = 1;
+    }
+
+private:
+    int64_t mPeriodNs;
+    int64_t mIntervalNs;
+    int mFd;
+    int64_t mNextNs;
+    int64_t mNextReportNs;
+};
+
+int runPrimary(const Options& options, int64_t startNs, int64_t endNs, int fd) {
+    FrameMulticastSender::Config sc;
+    sc.group = kGroup;
+    sc.port = options.port;
+    sc.interfaceAddress = kInterface;
+    sc.fecOverhead = options.fec;
+    FrameMulticastSender sender;
+    if (!sender.init(sc)) return 1;
+
+    int width = options.width;
+    int height = options.height;
+    vector<uint8_t> frame((size_t)width * height * 4);
+#ifdef AL_SOAK_NDI_REPLAY
+    NDIReplaySource replay;
+    if (!options.replay.empty()) {
+        if (!replay.open(options.replay.c_str())) return 1;
+        replay.loop(true);
+        replay.speed(NDIReplaySource::ORIGINAL);
+    }
+#endif
+
+    IntervalReport report;
+    memset(&report, 0, sizeof(report));
+    report.role = kPrimary;
+    vector<float> frameMs;
+    int64_t lastPublishNs = 0;
+    uint32_t generation = 0;
+    Ticker ticker(startNs, options, fd);
+
+    while (!gStop && steadyClockNs() < endNs) {
+        bool produced = options.replay.empty();
+        if (produced) {
+            fillPattern(frame, generation + 1);
+        }
+#ifdef AL_SOAK_NDI_REPLAY
+        else {
+            // Not every tick has a due frame at the recorded pace
+            produced = replay.consume([&](const NDIlib_video_frame_v2_t& f) {
+                width = f.xres;
+                height = f.yres;
+                frame.resize((size_t)width * height * 4);
+                NDIFormat::visitFormat(f.FourCC, [&](auto traits) {
+                    typedef decltype(traits) Format;
+                    int stride = f.line_stride_in_bytes ? f.line_stride_in_bytes : Format::lineStride(width);
+                    Format::toRGBA(f.p_data, stride, width, height, frame.data());
+                });
+            });
+        }
+#endif
+        if (produced) {
+            generation++;
+            FrameCheck check = {generation, frameChecksum(frame.data(), frame.size(), generation)};
+            sender.publish(frame.data(), frame.size(), width, height, ReplicatedFrame::RGBA8,
+                           generation, 0, (const uint8_t*)&check, sizeof(check));
+            int64_t now = steadyClockNs();
+            if (lastPublishNs) frameMs.push_back((now - lastPublishNs) / 1e6f);
+            lastPublishNs = now;
+            report.frames++;
+        }
+
+        if (ticker.reportDue()) {
+            FrameMulticastSender::Stats stats = sender.stats();
+            report.generation = generation;
+            summarise(frameMs, report.frameMs);
+            report.dropped = stats.framesSuperseded;
+            report.nacks = stats.nacksReceived;
+            ticker.send(report);
+            report.frames = 0;
+        }
+        ticker.wait();
+    }
+    return 0;
+}
+
+int runReplica(const Options& options, int index, int64_t startNs, int64_t endNs, int fd) {
+    FrameMulticastReceiver::Config rc;
+    rc.group = kGroup;
+    rc.port = options.port;
+    rc.interfaceAddress = kInterface;
+    FrameMulticastReceiver receiver;
+    if (!receiver.init(rc)) return 1;
+
+    IntervalReport report;
+    memset(&report, 0, sizeof(report));
+    report.role = kReplica;
+    report.index = index;
+    vector<float> frameMs;
+    vector<float> lagMs;
+    int64_t lastFrameNs = 0;
+    Ticker ticker(startNs, options, fd);
+
+    // Polled once per display frame, as the render loop would
+    while (!gStop && steadyClockNs() < endNs) {
+        receiver.dropRate(lossPhase(phaseAt(startNs, options)) ? options.loss : 0.0f);
+
+        ReplicatedFrame f;
+        if (receiver.latestFrame(f)) {
+            FrameCheck check;
+            bool valid = f.metadata && f.metadataBytes == sizeof(check);
+            if (valid) {
+                memcpy(&check, f.metadata, sizeof(check));
+                valid = check.generation == f.generation &&
+                        check.checksum == frameChecksum(f.data, f.bytes, f.generation);
+            }
+            if (!valid) report.corrupted++;
+
+            int64_t now = steadyClockNs();
+            if (lastFrameNs) frameMs.push_back((now - lastFrameNs) / 1e6f);
+            lastFrameNs = now;
+            lagMs.push_back((frameClockNs() - f.timestampNs) / 1e6f);
+            report.generation = f.generation;
+            report.frames++;
+        }
+
+        if (ticker.reportDue()) {
+            FrameMulticastReceiver::Stats stats = receiver.stats();
+            summarise(frameMs, report.frameMs);
+            summarise(lagMs, report.lagMs);
+            report.dropped = stats.framesDropped;
+            report.nacks = stats.nacksSent;
+            report.injectedLoss = stats.chunksInjectedLoss;
+            report.recovered = stats.chunksRecovered;
+            ticker.send(report);
+            report.frames = 0;
+        }
+        ticker.wait();
+    }
+    return 0;
+}
+
+// Resident set size of pid in MB, 0 if /proc is not available
+double residentMB(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/statm", (int)pid);
+    ifstream statm(path);
+    long pages = 0;
+    long resident = 0;
+    if (!(statm >> pages >> resident)) return 0.0;
+    return resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+// Least-squares slope of y over x
+double slope(const vector<double>& x, const vector<double>& y) {
+    size_t n = x.size();
+    if (n < 2) return 0.0;
+    double mx = 0.0, my = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        mx += x[i];
+        my += y[i];
+    }
+    mx /= n;
+    my /= n;
+    double sxy = 0.0, sxx = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sxy += (x[i] - mx) * (y[i] - my);
+        sxx += (x[i] - mx) * (x[i] - mx);
+    }
+    return sxx > 0.0 ? sxy / sxx : 0.0;
+}
+
+// Everything the harness keeps about one child process
+struct Process {
+    Process()
+        : pid(-1), fd(-1), exited(false), status(0), stalls(0), frames(0)
+        , worstFrameMs(0.0), worstLagMs(0.0) {
+        memset(&last, 0, sizeof(last));
+    }
+    string name;
+    pid_t pid;
+    int fd;
+    bool exited;
+    int status;
+    int stalls;       // intervals without a frame
+    uint64_t frames;
+    IntervalReport last;
+    // Per interval, the first one skipped as warm-up
+    vector<double> hours;
+    vector<double> rssMB;
+    vector<double> frameP99;
+    vector<double> lagP99;
+    double worstFrameMs;
+    double worstLagMs;
+};
+
+void writeSummary(const Options& options, vector<Process>& processes, double elapsedS,
+                  bool& failed, ostream& out) {
+    out << fixed << setprecision(2);
+    out << "Soak: " << options.replicas << " replicas, " << elapsedS / 3600.0 << " h of "
+        << options.durationS / 3600.0 << " h, " << options.fps << " fps, loss "
+        << options.loss * 100.0f << "% and " << options.loadThreads << " load threads in "
+        << options.phaseS << " s phases" << endl;
+    for (Process& p : processes) {
+        size_t n = p.hours.size();
+        out << "  " << p.name << ": " << p.frames << " frames";
+        if (n) {
+            out << ", RSS " << p.rssMB.front() << " -> " << p.rssMB.back() << " MB ("
+                << slope(p.hours, p.rssMB) << " MB/h)"
+                << ", frame p99 " << p.frameP99.front() << " -> " << p.frameP99.back()
+                << " ms (max " << p.worstFrameMs << ")";
+            if (p.last.role == kReplica) {
+                out << ", lag p99 " << p.lagP99.front() << " -> " << p.lagP99.back()
+                    << " ms (max " << p.worstLagMs << ", " << slope(p.hours, p.lagP99) << " ms/h)";
+            }
+        }
+        out << ", dropped " << p.last.dropped << ", corrupted " << p.last.corrupted;
+        if (p.stalls) out << ", " << p.stalls << " stalled intervals";
+        if (p.exited && (!WIFEXITED(p.status) || WEXITSTATUS(p.status) != 0)) {
+            out << ", DIED";
+            failed = true;
+        }
+        out << endl;
+        if (p.last.corrupted || p.stalls) failed = true;
+    }
+    out << (failed ? "FAIL" : "PASS") << endl;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) return false;
+        bool ok = true;
+        if (arg == "--replicas") ok = (options.replicas = atoi(value)) > 0;
+        else if (arg == "--duration") ok = parseDuration(value, options.durationS);
+        else if (arg == "--interval") ok = parseDuration(value, options.intervalS);
+        else if (arg == "--phase") ok = parseDuration(value, options.phaseS);
+        else if (arg == "--size") ok = sscanf(value, "%dx%d", &options.width, &options.height) == 2 &&
+                                       options.width > 0 && options.height > 0;
+        else if (arg == "--fps") ok = (options.fps = atof(value)) > 0.0;
+        else if (arg == "--loss") ok = (options.loss = (float)atof(value)) >= 0.0f && options.loss < 1.0f;
+        else if (arg == "--load") ok = (options.loadThreads = atoi(value)) >= 0;
+        else if (arg == "--fec") ok = (options.fec = (float)atof(value)) >= 0.0f;
+        else if (arg == "--port") ok = (options.port = (uint16_t)atoi(value)) != 0;
+        else if (arg == "--report") options.report = value;
+        else if (arg == "--replay") options.replay = value;
+        else return false;
+        if (!ok) return false;
+        i++;
+    }
+#ifndef AL_SOAK_NDI_REPLAY
+    if (!options.replay.empty()) {
+        cout << "--replay needs ReplicationSoak built with al_ndi" << endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+void usage() {
+    cout << "Usage:" << endl;
+    cout << "  ReplicationSoak [--replicas N] [--duration T] [--interval T] [--phase T]" << endl;
+    cout << "                  [--size WxH] [--fps F] [--loss P] [--load N] [--fec F]" << endl;
+    cout << "                  [--port P] [--report PREFIX] [--replay FILE]" << endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    ofstream csv(options.report + ".csv");
+    if (!csv) {
+        cout << "Cannot write " << options.report << ".csv" << endl;
+        return 1;
+    }
+    csv << "elapsed_s,phase,process,pid,rss_mb,frames,fps,frame_p50_ms,frame_p99_ms,frame_max_ms,"
+           "lag_p50_ms,lag_p99_ms,lag_max_ms,generation,dropped,corrupted,nacks,injected_loss,recovered"
+        << endl;
+
+    // Handlers are inherited, so Ctrl+C on the process group or SIGTERM
+    // from the harness lets every process finish its loop
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    int64_t startNs = steadyClockNs();
+    int64_t endNs = startNs + (int64_t)(options.durationS * 1e9);
+
+    // Fork before any thread exists; the primary is process 0
+    vector<Process> processes(options.replicas + 1);
+    for (size_t i = 0; i < processes.size(); i++) {
+        Process& p = processes[i];
+        p.name = i == 0 ? "primary" : "replica" + to_string(i);
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            return 1;
+        }
+        p.pid = fork();
+        if (p.pid == 0) {
+            close(fds[0]);
+            for (size_t j = 0; j < i; j++) close(processes[j].fd);
+            int code = i == 0 ? runPrimary(options, startNs, endNs, fds[1])
+                              : runReplica(options, (int)i, startNs, endNs, fds[1]);
+            close(fds[1]);
+            _exit(code);
+        }
+        close(fds[1]);
+        if (p.pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        p.fd = fds[0];
+        p.last.role = i == 0 ? kPrimary : kReplica;
+    }
+
+    // Load runs in the harness itself, competing with every process on the host
+    atomic<bool> loadRunning(true);
+    vector<thread> load;
+    for (int i = 0; i < options.loadThreads; i++) {
+        load.emplace_back([&]() {
+            volatile double sink = 1.0;
+            while (loadRunning) {
+                if (!loadPhase(phaseAt(startNs, options))) {
+                    this_thread::sleep_for(chrono::milliseconds(50));
+                    continue;
+                }
+                int64_t until = steadyClockNs() + 10000000;
+                while (steadyClockNs() < until) sink = sqrt(sink + 1.0);
+            }
+        });
+    }
+
+    cout << "Soaking " << options.replicas << " replicas for " << options.durationS << " s, writing "
+         << options.report << ".csv" << endl;
+
+    int running = (int)processes.size();
+    bool stopping = false;
+    while (running > 0) {
+        int64_t now = steadyClockNs();
+        if (!stopping && (gStop || now >= endNs + (int64_t)2e9)) {
+            // Children stop on their own at endNs; this catches any that hang
+            for (Process& p : processes) {
+                if (!p.exited) kill(p.pid, SIGTERM);
+            }
+            stopping = true;
+        }
+
+        vector<pollfd> fds;
+        vector<Process*> owners;
+        for (Process& p : processes) {
+            if (p.fd < 0) continue;
+            pollfd pfd = {p.fd, POLLIN, 0};
+            fds.push_back(pfd);
+            owners.push_back(&p);
+        }
+        if (poll(fds.data(), fds.size(), 200) <= 0) continue;
+
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Process& p = *owners[i];
+            IntervalReport report;
+            ssize_t n = read(p.fd, &report, sizeof(report));
+            if (n != (ssize_t)sizeof(report)) {
+                // End of the pipe: the process finished or died
+                close(p.fd);
+                p.fd = -1;
+                waitpid(p.pid, &p.status, 0);
+                p.exited = true;
+                running--;
+                continue;
+            }
+
+            double elapsed = (steadyClockNs() - startNs) / 1e9;
+            double rss = residentMB(p.pid);
+            int phase = (int)((elapsed - options.intervalS * 0.5) / options.phaseS) % 4;
+            p.last = report;
+            p.frames += report.frames;
+            if (report.frames == 0 && report.role == kReplica) p.stalls++;
+            csv << setprecision(1) << fixed << elapsed << ',' << kPhaseNames[max(phase, 0)] << ','
+                << p.name << ',' << p.pid << ',' << rss << ',' << report.frames << ','
+                << report.frames / options.intervalS << setprecision(3);
+            for (float v : report.frameMs) csv << ',' << v;
+            for (float v : report.lagMs) csv << ',' << v;
+            csv << ',' << report.generation << ',' << report.dropped << ',' << report.corrupted << ','
+                << report.nacks << ',' << report.injectedLoss << ',' << report.recovered << endl;
+
+            if (elapsed > options.intervalS * 1.5) {
+                p.hours.push_back(elapsed / 3600.0);
+                p.rssMB.push_back(rss);
+                p.frameP99.push_back(report.frameMs[1]);
+                p.lagP99.push_back(report.lagMs[1]);
+                p.worstFrameMs = max(p.worstFrameMs, (double)report.frameMs[2]);
+                p.worstLagMs = max(p.worstLagMs, (double)report.lagMs[2]);
+            }
+        }
+    }
+
+    loadRunning = false;
+    for (thread& t : load) t.join();
+
+    bool failed = false;
+    double elapsedS = (steadyClockNs() - startNs) / 1e9;
+    ostringstream summary;
+    writeSummary(options, processes, elapsedS, failed, summary);
+    cout << summary.str();
+    ofstream(options.report + ".txt") << summary.str();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+#ifndef INCLUDE_AL_EQUIRECT_SPHERE_HPP
+#define INCLUDE_AL_EQUIRECT_SPHERE_HPP
+
+#include <stdint.h>
+
+#include "al/graphics/al_OpenGL.hpp"
+
+namespace al {
+
+// Draws an equirectangular (360 x 180 degree) texture around the viewer.
+// Rather than a finely tessellated sphere with per-vertex texture
+// coordinates, a small icosphere is rasterised and every fragment looks
+// the texture up from its own direction: the mapping is exact however
+// coarse the proxy, and the cost per pixel does not grow with the video
+// resolution.
+//
+// Frames are sampled trilinearly with anisotropic filtering, so the rows
+// that converge at the poles are averaged instead of aliasing, and the
+// longitude seam does not snap to the smallest mip. Mip levels are
+// rebuilt on the GPU once per new frame (frameUploaded), never per draw.
+class EquirectSphere {
+public:
+    struct Config {
+        Config() : radius(1.0f), segments(4), mipmaps(true), maxAnisotropy(16.0f) {}
+        float radius;        // of the proxy, centred on the model origin
+        int segments;        // per icosahedron edge; 4 = 320 triangles
+        bool mipmaps;        // false samples level 0 bilinearly
+        float maxAnisotropy; // clamped to the driver limit, 1 disables
+    };
+
+    struct Stats {
+        uint64_t mipmapsGenerated;
+        uint64_t framesSkipped; // frameUploaded with an unchanged generation
+    };
+
+    EquirectSphere();
+    ~EquirectSphere();
+
+    // Needs a current GL 3.3 context
+    bool init(const Config& config = Config());
+    void cleanup();
+
+    // Call after uploading frame generation into texture; rebuilds its mip
+    // chain unless that texture already has this generation's mips.
+    // Compressed textures keep level 0 only (GL cannot generate their mips).
+    void frameUploaded(GLuint texture, uint32_t generation, bool compressed = false);
+
+    // Draws the sphere with texture bound to unit 0; modelViewProjection is
+    // a column-major 4x4 matrix, e.g. (proj * view * model).elems()
+    void draw(GLuint texture, const float* modelViewProjection);
+
+    bool isInitialized() const { return mProgram != 0; }
+    float anisotropy() const { return mAnisotropy; }
+    const Stats& stats() const { return mStats; }
+
+private:
+    Config mConfig;
+    GLuint mProgram;
+    GLuint mVAO;
+    GLuint mVBO;
+    GLsizei mVertexCount;
+    GLint mMatrixLocation;
+    GLint mSamplerLocation;
+    float mAnisotropy;
+
+    // Texture whose mips are current, and the generation they were built from
+    GLuint mMipmappedTexture;
+    uint32_t mMipmappedGeneration;
+    bool mMipmapped; // false for a compressed mMipmappedTexture
+
+    Stats mStats;
+
+    EquirectSphere(const EquirectSphere&) = delete;
+    EquirectSphere& operator=(const EquirectSphere&) = delete;
+};
+
+} // namespace al
+
+#endif
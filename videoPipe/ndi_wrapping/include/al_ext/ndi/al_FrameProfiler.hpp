@@ -0,0 +1,170 @@
+#ifndef INCLUDE_AL_FRAME_PROFILER_HPP
+#define INCLUDE_AL_FRAME_PROFILER_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "al/graphics/al_OpenGL.hpp"
+
+namespace al {
+
+// Per-stage CPU and GPU timing for the render loop. Scopes mark stages such
+// as the sphere draw, the texture upload or NDISender's blit and readback;
+// each records steady-clock time on the CPU and a GL_TIMESTAMP query pair
+// on the GPU. Timestamps rather than GL_TIME_ELAPSED so scopes can nest.
+//
+// Query results are read back latencyFrames later, and only once the
+// driver reports them available, so profiling never stalls the pipeline;
+// a frame whose results are still pending when its queries are needed
+// again is dropped from the GPU statistics. After the first frames the
+// profiler does not allocate.
+//
+// Results feed smoothed per-stage statistics, an optional bar overlay
+// drawn into the current framebuffer, and a Chrome trace (chrome://tracing,
+// Perfetto) with the CPU and GPU timelines on separate tracks.
+class FrameProfiler {
+public:
+    struct Config {
+        Config() : latencyFrames(4), maxScopes(32), traceEvents(65536), gpu(true), budgetMs(1000.0 / 60.0) {}
+        int latencyFrames; // frames between issuing queries and reading them back
+        int maxScopes;     // per frame, including the frame itself; extra scopes are ignored
+        int traceEvents;   // CPU and GPU events kept for writeChromeTrace, 0 = no trace
+        bool gpu;          // false times the CPU only, no context needed
+        double budgetMs;   // full-width mark of the overlay bars
+    };
+
+    struct StageStats {
+        std::string name;
+        int depth;        // nesting level, 0 = the frame
+        double cpuMs;     // smoothed
+        double gpuMs;     // smoothed, 0 until GPU results arrive
+        double cpuPeakMs; // since resetPeaks()
+        double gpuPeakMs;
+        uint64_t samples;
+    };
+
+    struct Stats {
+        uint64_t frames;
+        uint64_t gpuFramesRead;
+        uint64_t gpuFramesDropped; // results not available after latencyFrames
+        uint64_t scopesDropped;    // over maxScopes
+    };
+
+    // Times a scope from construction to destruction; a null profiler
+    // makes it a no-op, so instrumented code needs no checks
+    class Scope {
+    public:
+        Scope(FrameProfiler* profiler, const char* name)
+            : mProfiler(profiler), mIndex(profiler ? profiler->begin(name) : -1) {}
+        ~Scope() { if (mProfiler) mProfiler->end(mIndex); }
+
+    private:
+        FrameProfiler* mProfiler;
+        int mIndex;
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    FrameProfiler();
+    ~FrameProfiler();
+
+    // Needs a current GL 3.3 context unless config.gpu is false
+    bool init(const Config& config = Config());
+    void cleanup();
+
+    // Bracket one rendered frame, e.g. start of onAnimate to end of onDraw
+    void beginFrame();
+    void endFrame();
+
+    // name must outlive the profiler (a string literal); returns the
+    // scope index to pass to end(), -1 if the scope was dropped
+    int begin(const char* name);
+    void end(int scope);
+
+    // Stages in first-seen order; stage 0 is the whole frame
+    const std::vector<StageStats>& stages() const { return mStages; }
+    const Stats& stats() const { return mStats; }
+    void resetPeaks();
+
+    // One line per stage: name, CPU and GPU ms, peaks
+    std::string report() const;
+
+    // Draws one bar pair per stage (CPU blue, GPU orange, scaled to
+    // budgetMs) in the top-left corner of the current viewport
+    void drawOverlay();
+
+    // Writes the buffered events as Chrome trace JSON
+    bool writeChromeTrace(const std::string& path) const;
+
+    bool isInitialized() const { return mInitialized; }
+    bool isGpuEnabled() const { return mGpuEnabled; }
+
+private:
+    struct Record {
+        int stage;
+        int64_t cpuBeginNs;
+        int64_t cpuEndNs;
+        bool ended;
+    };
+
+    struct Frame {
+        uint64_t number;
+        int count;    // records used
+        bool pending; // GPU queries issued, results not read yet
+    };
+
+    struct TraceEvent {
+        int stage;
+        bool gpu;
+        int64_t beginNs; // steady clock, GPU events shifted onto it
+        int64_t durationNs;
+        uint64_t frame;
+    };
+
+    int stageFor(const char* name, int depth);
+    Record& record(int frame, int scope) { return mRecords[frame * mConfig.maxScopes + scope]; }
+    GLuint query(int frame, int scope, bool endQuery) const {
+        return mQueries[(frame * mConfig.maxScopes + scope) * 2 + (endQuery ? 1 : 0)];
+    }
+    void collect();
+    bool readFrame(int frame);
+    void addTrace(int stage, bool gpu, int64_t beginNs, int64_t durationNs, uint64_t frame);
+    void syncClocks();
+
+    Config mConfig;
+    bool mInitialized;
+    bool mGpuEnabled;
+
+    std::vector<Frame> mFrames; // latencyFrames ring
+    std::vector<Record> mRecords;
+    std::vector<GLuint> mQueries;
+    int mCurrent;  // frame being recorded, -1 outside beginFrame/endFrame
+    int mDepth;
+    uint64_t mFrameNumber;
+
+    std::vector<StageStats> mStages;
+    std::vector<const char*> mStageNames; // pointers first, strcmp on a miss
+
+    std::vector<TraceEvent> mTrace; // ring of traceEvents
+    size_t mTraceNext;
+    bool mTraceWrapped;
+
+    int64_t mGpuOffsetNs; // steady clock minus GL_TIMESTAMP
+    uint64_t mLastSyncFrame;
+
+    Stats mStats;
+
+    GLuint mProgram;
+    GLuint mVAO;
+    GLint mRectLocation;
+    GLint mColorLocation;
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+};
+
+} // namespace al
+
+#endif
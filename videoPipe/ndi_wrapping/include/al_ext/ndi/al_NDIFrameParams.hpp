@@ -0,0 +1,55 @@
+#ifndef INCLUDE_AL_NDI_FRAME_PARAMS_HPP
+#define INCLUDE_AL_NDI_FRAME_PARAMS_HPP
+
+#include <stddef.h>
+
+namespace al {
+
+// A small block of named float parameters that belongs to one video frame,
+// such as the audio onset, spectral centroid and flux the frame was
+// rendered with. NDISender attaches it to the frame's NDI metadata and
+// NDIFrameSource parses it back, so the values stay aligned with the
+// pixels instead of free-running next to them.
+//
+// On the wire it is one XML element, which NDI requires of metadata:
+//   <al_params onset="0.25" cent="1830" flux="0.07"/>
+// Fixed capacity and no allocation, so it can be filled every frame.
+class NDIFrameParams {
+public:
+    static const int kMaxParams = 16;
+    static const int kMaxNameLength = 15;
+
+    NDIFrameParams() : mCount(0) {}
+
+    // Adds or overwrites name; returns false if the block is full or the
+    // name is empty, too long or not a valid XML attribute name
+    bool set(const char* name, float value);
+    float get(const char* name, float fallback = 0.0f) const;
+    bool has(const char* name) const { return find(name) >= 0; }
+
+    int size() const { return mCount; }
+    bool empty() const { return mCount == 0; }
+    const char* name(int i) const { return mNames[i]; }
+    float value(int i) const { return mValues[i]; }
+    void clear() { mCount = 0; }
+
+    // Writes the element into out, NUL-terminated; returns its length
+    // without the terminator, or 0 if it does not fit in capacity
+    size_t toXml(char* out, size_t capacity) const;
+
+    // Replaces the contents with the first <al_params> element in xml, which
+    // may hold other metadata around it; returns false if there is none
+    bool fromXml(const char* xml);
+    bool fromXml(const char* xml, size_t length);
+
+private:
+    int find(const char* name) const;
+
+    char mNames[kMaxParams][kMaxNameLength + 1];
+    float mValues[kMaxParams];
+    int mCount;
+};
+
+} // namespace al
+
+#endif
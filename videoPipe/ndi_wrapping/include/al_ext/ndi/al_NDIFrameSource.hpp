@@ -0,0 +1,82 @@
+#ifndef INCLUDE_AL_NDI_FRAME_SOURCE_HPP
+#define INCLUDE_AL_NDI_FRAME_SOURCE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <Processing.NDI.Lib.h>
+
+#include "al/graphics/al_Texture.hpp"
+#include "al_ext/ndi/al_NDIFrameParams.hpp"
+
+namespace al {
+
+// Anything that produces NDI video frames into a texture: the live
+// NDIReceiver or a file-backed NDIReplaySource. Apps hold a pointer to
+// this so a recording can stand in for a network source.
+class NDIFrameSource {
+public:
+    NDIFrameSource() : mWidth(0), mHeight(0), mGeneration(0) {}
+    virtual ~NDIFrameSource() {}
+
+    // Uploads the next frame into tex, returns false if there is none
+    virtual bool update(Texture& tex);
+
+    // Uploads the width x height region at x, y of the next frame to destX,
+    // destY of tex, which must already be large enough; rows are read in
+    // place through the GL unpack settings, padded strides included
+    bool updateRegion(Texture& tex, int x, int y, int width, int height, int destX = 0, int destY = 0);
+
+    // Hands the next frame to consumer(const NDIlib_video_frame_v2_t&) instead
+    // of uploading it; the pixels are only valid during the call
+    template <class Consumer>
+    bool consume(Consumer&& consumer) {
+        NDIlib_video_frame_v2_t frame;
+        if (!captureFrame(frame)) return false;
+        mWidth = frame.xres;
+        mHeight = frame.yres;
+        readParams(frame);
+        consumer(static_cast<const NDIlib_video_frame_v2_t&>(frame));
+        releaseFrame(frame);
+        mGeneration++;
+        return true;
+    }
+
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+
+    // Advances by one with every frame update() uploads, starting at 1; keep
+    // the last value seen per texture and only process when it changes
+    uint32_t generation() const { return mGeneration; }
+
+    // Parameter block the sender attached to the current frame (see
+    // NDISender::frameParams), empty if the frame carried none
+    const NDIFrameParams& frameParams() const { return mParams; }
+
+protected:
+    // Fetches the next due frame without blocking; every successful capture
+    // is followed by exactly one releaseFrame()
+    virtual bool captureFrame(NDIlib_video_frame_v2_t& frame) = 0;
+    virtual void releaseFrame(NDIlib_video_frame_v2_t& frame) {}
+
+    // Resizes tex when the frame dimensions change and submits the pixels
+    void uploadVideoFrame(const NDIlib_video_frame_v2_t& frame, Texture& tex);
+
+    // Pixels of frame in a layout GL can upload: the frame itself for formats
+    // GL reads directly, otherwise converted to RGBA in mConverted. Sets the
+    // GL format and the GL_UNPACK_ROW_LENGTH to use; nullptr if unsupported.
+    const void* uploadPixels(const NDIlib_video_frame_v2_t& frame, GLenum& format, int& rowLength);
+
+    // Replaces mParams with the block in the frame's metadata
+    void readParams(const NDIlib_video_frame_v2_t& frame);
+
+    int mWidth;
+    int mHeight;
+    uint32_t mGeneration;
+    std::vector<uint8_t> mConverted;
+    NDIFrameParams mParams;
+};
+
+} // namespace al
+
+#endif
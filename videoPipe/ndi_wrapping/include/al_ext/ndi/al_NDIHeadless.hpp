@@ -0,0 +1,42 @@
+#ifndef INCLUDE_AL_NDI_HEADLESS_HPP
+#define INCLUDE_AL_NDI_HEADLESS_HPP
+
+#include <string>
+
+// Offscreen OpenGL context for running the NDI pipeline without a window,
+// e.g. on render nodes and CI machines. Uses EGL; with no GPU present Mesa's
+// software rasterizer is picked up (force it with LIBGL_ALWAYS_SOFTWARE=1).
+// Only built when CMake is configured with -DAL_NDI_HEADLESS=ON.
+
+namespace al {
+
+class NDIHeadlessContext {
+public:
+    NDIHeadlessContext();
+    ~NDIHeadlessContext();
+
+    // Creates a core profile context, makes it current on the calling thread
+    // and loads the GL entry points. Render into FBOs; there is no default
+    // framebuffer to draw to.
+    bool create(int glMajor = 3, int glMinor = 3);
+    void destroy();
+
+    bool makeCurrent();
+    bool isCreated() const { return mContext != nullptr; }
+
+    // GL_RENDERER of the created context, e.g. "llvmpipe (LLVM 15.0.6, 256 bits)"
+    const std::string& renderer() const { return mRenderer; }
+
+private:
+    void* mDisplay;
+    void* mContext;
+    void* mSurface;
+    std::string mRenderer;
+
+    NDIHeadlessContext(const NDIHeadlessContext&) = delete;
+    NDIHeadlessContext& operator=(const NDIHeadlessContext&) = delete;
+};
+
+} // namespace al
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef INCLUDE_AL_NDI_MOSAIC_HPP
+#define INCLUDE_AL_NDI_MOSAIC_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "al/graphics/al_OpenGL.hpp"
+#include "al/graphics/al_Texture.hpp"
+#include "al_ext/ndi/al_NDIFrameSource.hpp"
+
+namespace al {
+
+// Composites several NDI inputs into regions of one equirectangular canvas.
+// Each input's latest frame lives in a layer of a GL_TEXTURE_2D_ARRAY; one
+// instanced draw paints the regions of the inputs that changed (plus any
+// input stacked on top of them) into the canvas, which keeps its previous
+// contents otherwise. Upload and fill cost scale with the changed inputs.
+//
+// The mosaic is itself an NDIFrameSource, so it can replace a single
+// receiver: update(canvas) returns true when the canvas changed.
+class NDIMosaic : public NDIFrameSource {
+public:
+    // Rectangles are normalized. The canvas x axis is longitude (0 = -180°)
+    // and y = 0 is the first row, the same orientation as an NDI frame.
+    // Regions may cross the 360° seam (x + width > 1) and wrap around.
+    struct Region {
+        Region(float x_ = 0, float y_ = 0, float w = 1, float h = 1)
+            : x(x_), y(y_), width(w), height(h)
+            , cropX(0), cropY(0), cropWidth(1), cropHeight(1)
+        {}
+        float x, y, width, height;                 // placement on the canvas
+        float cropX, cropY, cropWidth, cropHeight; // part of the input frame shown
+    };
+
+    struct Stats {
+        uint64_t composites;   // update() calls that redrew part of the canvas
+        uint64_t layerUploads; // input frames uploaded into the texture array
+        uint64_t inputsIdle;   // input polls that had no new frame
+        uint64_t regionsDrawn; // instances drawn, including seam wraps and overlaps
+    };
+
+    static const int kMaxInputs = 16;
+
+    NDIMosaic();
+    ~NDIMosaic();
+
+    // Needs a current GL 3.3 context. Layers start at layerWidth x layerHeight
+    // and grow if an input delivers a larger frame.
+    bool init(int canvasWidth, int canvasHeight, int layerWidth = 1920, int layerHeight = 1080);
+    void cleanup();
+
+    // Later inputs are drawn on top of earlier ones. Returns the input index or -1.
+    int addInput(NDIFrameSource* source, const Region& region);
+    void region(int input, const Region& region);
+    int inputCount() const { return (int)mInputs.size(); }
+
+    // Polls every input, uploads the new frames and repaints their regions
+    bool update(Texture& canvas) override;
+
+    // Background for canvas areas no input covers
+    void background(float r, float g, float b) { mBackground[0] = r; mBackground[1] = g; mBackground[2] = b; mFullRedraw = true; }
+
+    const Stats& stats() const { return mStats; }
+
+protected:
+    // The canvas is rendered on the GPU, there is no raw frame to hand out
+    bool captureFrame(NDIlib_video_frame_v2_t& frame) override { return false; }
+
+private:
+    struct Input {
+        NDIFrameSource* source;
+        Region region;
+        int frameWidth;  // size of the frame in the input's layer
+        int frameHeight;
+        bool hasFrame;
+    };
+
+    bool allocateLayers(int width, int height, int layers);
+    void uploadLayer(int layer, const NDIlib_video_frame_v2_t& frame);
+    static bool overlaps(const Region& a, const Region& b);
+
+    std::vector<Input> mInputs;
+    int mCanvasWidth;
+    int mCanvasHeight;
+    int mLayerWidth;
+    int mLayerHeight;
+    int mLayerCount;
+    float mBackground[3];
+    bool mFullRedraw;
+
+    GLuint mLayers;  // GL_TEXTURE_2D_ARRAY, one layer per input
+    GLuint mFBO;
+    GLuint mVAO;     // empty, quads are generated from gl_VertexID
+    GLuint mProgram;
+    GLint mRectLocation;
+    GLint mCropLocation;
+    GLint mLayerLocation;
+    GLint mSamplerLocation;
+
+    Stats mStats;
+
+    NDIMosaic(const NDIMosaic&) = delete;
+    NDIMosaic& operator=(const NDIMosaic&) = delete;
+};
+
+} // namespace al
+
+#endif
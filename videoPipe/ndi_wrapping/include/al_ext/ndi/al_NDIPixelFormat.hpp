@@ -0,0 +1,381 @@
+#ifndef INCLUDE_AL_NDI_PIXEL_FORMAT_HPP
+#define INCLUDE_AL_NDI_PIXEL_FORMAT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <Processing.NDI.Lib.h>
+
+#include <type_traits>
+
+#include "al/graphics/al_OpenGL.hpp"
+
+// Compile-time traits for the NDI pixel formats the wrappers handle. The
+// sender, receiver and uploader are templated on one of these, so stride
+// math, GL formats and conversion kernels are fixed at compile time. To add
+// a format, add its traits struct here and a case to visitFormat().
+//
+// Every format converts to and from tightly packed RGBA8, the layout of
+// the textures the apps render. YUV formats use BT.709 limited range.
+//
+//   fourCC          NDI FourCC of frames in this format
+//   receivable      NDI can be asked to deliver it (recvColorFormat)
+//   direct          GL can upload/read it as is (glFormat/glType,
+//                   bytesPerPixel), otherwise toRGBA/fromRGBA convert on
+//                   the CPU and the format has no bytesPerPixel
+//   lineStride(w)   default bytes per line of the first plane
+//   frameBytes(w, h, stride)  bytes of a whole frame, all planes
+
+namespace al {
+namespace NDIFormat {
+
+namespace detail {
+
+inline uint8_t clamp8(int v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+inline void yuvToRGBA(int y, int u, int v, uint8_t a, uint8_t* rgba) {
+    int c = 298 * (y - 16) + 128;
+    int d = u - 128;
+    int e = v - 128;
+    rgba[0] = clamp8((c + 459 * e) >> 8);
+    rgba[1] = clamp8((c - 55 * d - 136 * e) >> 8);
+    rgba[2] = clamp8((c + 541 * d) >> 8);
+    rgba[3] = a;
+}
+
+inline uint8_t lumaOf(const uint8_t* rgba) {
+    return (uint8_t)(((47 * rgba[0] + 157 * rgba[1] + 16 * rgba[2] + 128) >> 8) + 16);
+}
+
+// Chroma of the average of two (or four) pixels, summed RGB given
+inline uint8_t chromaU(int r, int g, int b, int count) {
+    return clamp8(((-26 * r - 87 * g + 112 * b) / count + 128) / 256 + 128);
+}
+
+inline uint8_t chromaV(int r, int g, int b, int count) {
+    return clamp8(((112 * r - 102 * g - 10 * b) / count + 128) / 256 + 128);
+}
+
+} // namespace detail
+
+struct BGRA {
+    static const NDIlib_FourCC_video_type_e fourCC = NDIlib_FourCC_type_BGRA;
+    static const bool receivable = true;
+    static const NDIlib_recv_color_format_e recvColorFormat = NDIlib_recv_color_format_BGRX_BGRA;
+    static const bool direct = true;
+    static const GLenum glFormat = GL_BGRA;
+    static const GLenum glType = GL_UNSIGNED_BYTE;
+    static const int bytesPerPixel = 4;
+
+    static int lineStride(int width) { return width * 4; }
+    static size_t frameBytes(int width, int height, int stride) { return (size_t)stride * height; }
+
+    static void toRGBA(const uint8_t* src, int stride, int width, int height, uint8_t* rgba) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = src + (size_t)y * stride;
+            uint8_t* d = rgba + (size_t)y * width * 4;
+            for (int x = 0; x < width; x++, s += 4, d += 4) {
+                d[0] = s[2]; d[1] = s[1]; d[2] = s[0]; d[3] = s[3];
+            }
+        }
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride) {
+        // The swizzle is its own inverse
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = rgba + (size_t)y * width * 4;
+            uint8_t* d = dst + (size_t)y * stride;
+            for (int x = 0; x < width; x++, s += 4, d += 4) {
+                d[0] = s[2]; d[1] = s[1]; d[2] = s[0]; d[3] = s[3];
+            }
+        }
+    }
+};
+
+struct RGBA {
+    static const NDIlib_FourCC_video_type_e fourCC = NDIlib_FourCC_type_RGBA;
+    static const bool receivable = true;
+    static const NDIlib_recv_color_format_e recvColorFormat = NDIlib_recv_color_format_RGBX_RGBA;
+    static const bool direct = true;
+    static const GLenum glFormat = GL_RGBA;
+    static const GLenum glType = GL_UNSIGNED_BYTE;
+    static const int bytesPerPixel = 4;
+
+    static int lineStride(int width) { return width * 4; }
+    static size_t frameBytes(int width, int height, int stride) { return (size_t)stride * height; }
+
+    static void toRGBA(const uint8_t* src, int stride, int width, int height, uint8_t* rgba) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = src + (size_t)y * stride;
+            uint8_t* d = rgba + (size_t)y * width * 4;
+            for (int x = 0; x < width * 4; x++) d[x] = s[x];
+        }
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = rgba + (size_t)y * width * 4;
+            uint8_t* d = dst + (size_t)y * stride;
+            for (int x = 0; x < width * 4; x++) d[x] = s[x];
+        }
+    }
+};
+
+// 4:2:2, one plane of U0 Y0 V0 Y1 per pixel pair
+struct UYVY {
+    static const NDIlib_FourCC_video_type_e fourCC = NDIlib_FourCC_type_UYVY;
+    static const bool receivable = true;
+    static const NDIlib_recv_color_format_e recvColorFormat = NDIlib_recv_color_format_UYVY_RGBA;
+    static const bool direct = false;
+    static const GLenum glFormat = GL_RGBA;
+    static const GLenum glType = GL_UNSIGNED_BYTE;
+
+    static int lineStride(int width) { return ((width + 1) & ~1) * 2; }
+    static size_t frameBytes(int width, int height, int stride) { return (size_t)stride * height; }
+
+    static void toRGBA(const uint8_t* src, int stride, int width, int height, uint8_t* rgba) {
+        toRGBA(src, stride, width, height, nullptr, rgba);
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride) {
+        fromRGBA(rgba, width, height, dst, stride, nullptr);
+    }
+
+    // Shared with UYVA, which adds an alpha plane of width bytes per line
+    static void toRGBA(const uint8_t* src, int stride, int width, int height,
+                       const uint8_t* alpha, uint8_t* rgba) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = src + (size_t)y * stride;
+            const uint8_t* a = alpha ? alpha + (size_t)y * width : nullptr;
+            uint8_t* d = rgba + (size_t)y * width * 4;
+            for (int x = 0; x < width; x += 2, s += 4) {
+                detail::yuvToRGBA(s[1], s[0], s[2], a ? a[x] : 255, d + x * 4);
+                if (x + 1 < width) detail::yuvToRGBA(s[3], s[0], s[2], a ? a[x + 1] : 255, d + x * 4 + 4);
+            }
+        }
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride,
+                         uint8_t* alpha) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = rgba + (size_t)y * width * 4;
+            uint8_t* d = dst + (size_t)y * stride;
+            uint8_t* a = alpha ? alpha + (size_t)y * width : nullptr;
+            for (int x = 0; x < width; x += 2, d += 4) {
+                const uint8_t* p0 = s + x * 4;
+                const uint8_t* p1 = x + 1 < width ? p0 + 4 : p0;
+                int r = p0[0] + p1[0], g = p0[1] + p1[1], b = p0[2] + p1[2];
+                d[0] = detail::chromaU(r, g, b, 2);
+                d[1] = detail::lumaOf(p0);
+                d[2] = detail::chromaV(r, g, b, 2);
+                d[3] = detail::lumaOf(p1);
+                if (a) {
+                    a[x] = p0[3];
+                    if (x + 1 < width) a[x + 1] = p1[3];
+                }
+            }
+        }
+    }
+};
+
+// UYVY followed by an 8-bit alpha plane with a stride of width
+struct UYVA {
+    static const NDIlib_FourCC_video_type_e fourCC = NDIlib_FourCC_type_UYVA;
+    static const bool receivable = true;
+    static const NDIlib_recv_color_format_e recvColorFormat = NDIlib_recv_color_format_fastest;
+    static const bool direct = false;
+    static const GLenum glFormat = GL_RGBA;
+    static const GLenum glType = GL_UNSIGNED_BYTE;
+
+    static int lineStride(int width) { return UYVY::lineStride(width); }
+    static size_t frameBytes(int width, int height, int stride) {
+        return (size_t)stride * height + (size_t)width * height;
+    }
+
+    static void toRGBA(const uint8_t* src, int stride, int width, int height, uint8_t* rgba) {
+        UYVY::toRGBA(src, stride, width, height, src + (size_t)stride * height, rgba);
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride) {
+        UYVY::fromRGBA(rgba, width, height, dst, stride, dst + (size_t)stride * height);
+    }
+};
+
+// 16-bit 4:2:2 semi-planar: a Y plane then an interleaved UV plane, same stride.
+// NDI delivers PA16 instead for sources with alpha.
+struct P216 {
+    static const NDIlib_FourCC_video_type_e fourCC = NDIlib_FourCC_type_P216;
+    static const bool receivable = true;
+    static const NDIlib_recv_color_format_e recvColorFormat = NDIlib_recv_color_format_best;
+    static const bool direct = false;
+    static const GLenum glFormat = GL_RGBA;
+    static const GLenum glType = GL_UNSIGNED_BYTE;
+
+    static int lineStride(int width) { return ((width + 1) & ~1) * 2; }
+    static size_t frameBytes(int width, int height, int stride) { return (size_t)stride * height * 2; }
+
+    static void toRGBA(const uint8_t* src, int stride, int width, int height, uint8_t* rgba) {
+        toRGBA(src, stride, width, height, nullptr, rgba);
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride) {
+        fromRGBA(rgba, width, height, dst, stride, nullptr);
+    }
+
+    // Shared with PA16, which adds a 16-bit alpha plane with the same stride
+    static void toRGBA(const uint8_t* src, int stride, int width, int height,
+                       const uint8_t* alpha, uint8_t* rgba) {
+        for (int y = 0; y < height; y++) {
+            const uint16_t* luma = (const uint16_t*)(src + (size_t)y * stride);
+            const uint16_t* chroma = (const uint16_t*)(src + (size_t)(height + y) * stride);
+            const uint16_t* a = alpha ? (const uint16_t*)(alpha + (size_t)y * stride) : nullptr;
+            uint8_t* d = rgba + (size_t)y * width * 4;
+            for (int x = 0; x < width; x++) {
+                const uint16_t* uv = chroma + (x & ~1);
+                detail::yuvToRGBA(luma[x] >> 8, uv[0] >> 8, uv[1] >> 8, a ? a[x] >> 8 : 255, d + x * 4);
+            }
+        }
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride,
+                         uint8_t* alpha) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = rgba + (size_t)y * width * 4;
+            uint16_t* luma = (uint16_t*)(dst + (size_t)y * stride);
+            uint16_t* chroma = (uint16_t*)(dst + (size_t)(height + y) * stride);
+            uint16_t* a = alpha ? (uint16_t*)(alpha + (size_t)y * stride) : nullptr;
+            for (int x = 0; x < width; x += 2) {
+                const uint8_t* p0 = s + x * 4;
+                const uint8_t* p1 = x + 1 < width ? p0 + 4 : p0;
+                int r = p0[0] + p1[0], g = p0[1] + p1[1], b = p0[2] + p1[2];
+                luma[x] = (uint16_t)(detail::lumaOf(p0) * 257);
+                if (x + 1 < width) luma[x + 1] = (uint16_t)(detail::lumaOf(p1) * 257);
+                chroma[x] = (uint16_t)(detail::chromaU(r, g, b, 2) * 257);
+                chroma[x + 1] = (uint16_t)(detail::chromaV(r, g, b, 2) * 257);
+                if (a) {
+                    a[x] = (uint16_t)(p0[3] * 257);
+                    if (x + 1 < width) a[x + 1] = (uint16_t)(p1[3] * 257);
+                }
+            }
+        }
+    }
+};
+
+// P216 followed by a 16-bit alpha plane with the same stride
+struct PA16 {
+    static const NDIlib_FourCC_video_type_e fourCC = NDIlib_FourCC_type_PA16;
+    static const bool receivable = true;
+    static const NDIlib_recv_color_format_e recvColorFormat = NDIlib_recv_color_format_best;
+    static const bool direct = false;
+    static const GLenum glFormat = GL_RGBA;
+    static const GLenum glType = GL_UNSIGNED_BYTE;
+
+    static int lineStride(int width) { return P216::lineStride(width); }
+    static size_t frameBytes(int width, int height, int stride) { return (size_t)stride * height * 3; }
+
+    static void toRGBA(const uint8_t* src, int stride, int width, int height, uint8_t* rgba) {
+        P216::toRGBA(src, stride, width, height, src + (size_t)stride * height * 2, rgba);
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride) {
+        P216::fromRGBA(rgba, width, height, dst, stride, dst + (size_t)stride * height * 2);
+    }
+};
+
+// 8-bit 4:2:0 planar: Y, then U and V at half the stride and height
+struct I420 {
+    static const NDIlib_FourCC_video_type_e fourCC = NDIlib_FourCC_type_I420;
+    static const bool receivable = false; // NDI never converts to it, sources may still send it
+    static const NDIlib_recv_color_format_e recvColorFormat = NDIlib_recv_color_format_fastest;
+    static const bool direct = false;
+    static const GLenum glFormat = GL_RGBA;
+    static const GLenum glType = GL_UNSIGNED_BYTE;
+
+    static int lineStride(int width) { return (width + 1) & ~1; }
+    static size_t frameBytes(int width, int height, int stride) {
+        return (size_t)stride * height + 2 * (size_t)(stride / 2) * ((height + 1) / 2);
+    }
+
+    static void toRGBA(const uint8_t* src, int stride, int width, int height, uint8_t* rgba) {
+        const uint8_t* uPlane = src + (size_t)stride * height;
+        const uint8_t* vPlane = uPlane + (size_t)(stride / 2) * ((height + 1) / 2);
+        for (int y = 0; y < height; y++) {
+            const uint8_t* luma = src + (size_t)y * stride;
+            const uint8_t* u = uPlane + (size_t)(y / 2) * (stride / 2);
+            const uint8_t* v = vPlane + (size_t)(y / 2) * (stride / 2);
+            uint8_t* d = rgba + (size_t)y * width * 4;
+            for (int x = 0; x < width; x++) {
+                detail::yuvToRGBA(luma[x], u[x / 2], v[x / 2], 255, d + x * 4);
+            }
+        }
+    }
+    static void fromRGBA(const uint8_t* rgba, int width, int height, uint8_t* dst, int stride) {
+        uint8_t* uPlane = dst + (size_t)stride * height;
+        uint8_t* vPlane = uPlane + (size_t)(stride / 2) * ((height + 1) / 2);
+        for (int y = 0; y < height; y += 2) {
+            const uint8_t* row0 = rgba + (size_t)y * width * 4;
+            const uint8_t* row1 = y + 1 < height ? row0 + (size_t)width * 4 : row0;
+            uint8_t* luma0 = dst + (size_t)y * stride;
+            uint8_t* luma1 = y + 1 < height ? luma0 + stride : nullptr;
+            for (int x = 0; x < width; x += 2) {
+                int x1 = x + 1 < width ? x + 1 : x;
+                const uint8_t* p[4] = { row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4 };
+                luma0[x] = detail::lumaOf(p[0]);
+                if (x + 1 < width) luma0[x + 1] = detail::lumaOf(p[1]);
+                if (luma1) {
+                    luma1[x] = detail::lumaOf(p[2]);
+                    if (x + 1 < width) luma1[x + 1] = detail::lumaOf(p[3]);
+                }
+                int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+                int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+                int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+                uPlane[(size_t)(y / 2) * (stride / 2) + x / 2] = detail::chromaU(r, g, b, 4);
+                vPlane[(size_t)(y / 2) * (stride / 2) + x / 2] = detail::chromaV(r, g, b, 4);
+            }
+        }
+    }
+};
+
+// Calls visitor(Format()) with the traits matching fourCC, false if unsupported.
+// The only place a FourCC is dispatched at run time, once per frame.
+template <class Visitor>
+bool visitFormat(NDIlib_FourCC_video_type_e fourCC, Visitor&& visitor) {
+    switch (fourCC) {
+    case NDIlib_FourCC_type_BGRA:
+    case NDIlib_FourCC_type_BGRX: visitor(BGRA()); return true;
+    case NDIlib_FourCC_type_RGBA:
+    case NDIlib_FourCC_type_RGBX: visitor(RGBA()); return true;
+    case NDIlib_FourCC_type_UYVY: visitor(UYVY()); return true;
+    case NDIlib_FourCC_type_UYVA: visitor(UYVA()); return true;
+    case NDIlib_FourCC_type_P216: visitor(P216()); return true;
+    case NDIlib_FourCC_type_PA16: visitor(PA16()); return true;
+    case NDIlib_FourCC_type_I420: visitor(I420()); return true;
+    default: return false;
+    }
+}
+
+namespace detail {
+
+template <class Format>
+int rowLength(int stride, std::true_type) { return stride / Format::bytesPerPixel; }
+
+template <class Format>
+int rowLength(int, std::false_type) { return 0; }
+
+} // namespace detail
+
+// Pixels per line of a direct format for GL_(UN)PACK_ROW_LENGTH, 0 (tightly
+// packed) for converted formats, whose RGBA buffers have no padding
+template <class Format>
+int rowLength(int stride) {
+    return detail::rowLength<Format>(stride, std::integral_constant<bool, Format::direct>());
+}
+
+// Bytes of all planes of frame, 0 for unsupported formats
+inline size_t frameBytes(const NDIlib_video_frame_v2_t& frame) {
+    size_t bytes = 0;
+    visitFormat(frame.FourCC, [&](auto format) {
+        typedef decltype(format) Format;
+        int stride = frame.line_stride_in_bytes ? frame.line_stride_in_bytes : Format::lineStride(frame.xres);
+        bytes = Format::frameBytes(frame.xres, frame.yres, stride);
+    });
+    return bytes;
+}
+
+} // namespace NDIFormat
+} // namespace al
+
+#endif
@@ -8,9 +8,15 @@
 // From Tim Wood's NDI examples
 
 #include "al/graphics/al_Texture.hpp"
+#include "al_ext/ndi/al_NDIFrameSource.hpp"
+#include "al_ext/ndi/al_NDIPixelFormat.hpp"
 
-#include <vector>
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace al {
 
@@ -19,31 +25,139 @@ struct Source {
     std::string url;
 };
 
-class NDIReceiver {
+class NDIRecorder;
+
+// Format independent state and statistics, shared by every BasicNDIReceiver
+struct NDIReceiverBase {
+    enum State {
+        DISCONNECTED, // no connection requested
+        CONNECTING,   // looking for the requested source
+        CONNECTED,    // receiving from sourceName()
+        RECONNECTING  // source lost, looking for it or a backup
+    };
+
+    struct Stats {
+        uint64_t framesReceived; // captured from the network (frame sync: new frames pulled)
+        uint64_t framesDropped;  // replaced before update() picked them up
+        uint64_t framesRepeated; // frame sync: pulls that returned the frame already shown
+        uint64_t reconnects;     // times the health check declared the source lost
+        uint64_t failovers;      // times the connection moved to a different source
+    };
+
+    // Run first thing on the capture thread, e.g. to apply a ThreadPlacement
+    typedef std::function<void()> ThreadStart;
+};
+
+// Managed connection: a background thread finds the source, captures frames
+// and watches their arrival. When the source stops delivering for timeout()
+// seconds it reconnects, failing over to the backup sources in priority order.
+// update() never waits on the network; until a new frame arrives the texture
+// keeps showing the last good one.
+//
+// In frame sync mode (frameSync(true) before connecting) nothing is queued:
+// each update() pulls the frame due now from an NDI frame synchronizer, which
+// corrects for the drift between the source clock and the render clock by
+// repeating or dropping frames, and captureAudio() pulls audio resampled to
+// the caller's audio clock. Call update() once per rendered frame.
+//
+// Format is the NDIFormat traits type requested from NDI. Instantiated for
+// the receivable formats in al_NDIReceiver.cpp.
+template <class Format>
+class BasicNDIReceiver : public NDIFrameSource, public NDIReceiverBase {
+    static_assert(Format::receivable, "NDI cannot deliver this format");
+
 public:
-    NDIReceiver();
-    ~NDIReceiver();
+    BasicNDIReceiver();
+    ~BasicNDIReceiver();
 
     bool init();
     std::vector<Source> getAvailableSources();
+
+    // Waits up to 5 seconds for the source (first available if nullptr)
     bool connect(const char* sourceName = nullptr);
-    
-    // Update method now just works with texture
-    bool update(Texture& tex);
-    
-    int width() const { return mWidth; }
-    int height() const { return mHeight; }
+    // Returns immediately, the capture thread connects once the source appears
+    void connectAsync(const char* sourceName = nullptr);
+    void disconnect();
+
+    // Sources to fail over to, in priority order; applies to the running connection
+    void setBackupSources(const std::vector<std::string>& sourceNames);
+    // Seconds without a video frame before the source counts as lost
+    void timeout(double seconds) { mTimeoutNs = (int64_t)(seconds * 1e9); }
+
+    State state() const { return (State)mState.load(); }
+    bool isConnected() const { return state() == CONNECTED; }
+    std::string sourceName() const;
+    Stats stats() const;
+
+#ifndef _WIN32
+    // Appends every captured video frame to recorder (nullptr to stop).
+    // Recording maps files with mmap, so it is not built on Windows.
+    void setRecorder(NDIRecorder* recorder);
+#endif
+
+    // Takes effect with the next connect(), which starts the capture thread
+    void setThreadStart(ThreadStart threadStart) { mThreadStart = threadStart; }
+
+    // Takes effect with the next connect()
+    void frameSync(bool enable) { mFrameSyncMode = enable; }
+    bool frameSync() const { return mFrameSyncMode; }
+
+    // Frame sync mode, safe to call from the audio thread: fills
+    // channels[c][0..frames) with the source's audio resampled to
+    // sampleRate, silence when there is none. Never blocks.
+    void captureAudio(float* const* channels, int channelCount, int frames, int sampleRate);
+
+protected:
+    // Newest captured frame, returns false without blocking if there is none
+    bool captureFrame(NDIlib_video_frame_v2_t& frame) override;
+    void releaseFrame(NDIlib_video_frame_v2_t& frame) override;
 
 private:
+    void run();
+    bool selectSource(NDIlib_find_instance_t finder, const std::string& failedSource, bool skipFailed);
+    void publish(NDIlib_video_frame_v2_t& frame);
+    void record(const NDIlib_video_frame_v2_t& frame);
+
     NDIlib_recv_instance_t mReceiver;
     bool mInitialized;
-    int mWidth;
-    int mHeight;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    std::atomic<int> mState;
+    std::atomic<int64_t> mTimeoutNs;
+
+    mutable std::mutex mStatusLock; // guards the fields below
+    std::string mRequestedSource;
+    std::vector<std::string> mBackupSources;
+    std::string mSourceName;
+    Stats mStats;
+
+    // Newest captured frame, still owned by NDI until update() frees it
+    std::mutex mFrameLock;
+    NDIlib_video_frame_v2_t mPending;
+    bool mHavePending;
+
+    // Frame sync mode: the render thread pulls, the capture thread only
+    // connects and watches mLastFrameNs
+    bool mFrameSyncMode;
+    NDIlib_framesync_instance_t mFrameSync;
+    std::mutex mAudioLock; // keeps disconnect() from destroying mFrameSync under captureAudio()
+    int64_t mShownTimestamp;
+    std::atomic<int64_t> mLastFrameNs;
+
+#ifndef _WIN32
+    std::mutex mRecorderLock;
+    NDIRecorder* mRecorder;
+#endif
+
+    ThreadStart mThreadStart;
     
-    NDIReceiver(const NDIReceiver&) = delete;
-    NDIReceiver& operator=(const NDIReceiver&) = delete;
+    BasicNDIReceiver(const BasicNDIReceiver&) = delete;
+    BasicNDIReceiver& operator=(const BasicNDIReceiver&) = delete;
 };
 
+typedef BasicNDIReceiver<NDIFormat::BGRA> NDIReceiver;
+
 } //
 
 #endif
\ No newline at end of file
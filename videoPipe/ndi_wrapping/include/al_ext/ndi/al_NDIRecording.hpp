@@ -0,0 +1,141 @@
+#ifndef INCLUDE_AL_NDI_RECORDING_HPP
+#define INCLUDE_AL_NDI_RECORDING_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <Processing.NDI.Lib.h>
+
+#include "al_ext/ndi/al_NDIFrameSource.hpp"
+
+#include <string>
+#include <vector>
+
+// Capture of raw NDI video frames to a memory-mapped, append-only file and
+// deterministic replay of it, so stalls can be reproduced without a network.
+//
+// File layout:
+//   NDIRecordingHeader            (updated in place after every append)
+//   NDIRecordHeader + pixels + metadata, 64-byte aligned, repeated
+//   NDIRecordIndexEntry[frameCount] written by close()
+// A file that was never closed has no index; replay rebuilds it by walking
+// the records up to the last committed one.
+
+namespace al {
+
+#pragma pack(push, 1)
+struct NDIRecordingHeader {
+    char magic[8];          // "ALNDIREC"
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t frameCount;    // committed records
+    uint64_t dataEnd;       // offset one past the last committed record
+    uint64_t indexOffset;   // 0 until the recording is closed
+    int64_t createdNs;
+    uint8_t reserved[16];
+};
+
+struct NDIRecordHeader {
+    uint32_t magic;         // kNDIRecordMagic
+    uint32_t metadataBytes; // NUL terminated XML from p_metadata, 0 if none
+    uint64_t recordBytes;   // header + data + metadata + padding
+    uint64_t dataBytes;
+    int64_t receivedNs;     // local steady clock when the frame was captured
+    int64_t timestamp;      // NDI timestamp (100 ns units)
+    int64_t timecode;       // NDI timecode (100 ns units)
+    int32_t xres;
+    int32_t yres;
+    int32_t lineStride;
+    uint32_t fourCC;
+    int32_t frameRateN;
+    int32_t frameRateD;
+    float aspectRatio;
+    int32_t frameFormat;
+};
+
+struct NDIRecordIndexEntry {
+    uint64_t offset;
+    int64_t receivedNs;
+};
+#pragma pack(pop)
+
+class NDIRecorder {
+public:
+    NDIRecorder();
+    ~NDIRecorder();
+
+    // Creates (truncates) the file at path
+    bool open(const char* path);
+    // Writes the index and trims the file to its used size
+    void close();
+
+    // Appends one captured frame. receivedNs of 0 stamps it with the current time.
+    bool append(const NDIlib_video_frame_v2_t& frame, int64_t receivedNs = 0);
+
+    bool isOpen() const { return mMapping != nullptr; }
+    uint64_t frameCount() const;
+    const std::string& path() const { return mPath; }
+
+private:
+    bool reserve(uint64_t bytes);
+    NDIRecordingHeader* header() const { return (NDIRecordingHeader*)mMapping; }
+
+    std::string mPath;
+    int mFile;
+    uint8_t* mMapping;
+    uint64_t mCapacity;
+    std::vector<NDIRecordIndexEntry> mIndex;
+
+    NDIRecorder(const NDIRecorder&) = delete;
+    NDIRecorder& operator=(const NDIRecorder&) = delete;
+};
+
+class NDIReplaySource : public NDIFrameSource {
+public:
+    enum Speed {
+        ORIGINAL, // release frames with their recorded spacing
+        MAX       // one frame per update() call
+    };
+
+    NDIReplaySource();
+    ~NDIReplaySource();
+
+    bool open(const char* path);
+    void close();
+
+    void speed(Speed s) { mSpeed = s; }
+    void loop(bool enable) { mLoop = enable; }
+    void rewind();
+
+    // Random access for tools and tests. The pixels point into the mapping
+    // and stay valid until close().
+    bool frame(size_t index, NDIlib_video_frame_v2_t& out, int64_t* receivedNs = nullptr) const;
+
+    size_t frameCount() const { return mIndex.size(); }
+    size_t position() const { return mPosition; }
+    bool finished() const { return !mLoop && mPosition >= mIndex.size(); }
+
+protected:
+    // Next due frame, pixels point into the mapping
+    bool captureFrame(NDIlib_video_frame_v2_t& frame) override;
+
+private:
+    const NDIRecordHeader* record(size_t index) const;
+    bool buildIndex();
+
+    int mFile;
+    const uint8_t* mMapping;
+    uint64_t mSize;
+    std::vector<NDIRecordIndexEntry> mIndex;
+    Speed mSpeed;
+    bool mLoop;
+    size_t mPosition;
+    int64_t mStartNs;      // steady clock when replay (re)started
+    int64_t mFirstFrameNs; // receivedNs of the first frame
+
+    NDIReplaySource(const NDIReplaySource&) = delete;
+    NDIReplaySource& operator=(const NDIReplaySource&) = delete;
+};
+
+} // namespace al
+
+#endif
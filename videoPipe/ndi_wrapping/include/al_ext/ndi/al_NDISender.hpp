@@ -5,23 +5,128 @@
 #include <Processing.NDI.Lib.h>
 #include "al/graphics/al_FBO.hpp"
 #include "al/graphics/al_Texture.hpp"
+#include "al_ext/ndi/al_NDIFrameParams.hpp"
+#include "al_ext/ndi/al_NDIPixelFormat.hpp"
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
 
 // From Tim Wood's NDI examples
 
 namespace al {
 
-class NDISender {
-public:
+class FrameProfiler;
+
+// Format independent settings and statistics, shared by every BasicNDISender
+struct NDISenderBase {
+    // Called with the pointer passed to send() once NDI no longer reads it
+    typedef std::function<void(const uint8_t* data)> Completion;
+
     struct VideoConfig {
-        VideoConfig() : width(1920), height(1080), frameRateN(60000), frameRateD(1000) {}
+        VideoConfig()
+            : width(1920), height(1080), frameRateN(60000), frameRateD(1000), clockVideo(true)
+            , lineAlignment(0) {}
         int width;
         int height;
         int frameRateN;
         int frameRateD;
+        bool clockVideo;   // NDI paces sends to the frame rate
+        int lineAlignment; // pad readback rows to a multiple of this many bytes, 0 = packed
+    };
+
+    // One step of the adaptive ladder: GPU downscale factor and frame rate divisor
+    struct RateRung {
+        RateRung(float s = 1.0f, int d = 1) : scale(s), frameRateDivisor(d) {}
+        float scale;
+        int frameRateDivisor;
+    };
+
+    // Steps down the ladder when readback + send exceeds the latency budget
+    // or sends fall behind the frame rate, and back up once there is headroom.
+    // Separate thresholds, hold counts and a dwell time provide hysteresis.
+    struct RateControl {
+        RateControl()
+            : enabled(false)
+            , latencyBudgetMs(8.0)
+            , behindTolerance(0.1)
+            , upgradeHeadroom(0.6)
+            , downgradeFrames(15)
+            , upgradeFrames(180)
+            , minDwellSeconds(2.0)
+        {
+            ladder.push_back(RateRung(1.0f, 1));
+            ladder.push_back(RateRung(0.75f, 1));
+            ladder.push_back(RateRung(0.5f, 1));
+            ladder.push_back(RateRung(0.5f, 2));
+            ladder.push_back(RateRung(0.25f, 2));
+        }
+        bool enabled;
+        double latencyBudgetMs;  // readback (+ send when not clocked) per frame
+        double behindTolerance;  // fraction the send interval may exceed the frame period
+        double upgradeHeadroom;  // step up when the next rung's predicted cost is below this share of the budget
+        int downgradeFrames;     // consecutive overloaded frames before stepping down
+        int upgradeFrames;       // consecutive frames with headroom before stepping up
+        double minDwellSeconds;  // minimum time on a rung between switches
+        std::vector<RateRung> ladder; // best quality first
     };
 
-    NDISender();
-    ~NDISender();
+    // Idle handling: skip readback and send when no receiver is connected, or
+    // when the frame signature (a hash of a small GPU-generated mip level)
+    // matches the previous frame. An unchanged frame is still read back and
+    // sent every heartbeatSeconds so receivers do not time out; this also
+    // bounds how long a change too small to move the mip average goes unsent.
+    struct SkipPolicy {
+        SkipPolicy()
+            : skipWithoutReceivers(true)
+            , skipUnchanged(true)
+            , heartbeatSeconds(1.0)
+            , signatureSize(128)
+        {}
+        bool skipWithoutReceivers;
+        bool skipUnchanged;
+        double heartbeatSeconds; // 0 never repeats unchanged frames
+        int signatureSize;       // largest dimension of the hashed mip level
+    };
+
+    struct RateSwitch {
+        double timeSeconds; // since init()
+        int fromRung;
+        int toRung;
+        int width;
+        int height;
+        int frameRateDivisor;
+        double readbackMs;
+        double sendMs;
+        double intervalMs;
+    };
+
+    struct Stats {
+        uint64_t framesSent;
+        uint64_t framesDecimated;     // skipped by the frame rate divisor
+        uint64_t framesUnchanged;     // skipped, signature matched the previous frame
+        uint64_t framesUnwatched;     // skipped, no receiver connected
+        uint64_t framesHeartbeat;     // unchanged frames sent anyway to keep receivers alive
+        double readbackMs;            // smoothed GPU blit + readback time
+        double sendMs;                // smoothed time in NDIlib_send_send_video_v2
+        double intervalMs;            // smoothed time between sent frames
+        int rung;                     // current ladder position
+        int width;                    // current output size
+        int height;
+        uint64_t switchCount;
+        std::vector<RateSwitch> switches; // most recent switches, oldest first
+    };
+};
+
+// Reads rendered textures back from the GPU and sends them as NDI video.
+// Format is the NDIFormat traits type sent on the wire; BGRA and RGBA are
+// read back as is, YUV formats are packed on the CPU after an RGBA readback.
+// Instantiated for every NDIFormat in al_NDISender.cpp.
+template <class Format>
+class BasicNDISender : public NDISenderBase {
+public:
+    BasicNDISender();
+    ~BasicNDISender();
 
     // Initialize with video configuration
     bool init(const char* senderName, const VideoConfig& config = VideoConfig(), 
@@ -29,23 +134,89 @@ public:
 
     // Direct GPU methods
     bool sendDirect(GLuint textureId);
+    // Sends only the width x height region at x, y (texels, GL origin) of
+    // the texture; the region is blitted on the GPU, never repacked on the CPU
+    bool sendDirect(GLuint textureId, int x, int y, int width, int height);
     bool sendDirect(FBO& fbo);
     bool sendDirect(Texture& tex);
 
+    // Sends pixels from CPU memory, no GL context needed. lineStride 0 means
+    // tightly packed for fourCC; timecode is in 100 ns units. The buffer is
+    // lent to NDI and sent asynchronously without a copy: it must stay valid
+    // and unchanged until onComplete runs, which happens inside the next
+    // send(), sendCopy(), sendDirect() or flush() call.
+    bool send(const uint8_t* data, int width, int height, int lineStride = 0,
+              NDIlib_FourCC_video_type_e fourCC = Format::fourCC,
+              int64_t timecode = NDIlib_send_timecode_synthesize,
+              const Completion& onComplete = Completion());
+    // Like send() but copies the pixels first; data can be reused on return
+    bool sendCopy(const uint8_t* data, int width, int height, int lineStride = 0,
+                  NDIlib_FourCC_video_type_e fourCC = Format::fourCC,
+                  int64_t timecode = NDIlib_send_timecode_synthesize);
+    // Waits until NDI is done with the last send() buffer and completes it
+    void flush();
+
     // Resize the sender if input dimensions change
     bool resize(int width, int height);
 
+    void rateControl(const RateControl& control);
+    const RateControl& rateControl() const { return mRateControl; }
+    const Stats& stats() const { return mStats; }
+
+    void skipPolicy(const SkipPolicy& policy) { mSkipPolicy = policy; mSignatureValid = false; }
+    const SkipPolicy& skipPolicy() const { return mSkipPolicy; }
+
     bool isInitialized() const { return mInitialized; }
     bool isHardwareEnabled() const { return mHardwareEnabled; }
 
+    // Attaches params as metadata to every following video frame until
+    // changed, so receivers get them with the pixels they belong to (see
+    // NDIFrameSource::frameParams); set them right before each send to
+    // keep them per frame. Empty params stop the metadata.
+    void frameParams(const NDIFrameParams& params);
+
+    // Times sendDirect's blit, readback and send as profiler scopes (nullptr to stop)
+    void profiler(FrameProfiler* profiler) { mProfiler = profiler; }
+
 private:
     NDIlib_send_instance_t mSender;
     bool mInitialized;
     bool mHardwareEnabled;
+    VideoConfig mConfig;
+    RateControl mRateControl;
+    SkipPolicy mSkipPolicy;
+    Stats mStats;
+    uint64_t mSignature;
+    bool mSignatureValid;
+    bool mWatched;
+    int64_t mLastTransmitNs;
+    std::vector<uint8_t> mSignatureData;
+    std::vector<uint8_t> mReadback; // RGBA staging for formats GL cannot read back
+    int mOverloadFrames;
+    int mHeadroomFrames;
+    int mIntervalSamples;
+    uint64_t mFrameCounter;
+    int64_t mInitNs;
+    int64_t mLastSwitchNs;
+    int64_t mLastSendNs;
+
+    // Buffer lent to the asynchronous send in flight
+    const uint8_t* mPendingData;
+    Completion mPendingCompletion;
+    std::vector<uint8_t> mCopyBuffers[2]; // sendCopy() alternates, one may be in flight
+    int mCopyIndex;
+    FrameProfiler* mProfiler;
+
+    // Encoded frameParams, copied per send into the buffer not in flight
+    static const size_t kMetadataBytes = 1024;
+    char mParamsXml[kMetadataBytes];
+    char mMetadata[2][kMetadataBytes];
+    int mMetadataIndex;
     
     struct HardwareContext {
         GLuint sharedTexture;     // Persistent shared texture
         GLuint copyFBO;           // Persistent FBO for copying
+        GLuint sourceFBO;         // Read FBO the source texture is attached to
         uint8_t* pPixelData;      // CPU pixel data buffer
         int width;
         int height;
@@ -56,11 +227,21 @@ private:
     bool initHardwareContext(int width, int height);
     void cleanupHardwareContext();
     bool resizeHardwareContext(int width, int height);
+    void setFrameRate(int divisor);
+    bool hasReceivers();
+    uint64_t frameSignature();
+    void transmit();
+    int lineStrideFor(int width) const;
+    void completePending();
+    const char* frameMetadata();
+    void updateRate(double readbackMs, double sendMs, int sourceWidth, int sourceHeight, int64_t now);
     
-    NDISender(const NDISender&) = delete;
-    NDISender& operator=(const NDISender&) = delete;
+    BasicNDISender(const BasicNDISender&) = delete;
+    BasicNDISender& operator=(const BasicNDISender&) = delete;
 };
 
+typedef BasicNDISender<NDIFormat::BGRA> NDISender;
+
 } // namespace al
 
 #endif
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "al_ext/ndi/al_EquirectSphere.hpp"
+#include "al_NDIInternal.hpp"
+
+#include <math.h>
+
+#include <vector>
+
+// EXT_texture_filter_anisotropic, core since GL 4.6
+#ifndef GL_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#endif
+
+namespace al {
+
+namespace {
+
+const char* kVertexShader = R"(
+#version 330 core
+uniform mat4 uModelViewProjection;
+layout(location = 0) in vec3 aPosition;
+out vec3 vDirection;
+flat out float vPositiveX;
+void main() {
+    // Seen from the centre, a point on any facet lies on the view ray
+    vDirection = aPosition;
+    vPositiveX = aPosition.x > 0.0 ? 1.0 : 0.0;
+    gl_Position = uModelViewProjection * vec4(aPosition, 1.0);
+}
+)";
+
+const char* kFragmentShader = R"(
+#version 330 core
+uniform sampler2D uTexture;
+in vec3 vDirection;
+flat in float vPositiveX;
+out vec4 fragColor;
+const float kPi = 3.14159265358979;
+void main() {
+    vec3 d = normalize(vDirection);
+    // Longitude runs from +X (u = 0) through +Z, row 0 of the frame
+    // (t = 0) is the zenith. Where u wraps from 1 to 0 its screen-space
+    // derivative would select the smallest mip, so each triangle uses a
+    // form that is continuous across it: the signed longitude (which
+    // jumps at -X) on the +X side, its fractional part (which jumps at
+    // +X) elsewhere. Repeat wrapping samples the same texels for both.
+    float longitude = atan(d.z, d.x) / (2.0 * kPi);
+    float u = vPositiveX > 0.5 ? longitude : fract(longitude);
+    fragColor = texture(uTexture, vec2(u, acos(clamp(d.y, -1.0, 1.0)) / kPi));
+}
+)";
+
+// Icosahedron, faces counter-clockwise seen from outside
+const float kGolden = 1.6180339887f;
+const float kIcoVertices[12][3] = {
+    {-1, kGolden, 0}, {1, kGolden, 0}, {-1, -kGolden, 0}, {1, -kGolden, 0},
+    {0, -1, kGolden}, {0, 1, kGolden}, {0, -1, -kGolden}, {0, 1, -kGolden},
+    {kGolden, 0, -1}, {kGolden, 0, 1}, {-kGolden, 0, -1}, {-kGolden, 0, 1}
+};
+const int kIcoFaces[20][3] = {
+    {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+    {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+    {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+    {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+};
+
+// Point i, j of the segments x segments grid on face, pushed onto the sphere
+void facePoint(const int* face, int i, int j, int segments, float radius, std::vector<float>& out) {
+    const float* a = kIcoVertices[face[0]];
+    const float* b = kIcoVertices[face[1]];
+    const float* c = kIcoVertices[face[2]];
+    float s = (float)i / segments;
+    float t = (float)j / segments;
+    float p[3];
+    for (int k = 0; k < 3; k++) p[k] = a[k] + (b[k] - a[k]) * s + (c[k] - a[k]) * t;
+    float scale = radius / sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    for (int k = 0; k < 3; k++) out.push_back(p[k] * scale);
+}
+
+// Triangles of the subdivided icosahedron, wound to face the centre like a skybox
+std::vector<float> proxyVertices(int segments, float radius) {
+    std::vector<float> vertices;
+    vertices.reserve((size_t)20 * segments * segments * 9);
+    for (const int* face : kIcoFaces) {
+        for (int i = 0; i < segments; i++) {
+            for (int j = 0; j < segments - i; j++) {
+                facePoint(face, i, j, segments, radius, vertices);
+                facePoint(face, i, j + 1, segments, radius, vertices);
+                facePoint(face, i + 1, j, segments, radius, vertices);
+                if (j < segments - i - 1) {
+                    facePoint(face, i + 1, j, segments, radius, vertices);
+                    facePoint(face, i, j + 1, segments, radius, vertices);
+                    facePoint(face, i + 1, j + 1, segments, radius, vertices);
+                }
+            }
+        }
+    }
+    return vertices;
+}
+
+} // namespace
+
+EquirectSphere::EquirectSphere()
+    : mProgram(0)
+    , mVAO(0)
+    , mVBO(0)
+    , mVertexCount(0)
+    , mMatrixLocation(-1)
+    , mSamplerLocation(-1)
+    , mAnisotropy(1.0f)
+    , mMipmappedTexture(0)
+    , mMipmappedGeneration(0)
+    , mMipmapped(false)
+    , mStats()
+{
+}
+
+EquirectSphere::~EquirectSphere() {
+    cleanup();
+}
+
+bool EquirectSphere::init(const Config& config) {
+    cleanup();
+    mConfig = config;
+    if (mConfig.segments < 1) mConfig.segments = 1;
+
+    mProgram = buildShaderProgram(kVertexShader, kFragmentShader, "Equirect sphere");
+    if (!mProgram) return false;
+    mMatrixLocation = glGetUniformLocation(mProgram, "uModelViewProjection");
+    mSamplerLocation = glGetUniformLocation(mProgram, "uTexture");
+
+    std::vector<float> vertices = proxyVertices(mConfig.segments, mConfig.radius);
+    mVertexCount = (GLsizei)(vertices.size() / 3);
+    glGenVertexArrays(1, &mVAO);
+    glGenBuffers(1, &mVBO);
+    glBindVertexArray(mVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Without the extension the query fails and filtering stays isotropic
+    while (glGetError() != GL_NO_ERROR) {}
+    GLfloat maxAnisotropy = 1.0f;
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+    if (glGetError() != GL_NO_ERROR) maxAnisotropy = 1.0f;
+    mAnisotropy = mConfig.maxAnisotropy < maxAnisotropy ? mConfig.maxAnisotropy : maxAnisotropy;
+    if (mAnisotropy < 1.0f) mAnisotropy = 1.0f;
+    return true;
+}
+
+void EquirectSphere::cleanup() {
+    if (mVBO) glDeleteBuffers(1, &mVBO);
+    if (mVAO) glDeleteVertexArrays(1, &mVAO);
+    if (mProgram) glDeleteProgram(mProgram);
+    mVBO = 0;
+    mVAO = 0;
+    mProgram = 0;
+    mVertexCount = 0;
+    mMipmappedTexture = 0;
+    mMipmapped = false;
+}
+
+void EquirectSphere::frameUploaded(GLuint texture, uint32_t generation, bool compressed) {
+    if (!mConfig.mipmaps || !texture) return;
+    if (texture == mMipmappedTexture && generation == mMipmappedGeneration) {
+        mStats.framesSkipped++;
+        return;
+    }
+    mMipmappedTexture = texture;
+    mMipmappedGeneration = generation;
+    mMipmapped = !compressed;
+    if (compressed) return;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    mStats.mipmapsGenerated++;
+}
+
+void EquirectSphere::draw(GLuint texture, const float* modelViewProjection) {
+    if (!mProgram || !texture || !modelViewProjection) return;
+    bool mipmapped = mConfig.mipmaps && mMipmapped && texture == mMipmappedTexture;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // Set on every draw, the texture's owner may have changed them
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (mAnisotropy > 1.0f) glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, mAnisotropy);
+
+    glUseProgram(mProgram);
+    glUniformMatrix4fv(mMatrixLocation, 1, GL_FALSE, modelViewProjection);
+    glUniform1i(mSamplerLocation, 0);
+    glBindVertexArray(mVAO);
+    glDrawArrays(GL_TRIANGLES, 0, mVertexCount);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+} // namespace al
@@ -0,0 +1,415 @@
+#include "al_ext/ndi/al_FrameProfiler.hpp"
+#include "al_NDIInternal.hpp"
+
+#include <string.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace al {
+
+namespace {
+
+const double kSmoothing = 0.1;        // weight of the newest sample in the timing averages
+const uint64_t kClockSyncFrames = 600; // frames between GPU to CPU clock re-syncs
+const int kMaxBars = 64;              // overlay quads per draw, see uRect below
+const int kRowHeight = 14;            // overlay pixels per stage
+const int kBarWidth = 300;            // overlay pixels for budgetMs
+
+void smooth(double& average, double sample, bool first) {
+    average = first ? sample : average + kSmoothing * (sample - average);
+}
+
+const char* kVertexShader = R"(
+#version 330 core
+uniform vec4 uRect[64];  // normalized device x, y, width, height
+uniform vec4 uColor[64];
+flat out vec4 vColor;
+void main() {
+    // Triangle strip corners (0,0) (1,0) (0,1) (1,1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec4 rect = uRect[gl_InstanceID];
+    vColor = uColor[gl_InstanceID];
+    gl_Position = vec4(rect.xy + corner * rect.zw, 0.0, 1.0);
+}
+)";
+
+const char* kFragmentShader = R"(
+#version 330 core
+flat in vec4 vColor;
+out vec4 fragColor;
+void main() {
+    fragColor = vColor;
+}
+)";
+
+// Stage names are literals from the code; only quotes and backslashes need escaping
+void writeJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\') out << '\\';
+        out << text[i];
+    }
+    out << '"';
+}
+
+} // namespace
+
+FrameProfiler::FrameProfiler()
+    : mInitialized(false)
+    , mGpuEnabled(false)
+    , mCurrent(-1)
+    , mDepth(0)
+    , mFrameNumber(0)
+    , mTraceNext(0)
+    , mTraceWrapped(false)
+    , mGpuOffsetNs(0)
+    , mLastSyncFrame(0)
+    , mStats()
+    , mProgram(0)
+    , mVAO(0)
+    , mRectLocation(-1)
+    , mColorLocation(-1)
+{}
+
+FrameProfiler::~FrameProfiler() {
+    cleanup();
+}
+
+bool FrameProfiler::init(const Config& config) {
+    cleanup();
+    if (config.latencyFrames < 1 || config.maxScopes < 1) {
+        std::cerr << "Frame profiler needs at least one frame of latency and one scope" << std::endl;
+        return false;
+    }
+    mConfig = config;
+
+    mFrames.assign(mConfig.latencyFrames, Frame());
+    mRecords.assign((size_t)mConfig.latencyFrames * mConfig.maxScopes, Record());
+    mTrace.assign(mConfig.traceEvents, TraceEvent());
+    mTraceNext = 0;
+    mTraceWrapped = false;
+    mStages.clear();
+    mStageNames.clear();
+    mStages.reserve(mConfig.maxScopes);
+    mStageNames.reserve(mConfig.maxScopes);
+    stageFor("frame", 0);
+
+    mGpuEnabled = false;
+    if (mConfig.gpu) {
+        GLint bits = 0;
+        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+        if (bits == 0) {
+            std::cerr << "GL_TIMESTAMP queries not supported, profiling the CPU only" << std::endl;
+        } else {
+            mQueries.assign(mRecords.size() * 2, 0);
+            glGenQueries((GLsizei)mQueries.size(), mQueries.data());
+            mGpuEnabled = true;
+            syncClocks();
+        }
+
+        // Without the program the profiler still records, it just has no overlay
+        mProgram = buildShaderProgram(kVertexShader, kFragmentShader, "Frame profiler");
+        if (mProgram) {
+            mRectLocation = glGetUniformLocation(mProgram, "uRect");
+            mColorLocation = glGetUniformLocation(mProgram, "uColor");
+            glGenVertexArrays(1, &mVAO);
+        }
+    }
+
+    mCurrent = -1;
+    mDepth = 0;
+    mFrameNumber = 0;
+    mStats = Stats();
+    mInitialized = true;
+    return true;
+}
+
+void FrameProfiler::cleanup() {
+    if (!mQueries.empty()) {
+        glDeleteQueries((GLsizei)mQueries.size(), mQueries.data());
+        mQueries.clear();
+    }
+    if (mProgram) {
+        glDeleteProgram(mProgram);
+        mProgram = 0;
+    }
+    if (mVAO) {
+        glDeleteVertexArrays(1, &mVAO);
+        mVAO = 0;
+    }
+    mGpuEnabled = false;
+    mInitialized = false;
+}
+
+void FrameProfiler::syncClocks() {
+    GLint64 gpuNs = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNs);
+    mGpuOffsetNs = steadyNs() - gpuNs;
+    mLastSyncFrame = mFrameNumber;
+}
+
+int FrameProfiler::stageFor(const char* name, int depth) {
+    for (size_t i = 0; i < mStageNames.size(); i++) {
+        if (mStageNames[i] == name) return (int)i;
+    }
+    // Same text from another translation unit
+    for (size_t i = 0; i < mStageNames.size(); i++) {
+        if (strcmp(mStageNames[i], name) == 0) return (int)i;
+    }
+    StageStats stage = StageStats();
+    stage.name = name;
+    stage.depth = depth;
+    mStages.push_back(stage);
+    mStageNames.push_back(name);
+    return (int)mStages.size() - 1;
+}
+
+void FrameProfiler::beginFrame() {
+    if (!mInitialized) return;
+    if (mCurrent >= 0) endFrame();
+
+    if (mGpuEnabled) {
+        collect();
+        if (mFrameNumber - mLastSyncFrame >= kClockSyncFrames) syncClocks();
+    }
+
+    int slot = (int)(mFrameNumber % mConfig.latencyFrames);
+    Frame& frame = mFrames[slot];
+    if (frame.pending) {
+        // Still not done after latencyFrames: give up on it rather than wait
+        mStats.gpuFramesDropped++;
+        frame.pending = false;
+    }
+    frame.number = mFrameNumber++;
+    frame.count = 0;
+    mCurrent = slot;
+    mDepth = 0;
+    begin("frame");
+}
+
+void FrameProfiler::endFrame() {
+    if (mCurrent < 0) return;
+    end(0);
+
+    Frame& frame = mFrames[mCurrent];
+    for (int i = 0; i < frame.count; i++) {
+        const Record& r = record(mCurrent, i);
+        if (r.ended) addTrace(r.stage, false, r.cpuBeginNs, r.cpuEndNs - r.cpuBeginNs, frame.number);
+    }
+    frame.pending = mGpuEnabled;
+    mStats.frames++;
+    mCurrent = -1;
+}
+
+int FrameProfiler::begin(const char* name) {
+    if (mCurrent < 0) return -1;
+    Frame& frame = mFrames[mCurrent];
+    if (frame.count >= mConfig.maxScopes) {
+        mStats.scopesDropped++;
+        return -1;
+    }
+    int index = frame.count++;
+    Record& r = record(mCurrent, index);
+    r.stage = stageFor(name, mDepth);
+    r.ended = false;
+    if (mGpuEnabled) glQueryCounter(query(mCurrent, index, false), GL_TIMESTAMP);
+    r.cpuBeginNs = steadyNs();
+    mDepth++;
+    return index;
+}
+
+void FrameProfiler::end(int scope) {
+    if (mCurrent < 0 || scope < 0 || scope >= mFrames[mCurrent].count) return;
+    Record& r = record(mCurrent, scope);
+    if (r.ended) return;
+    r.cpuEndNs = steadyNs();
+    if (mGpuEnabled) glQueryCounter(query(mCurrent, scope, true), GL_TIMESTAMP);
+    r.ended = true;
+    mDepth--;
+
+    StageStats& stage = mStages[r.stage];
+    double ms = (r.cpuEndNs - r.cpuBeginNs) / 1e6;
+    smooth(stage.cpuMs, ms, stage.samples++ == 0);
+    if (ms > stage.cpuPeakMs) stage.cpuPeakMs = ms;
+}
+
+void FrameProfiler::collect() {
+    // Oldest first; results arrive in submission order, so stop at the
+    // first frame that is not done yet
+    uint64_t first = mFrameNumber > (uint64_t)mConfig.latencyFrames ? mFrameNumber - mConfig.latencyFrames : 0;
+    for (uint64_t number = first; number < mFrameNumber; number++) {
+        int slot = (int)(number % mConfig.latencyFrames);
+        if (!mFrames[slot].pending || mFrames[slot].number != number) continue;
+        if (!readFrame(slot)) break;
+    }
+}
+
+bool FrameProfiler::readFrame(int slot) {
+    Frame& frame = mFrames[slot];
+    // The frame scope's end query is issued last
+    GLuint available = 0;
+    glGetQueryObjectuiv(query(slot, 0, true), GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    for (int i = 0; i < frame.count; i++) {
+        const Record& r = record(slot, i);
+        if (!r.ended) continue;
+        GLuint64 beginNs = 0, endNs = 0;
+        glGetQueryObjectui64v(query(slot, i, false), GL_QUERY_RESULT, &beginNs);
+        glGetQueryObjectui64v(query(slot, i, true), GL_QUERY_RESULT, &endNs);
+        int64_t durationNs = endNs > beginNs ? (int64_t)(endNs - beginNs) : 0;
+
+        StageStats& stage = mStages[r.stage];
+        double ms = durationNs / 1e6;
+        smooth(stage.gpuMs, ms, stage.gpuMs == 0.0);
+        if (ms > stage.gpuPeakMs) stage.gpuPeakMs = ms;
+        addTrace(r.stage, true, (int64_t)beginNs + mGpuOffsetNs, durationNs, frame.number);
+    }
+    frame.pending = false;
+    mStats.gpuFramesRead++;
+    return true;
+}
+
+void FrameProfiler::addTrace(int stage, bool gpu, int64_t beginNs, int64_t durationNs, uint64_t frame) {
+    if (mTrace.empty()) return;
+    TraceEvent& event = mTrace[mTraceNext];
+    event.stage = stage;
+    event.gpu = gpu;
+    event.beginNs = beginNs;
+    event.durationNs = durationNs;
+    event.frame = frame;
+    if (++mTraceNext == mTrace.size()) {
+        mTraceNext = 0;
+        mTraceWrapped = true;
+    }
+}
+
+void FrameProfiler::resetPeaks() {
+    for (size_t i = 0; i < mStages.size(); i++) {
+        mStages[i].cpuPeakMs = 0.0;
+        mStages[i].gpuPeakMs = 0.0;
+    }
+}
+
+std::string FrameProfiler::report() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < mStages.size(); i++) {
+        const StageStats& stage = mStages[i];
+        out << std::string(stage.depth * 2, ' ') << std::left << std::setw(24 - stage.depth * 2)
+            << stage.name << std::right
+            << " cpu " << std::setw(6) << stage.cpuMs << " ms (peak " << std::setw(6) << stage.cpuPeakMs << ")";
+        if (mGpuEnabled) {
+            out << "  gpu " << std::setw(6) << stage.gpuMs << " ms (peak " << std::setw(6) << stage.gpuPeakMs << ")";
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+void FrameProfiler::drawOverlay() {
+    if (!mProgram || mStages.empty()) return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float sx = 2.0f / viewport[2];
+    float sy = 2.0f / viewport[3];
+
+    // Pixel rectangle from the top-left corner to normalized device coordinates
+    float rects[kMaxBars * 4];
+    float colors[kMaxBars * 4];
+    int bars = 0;
+    auto bar = [&](int x, int y, float width, int height, float r, float g, float b, float a) {
+        if (bars == kMaxBars || width <= 0.0f) return;
+        rects[bars * 4 + 0] = -1.0f + x * sx;
+        rects[bars * 4 + 1] = 1.0f - (y + height) * sy;
+        rects[bars * 4 + 2] = width * sx;
+        rects[bars * 4 + 3] = height * sy;
+        colors[bars * 4 + 0] = r;
+        colors[bars * 4 + 1] = g;
+        colors[bars * 4 + 2] = b;
+        colors[bars * 4 + 3] = a;
+        bars++;
+    };
+
+    int rows = (int)mStages.size();
+    if (rows > (kMaxBars - 2) / 2) rows = (kMaxBars - 2) / 2;
+    int margin = 8;
+    bar(margin, margin, kBarWidth * 1.5f, rows * kRowHeight + 4, 0.0f, 0.0f, 0.0f, 0.6f);
+    for (int i = 0; i < rows; i++) {
+        const StageStats& stage = mStages[i];
+        int x = margin + 2 + stage.depth * 4;
+        int y = margin + 2 + i * kRowHeight;
+        float scale = kBarWidth / (float)mConfig.budgetMs;
+        float cpu = (float)stage.cpuMs * scale;
+        float gpu = (float)stage.gpuMs * scale;
+        float limit = kBarWidth * 1.5f - 4 - stage.depth * 4;
+        bar(x, y, cpu < limit ? cpu : limit, kRowHeight / 2 - 1, 0.3f, 0.6f, 1.0f, 1.0f);
+        bar(x, y + kRowHeight / 2, gpu < limit ? gpu : limit, kRowHeight / 2 - 1, 1.0f, 0.6f, 0.2f, 1.0f);
+    }
+    // Budget mark
+    bar(margin + 2 + kBarWidth, margin, 1.0f, rows * kRowHeight + 4, 1.0f, 0.2f, 0.2f, 1.0f);
+
+    GLint previousProgram, previousVAO;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLint blendSrc, blendDst;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(mProgram);
+    glUniform4fv(mRectLocation, bars, rects);
+    glUniform4fv(mColorLocation, bars, colors);
+    glBindVertexArray(mVAO);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, bars);
+
+    glBindVertexArray(previousVAO);
+    glUseProgram(previousProgram);
+    glBlendFunc(blendSrc, blendDst);
+    if (!blend) glDisable(GL_BLEND);
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string& path) const {
+    std::ofstream out(path.c_str());
+    if (!out) {
+        std::cerr << "Could not write frame trace to " << path << std::endl;
+        return false;
+    }
+
+    size_t count = mTraceWrapped ? mTrace.size() : mTraceNext;
+    size_t start = mTraceWrapped ? mTraceNext : 0;
+    int64_t originNs = 0;
+    for (size_t i = 0; i < count; i++) {
+        const TraceEvent& event = mTrace[(start + i) % mTrace.size()];
+        if (i == 0 || event.beginNs < originNs) originNs = event.beginNs;
+    }
+
+    // Timestamps are microseconds; tid 1 is the CPU, tid 2 the GPU
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < count; i++) {
+        const TraceEvent& event = mTrace[(start + i) % mTrace.size()];
+        out << ",\n{\"name\":";
+        writeJsonString(out, mStages[event.stage].name);
+        out << ",\"cat\":\"" << (event.gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\""
+            << ",\"ts\":" << (event.beginNs - originNs) / 1e3
+            << ",\"dur\":" << event.durationNs / 1e3
+            << ",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+            << ",\"args\":{\"frame\":" << event.frame << "}}";
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+
+} // namespace al
@@ -0,0 +1,138 @@
+#include "al_ext/ndi/al_NDIFrameParams.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace al {
+
+namespace {
+
+const char kElement[] = "<al_params";
+
+bool isNameStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isNameChar(char c) {
+    return isNameStart(c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+} // namespace
+
+int NDIFrameParams::find(const char* name) const {
+    for (int i = 0; i < mCount; i++) {
+        if (strcmp(mNames[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+bool NDIFrameParams::set(const char* name, float value) {
+    if (!name) return false;
+    int i = find(name);
+    if (i < 0) {
+        size_t length = strlen(name);
+        if (mCount >= kMaxParams || length == 0 || length > (size_t)kMaxNameLength ||
+            !isNameStart(name[0])) {
+            return false;
+        }
+        for (size_t c = 1; c < length; c++) {
+            if (!isNameChar(name[c])) return false;
+        }
+        i = mCount++;
+        memcpy(mNames[i], name, length + 1);
+    }
+    mValues[i] = value;
+    return true;
+}
+
+float NDIFrameParams::get(const char* name, float fallback) const {
+    int i = name ? find(name) : -1;
+    return i >= 0 ? mValues[i] : fallback;
+}
+
+size_t NDIFrameParams::toXml(char* out, size_t capacity) const {
+    if (!out || capacity == 0) return 0;
+    out[0] = '\0';
+    size_t length = sizeof(kElement) - 1;
+    if (length >= capacity) return 0;
+    memcpy(out, kElement, length);
+    for (int i = 0; i < mCount; i++) {
+        int n = snprintf(out + length, capacity - length, " %s=\"%.9g\"", mNames[i], (double)mValues[i]);
+        if (n < 0 || (size_t)n >= capacity - length) {
+            out[0] = '\0';
+            return 0;
+        }
+        length += (size_t)n;
+    }
+    if (capacity - length < 3) {
+        out[0] = '\0';
+        return 0;
+    }
+    memcpy(out + length, "/>", 3);
+    return length + 2;
+}
+
+bool NDIFrameParams::fromXml(const char* xml) {
+    return xml && fromXml(xml, strlen(xml));
+}
+
+bool NDIFrameParams::fromXml(const char* xml, size_t length) {
+    mCount = 0;
+    if (!xml) return false;
+
+    // Metadata from other senders may wrap ours in further elements
+    const size_t elementLength = sizeof(kElement) - 1;
+    const char* end = xml + length;
+    const char* p = xml;
+    for (;; p++) {
+        if ((size_t)(end - p) <= elementLength) return false;
+        if (memcmp(p, kElement, elementLength) == 0 && (isSpace(p[elementLength]) ||
+            p[elementLength] == '/' || p[elementLength] == '>')) {
+            break;
+        }
+    }
+    p += elementLength;
+
+    // Attributes until the element closes; malformed input keeps what was
+    // parsed so far rather than failing the whole frame
+    while (p < end) {
+        while (p < end && isSpace(*p)) p++;
+        if (p >= end || *p == '/' || *p == '>') break;
+
+        const char* name = p;
+        while (p < end && isNameChar(*p)) p++;
+        size_t nameLength = (size_t)(p - name);
+        if (nameLength == 0 || p + 1 >= end || *p != '=' || (p[1] != '"' && p[1] != '\'')) break;
+        char quote = p[1];
+        const char* value = p + 2;
+        p = value;
+        while (p < end && *p != quote) p++;
+        if (p >= end) break;
+        size_t valueLength = (size_t)(p - value);
+        p++;
+
+        char valueText[32];
+        if (nameLength > (size_t)kMaxNameLength || valueLength >= sizeof(valueText) ||
+            !isNameStart(name[0])) {
+            continue;
+        }
+        memcpy(valueText, value, valueLength);
+        valueText[valueLength] = '\0';
+        char* parsed = nullptr;
+        float v = strtof(valueText, &parsed);
+        if (parsed == valueText) continue;
+
+        char nameText[kMaxNameLength + 1];
+        memcpy(nameText, name, nameLength);
+        nameText[nameLength] = '\0';
+        set(nameText, v);
+    }
+    return true;
+}
+
+} // namespace al
@@ -0,0 +1,92 @@
+#include "al_ext/ndi/al_NDIFrameSource.hpp"
+#include "al_ext/ndi/al_NDIPixelFormat.hpp"
+
+#include <iostream>
+
+namespace al {
+
+bool NDIFrameSource::update(Texture& tex) {
+    NDIlib_video_frame_v2_t frame;
+    if (!captureFrame(frame)) return false;
+    readParams(frame);
+    uploadVideoFrame(frame, tex);
+    releaseFrame(frame);
+    mGeneration++;
+    return true;
+}
+
+bool NDIFrameSource::updateRegion(Texture& tex, int x, int y, int width, int height, int destX, int destY) {
+    NDIlib_video_frame_v2_t frame;
+    if (!captureFrame(frame)) return false;
+    mWidth = frame.xres;
+    mHeight = frame.yres;
+    readParams(frame);
+
+    GLenum format;
+    int rowLength;
+    const void* pixels = uploadPixels(frame, format, rowLength);
+    if (x + width > frame.xres) width = frame.xres - x;
+    if (y + height > frame.yres) height = frame.yres - y;
+    if (pixels && x >= 0 && y >= 0 && width > 0 && height > 0) {
+        tex.bind();
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, destX, destY, width, height, format, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        tex.unbind();
+    }
+    releaseFrame(frame);
+    mGeneration++;
+    return true;
+}
+
+void NDIFrameSource::readParams(const NDIlib_video_frame_v2_t& frame) {
+    if (!frame.p_metadata || !mParams.fromXml(frame.p_metadata)) mParams.clear();
+}
+
+void NDIFrameSource::uploadVideoFrame(const NDIlib_video_frame_v2_t& frame, Texture& tex) {
+    // If texture dimensions changed, update the texture
+    if (mWidth != frame.xres || mHeight != frame.yres) {
+        mWidth = frame.xres;
+        mHeight = frame.yres;
+        tex.resize(mWidth, mHeight);
+    }
+
+    GLenum format;
+    int rowLength;
+    const void* pixels = uploadPixels(frame, format, rowLength);
+    if (!pixels) return;
+
+    // Update texture with new frame data
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+    tex.submit(pixels, format, GL_UNSIGNED_BYTE);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+const void* NDIFrameSource::uploadPixels(const NDIlib_video_frame_v2_t& frame, GLenum& format, int& rowLength) {
+    const void* pixels = nullptr;
+    bool supported = NDIFormat::visitFormat(frame.FourCC, [&](auto traits) {
+        typedef decltype(traits) Format;
+        int stride = frame.line_stride_in_bytes ? frame.line_stride_in_bytes : Format::lineStride(frame.xres);
+        if (Format::direct) {
+            format = Format::glFormat;
+            rowLength = NDIFormat::rowLength<Format>(stride);
+            pixels = frame.p_data;
+        } else {
+            mConverted.resize((size_t)frame.xres * frame.yres * 4);
+            Format::toRGBA(frame.p_data, stride, frame.xres, frame.yres, mConverted.data());
+            format = GL_RGBA;
+            rowLength = frame.xres;
+            pixels = mConverted.data();
+        }
+    });
+    if (!supported) {
+        std::cerr << "Unsupported NDI video format " << std::hex << (uint32_t)frame.FourCC << std::dec << std::endl;
+    }
+    return pixels;
+}
+
+} // namespace al
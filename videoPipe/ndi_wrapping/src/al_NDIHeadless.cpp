@@ -0,0 +1,136 @@
+#include "al_ext/ndi/al_NDIHeadless.hpp"
+#include "al/graphics/al_OpenGL.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <string.h>
+
+#include <iostream>
+
+namespace al {
+
+namespace {
+
+EGLDisplay openDisplay() {
+    // Prefer Mesa's surfaceless platform: needs neither X11 nor a DRM device
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (getPlatformDisplay && extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+            return display;
+        }
+    }
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+        return display;
+    }
+    return EGL_NO_DISPLAY;
+}
+
+} // namespace
+
+NDIHeadlessContext::NDIHeadlessContext()
+    : mDisplay(nullptr)
+    , mContext(nullptr)
+    , mSurface(nullptr)
+{}
+
+NDIHeadlessContext::~NDIHeadlessContext() {
+    destroy();
+}
+
+bool NDIHeadlessContext::create(int glMajor, int glMinor) {
+    if (mContext) return makeCurrent();
+
+    EGLDisplay display = openDisplay();
+    if (display == EGL_NO_DISPLAY) {
+        std::cerr << "Failed to open an EGL display" << std::endl;
+        return false;
+    }
+    mDisplay = display;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL display does not support desktop OpenGL" << std::endl;
+        destroy();
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    bool haveConfig = eglChooseConfig(display, configAttribs, &config, 1, &configCount) && configCount > 0;
+    if (!haveConfig) {
+        // Surfaceless displays may expose no pbuffer configs at all
+        const EGLint anyAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        haveConfig = eglChooseConfig(display, anyAttribs, &config, 1, &configCount) && configCount > 0;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, glMajor,
+        EGL_CONTEXT_MINOR_VERSION, glMinor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, haveConfig ? config : EGL_NO_CONFIG_KHR,
+                                          EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "Failed to create an OpenGL " << glMajor << "." << glMinor
+                  << " core context (EGL error 0x" << std::hex << eglGetError() << std::dec << ")"
+                  << std::endl;
+        destroy();
+        return false;
+    }
+    mContext = context;
+
+    // A tiny pbuffer keeps drivers without EGL_KHR_surfaceless_context happy
+    if (haveConfig) {
+        const EGLint surfaceAttribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+        EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+        mSurface = surface == EGL_NO_SURFACE ? nullptr : surface;
+    }
+
+    if (!makeCurrent()) {
+        std::cerr << "Failed to make the headless context current" << std::endl;
+        destroy();
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        std::cerr << "Failed to load OpenGL functions" << std::endl;
+        destroy();
+        return false;
+    }
+
+    const GLubyte* renderer = glGetString(GL_RENDERER);
+    mRenderer = renderer ? (const char*)renderer : "unknown";
+    return true;
+}
+
+bool NDIHeadlessContext::makeCurrent() {
+    if (!mContext) return false;
+    EGLSurface surface = mSurface ? (EGLSurface)mSurface : EGL_NO_SURFACE;
+    return eglMakeCurrent((EGLDisplay)mDisplay, surface, surface, (EGLContext)mContext) == EGL_TRUE;
+}
+
+void NDIHeadlessContext::destroy() {
+    if (!mDisplay) return;
+    EGLDisplay display = (EGLDisplay)mDisplay;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (mSurface) eglDestroySurface(display, (EGLSurface)mSurface);
+    if (mContext) eglDestroyContext(display, (EGLContext)mContext);
+    eglTerminate(display);
+    mSurface = nullptr;
+    mContext = nullptr;
+    mDisplay = nullptr;
+    mRenderer.clear();
+}
+
+} // namespace al
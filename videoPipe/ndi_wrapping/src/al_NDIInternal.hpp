@@ -0,0 +1,27 @@
+#ifndef INCLUDE_AL_NDI_INTERNAL_HPP
+#define INCLUDE_AL_NDI_INTERNAL_HPP
+
+// Helpers shared by the al_ndi sources. Not installed.
+
+#include <stdint.h>
+
+#include "al/graphics/al_OpenGL.hpp"
+
+#include <chrono>
+
+namespace al {
+
+// Monotonic clock in nanoseconds for intervals, deadlines and recording
+// stamps on this host
+inline int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Compiles and links a vertex and fragment shader pair. Returns the
+// program, or 0 after printing the log prefixed with name.
+GLuint buildShaderProgram(const char* vertexSource, const char* fragmentSource, const char* name);
+
+} // namespace al
+
+#endif
@@ -0,0 +1,323 @@
+#include "al_ext/ndi/al_NDIMosaic.hpp"
+#include "al_NDIInternal.hpp"
+
+#include <iostream>
+
+namespace al {
+
+namespace {
+
+const int kMaxInstances = NDIMosaic::kMaxInputs * 2; // a region crossing the seam is drawn twice
+
+const char* kVertexShader = R"(
+#version 330 core
+uniform vec4 uRect[32];  // canvas x, y, width, height
+uniform vec4 uCrop[32];  // layer u, v, width, height
+uniform float uLayer[32];
+out vec2 vTexCoord;
+flat out float vLayer;
+void main() {
+    // Triangle strip corners (0,0) (1,0) (0,1) (1,1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec4 rect = uRect[gl_InstanceID];
+    vec4 crop = uCrop[gl_InstanceID];
+    vTexCoord = crop.xy + corner * crop.zw;
+    vLayer = uLayer[gl_InstanceID];
+    gl_Position = vec4((rect.xy + corner * rect.zw) * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* kFragmentShader = R"(
+#version 330 core
+uniform sampler2DArray uLayers;
+in vec2 vTexCoord;
+flat in float vLayer;
+out vec4 fragColor;
+void main() {
+    fragColor = texture(uLayers, vec3(vTexCoord, vLayer));
+}
+)";
+
+} // namespace
+
+NDIMosaic::NDIMosaic()
+    : mCanvasWidth(0)
+    , mCanvasHeight(0)
+    , mLayerWidth(0)
+    , mLayerHeight(0)
+    , mLayerCount(0)
+    , mFullRedraw(true)
+    , mLayers(0)
+    , mFBO(0)
+    , mVAO(0)
+    , mProgram(0)
+    , mRectLocation(-1)
+    , mCropLocation(-1)
+    , mLayerLocation(-1)
+    , mSamplerLocation(-1)
+    , mStats()
+{
+    mBackground[0] = mBackground[1] = mBackground[2] = 0.0f;
+}
+
+NDIMosaic::~NDIMosaic() {
+    cleanup();
+}
+
+bool NDIMosaic::init(int canvasWidth, int canvasHeight, int layerWidth, int layerHeight) {
+    cleanup();
+
+    mProgram = buildShaderProgram(kVertexShader, kFragmentShader, "NDI mosaic");
+    if (!mProgram) return false;
+    mRectLocation = glGetUniformLocation(mProgram, "uRect");
+    mCropLocation = glGetUniformLocation(mProgram, "uCrop");
+    mLayerLocation = glGetUniformLocation(mProgram, "uLayer");
+    mSamplerLocation = glGetUniformLocation(mProgram, "uLayers");
+
+    glGenVertexArrays(1, &mVAO);
+    glGenFramebuffers(1, &mFBO);
+    glGenTextures(1, &mLayers);
+
+    mCanvasWidth = canvasWidth;
+    mCanvasHeight = canvasHeight;
+    mLayerWidth = layerWidth;
+    mLayerHeight = layerHeight;
+    mFullRedraw = true;
+    if (!mInputs.empty() && !allocateLayers(mLayerWidth, mLayerHeight, (int)mInputs.size())) {
+        cleanup();
+        return false;
+    }
+    return true;
+}
+
+void NDIMosaic::cleanup() {
+    if (mProgram) {
+        glDeleteProgram(mProgram);
+        mProgram = 0;
+    }
+    if (mVAO) {
+        glDeleteVertexArrays(1, &mVAO);
+        mVAO = 0;
+    }
+    if (mFBO) {
+        glDeleteFramebuffers(1, &mFBO);
+        mFBO = 0;
+    }
+    if (mLayers) {
+        glDeleteTextures(1, &mLayers);
+        mLayers = 0;
+    }
+    mLayerCount = 0;
+}
+
+int NDIMosaic::addInput(NDIFrameSource* source, const Region& region) {
+    if (!source || (int)mInputs.size() >= kMaxInputs) {
+        std::cerr << "NDI mosaic supports up to " << kMaxInputs << " inputs" << std::endl;
+        return -1;
+    }
+    Input input;
+    input.source = source;
+    input.region = region;
+    input.frameWidth = 0;
+    input.frameHeight = 0;
+    input.hasFrame = false;
+    mInputs.push_back(input);
+
+    if (mLayers && !allocateLayers(mLayerWidth, mLayerHeight, (int)mInputs.size())) {
+        mInputs.pop_back();
+        return -1;
+    }
+    mFullRedraw = true;
+    return (int)mInputs.size() - 1;
+}
+
+void NDIMosaic::region(int input, const Region& region) {
+    if (input < 0 || input >= (int)mInputs.size()) return;
+    mInputs[input].region = region;
+    mFullRedraw = true;
+}
+
+bool NDIMosaic::allocateLayers(int width, int height, int layers) {
+    // Reallocation drops every layer's contents, inputs wait for their next frame
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mLayers);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0,
+                 GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    if (glGetError() != GL_NO_ERROR) {
+        std::cerr << "Failed to allocate " << layers << " NDI mosaic layers of "
+                  << width << "x" << height << std::endl;
+        return false;
+    }
+
+    mLayerWidth = width;
+    mLayerHeight = height;
+    mLayerCount = layers;
+    for (size_t i = 0; i < mInputs.size(); i++) {
+        mInputs[i].hasFrame = false;
+    }
+    mFullRedraw = true;
+    return true;
+}
+
+void NDIMosaic::uploadLayer(int layer, const NDIlib_video_frame_v2_t& frame) {
+    if (frame.xres > mLayerWidth || frame.yres > mLayerHeight) {
+        int width = frame.xres > mLayerWidth ? frame.xres : mLayerWidth;
+        int height = frame.yres > mLayerHeight ? frame.yres : mLayerHeight;
+        if (!allocateLayers(width, height, mLayerCount)) return;
+    }
+
+    GLenum format;
+    int rowLength;
+    const void* pixels = uploadPixels(frame, format, rowLength);
+    if (!pixels) return;
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mLayers);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, frame.xres, frame.yres, 1,
+                    format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    Input& input = mInputs[layer];
+    input.frameWidth = frame.xres;
+    input.frameHeight = frame.yres;
+    input.hasFrame = true;
+    mStats.layerUploads++;
+}
+
+bool NDIMosaic::overlaps(const Region& a, const Region& b) {
+    // Conservative around the seam: compare on the unwrapped axis and shifted by one turn
+    for (int shift = -1; shift <= 1; shift++) {
+        float bx = b.x + shift;
+        if (a.x < bx + b.width && bx < a.x + a.width &&
+            a.y < b.y + b.height && b.y < a.y + a.height) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool NDIMosaic::update(Texture& canvas) {
+    if (!mProgram || mInputs.empty()) return false;
+
+    // Upload only the inputs with a new frame
+    bool redraw[kMaxInputs] = {};
+    bool anyChanged = false;
+    for (size_t i = 0; i < mInputs.size(); i++) {
+        int layer = (int)i;
+        bool fresh = mInputs[i].source->consume([this, layer](const NDIlib_video_frame_v2_t& frame) {
+            uploadLayer(layer, frame);
+        });
+        redraw[i] = fresh && mInputs[i].hasFrame;
+        anyChanged = anyChanged || redraw[i];
+        if (!fresh) mStats.inputsIdle++;
+    }
+
+    if ((int)canvas.width() != mCanvasWidth || (int)canvas.height() != mCanvasHeight) {
+        canvas.resize(mCanvasWidth, mCanvasHeight);
+        mFullRedraw = true;
+    }
+    if (!anyChanged && !mFullRedraw) return false;
+
+    // Inputs stacked above a repainted one are repainted too so they stay on top
+    for (size_t i = 0; i < mInputs.size(); i++) {
+        if (mFullRedraw) redraw[i] = true;
+        if (!redraw[i]) continue;
+        for (size_t j = i + 1; j < mInputs.size(); j++) {
+            if (!redraw[j] && overlaps(mInputs[i].region, mInputs[j].region)) redraw[j] = true;
+        }
+    }
+
+    float rects[kMaxInstances * 4];
+    float crops[kMaxInstances * 4];
+    float layers[kMaxInstances];
+    int instances = 0;
+    for (size_t i = 0; i < mInputs.size(); i++) {
+        const Input& input = mInputs[i];
+        if (!redraw[i] || !input.hasFrame) continue;
+        const Region& r = input.region;
+
+        // Crop is relative to the frame, which fills only part of its layer
+        float fillX = (float)input.frameWidth / mLayerWidth;
+        float fillY = (float)input.frameHeight / mLayerHeight;
+        float crop[4] = { r.cropX * fillX, r.cropY * fillY, r.cropWidth * fillX, r.cropHeight * fillY };
+
+        // Regions crossing the 360° seam are drawn again one turn over
+        float shifts[2] = { 0.0f, r.x + r.width > 1.0f ? -1.0f : (r.x < 0.0f ? 1.0f : 0.0f) };
+        for (int s = 0; s < (shifts[1] != 0.0f ? 2 : 1); s++) {
+            float rect[4] = { r.x + shifts[s], r.y, r.width, r.height };
+            for (int k = 0; k < 4; k++) {
+                rects[instances * 4 + k] = rect[k];
+                crops[instances * 4 + k] = crop[k];
+            }
+            layers[instances] = (float)i;
+            instances++;
+        }
+    }
+
+    // Save the state the pass touches
+    GLint previousFBO, previousProgram, previousVAO, previousActiveTexture, previousArray;
+    GLint previousViewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFBO);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &previousActiveTexture);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+    GLboolean cull = glIsEnabled(GL_CULL_FACE);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousArray);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mFBO);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, canvas.id(), 0);
+    glViewport(0, 0, mCanvasWidth, mCanvasHeight);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_CULL_FACE);
+
+    if (mFullRedraw) {
+        glClearColor(mBackground[0], mBackground[1], mBackground[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    if (instances > 0) {
+        glUseProgram(mProgram);
+        glUniform4fv(mRectLocation, instances, rects);
+        glUniform4fv(mCropLocation, instances, crops);
+        glUniform1fv(mLayerLocation, instances, layers);
+        glUniform1i(mSamplerLocation, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mLayers);
+        glBindVertexArray(mVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances);
+    }
+
+    // Restore
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFBO);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, previousArray);
+    glActiveTexture(previousActiveTexture);
+    glBindVertexArray(previousVAO);
+    glUseProgram(previousProgram);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+    if (blend) glEnable(GL_BLEND);
+    if (scissor) glEnable(GL_SCISSOR_TEST);
+    if (cull) glEnable(GL_CULL_FACE);
+
+    mFullRedraw = false;
+    mWidth = mCanvasWidth;
+    mHeight = mCanvasHeight;
+    mGeneration++;
+    mStats.composites++;
+    mStats.regionsDrawn += instances;
+    return true;
+}
+
+} // namespace al
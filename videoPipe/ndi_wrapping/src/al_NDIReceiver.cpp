@@ -1,11 +1,25 @@
 #include "al_ext/ndi/al_NDIReceiver.hpp"
+#include "al_NDIInternal.hpp"
+#ifndef _WIN32
+#include "al_ext/ndi/al_NDIRecording.hpp"
+#endif
+#include <string.h>
+
+#include <chrono>
 #include <iostream>
 // From Tim Wood's NDI examples
 namespace al {
 
+namespace {
+
+const uint32_t kFindWaitMs = 100;    // per source search round on the capture thread
+const uint32_t kCaptureWaitMs = 100; // keeps the capture thread responsive to disconnect()
+const int kConnectWaitMs = 5000;     // connect() gives up after this long
 
+} // namespace
 
-std::vector<Source> NDIReceiver::getAvailableSources() {
+template <class Format>
+std::vector<Source> BasicNDIReceiver<Format>::getAvailableSources() {
     std::vector<Source> sources;
     if (!mInitialized) return sources;
 
@@ -30,24 +44,34 @@ std::vector<Source> NDIReceiver::getAvailableSources() {
     return sources;
 }
 
-NDIReceiver::NDIReceiver()
+template <class Format>
+BasicNDIReceiver<Format>::BasicNDIReceiver()
     : mReceiver(nullptr)
     , mInitialized(false)
-    , mWidth(0)
-    , mHeight(0)
+    , mRunning(false)
+    , mState(DISCONNECTED)
+    , mTimeoutNs(2000000000ll)
+    , mStats()
+    , mHavePending(false)
+    , mFrameSyncMode(false)
+    , mFrameSync(nullptr)
+    , mShownTimestamp(0)
+    , mLastFrameNs(0)
+#ifndef _WIN32
+    , mRecorder(nullptr)
+#endif
 {}
 
-NDIReceiver::~NDIReceiver() {
-    if (mReceiver) {
-        NDIlib_recv_destroy(mReceiver);
-        mReceiver = nullptr;
-    }
+template <class Format>
+BasicNDIReceiver<Format>::~BasicNDIReceiver() {
+    disconnect();
     if (mInitialized) {
         NDIlib_destroy();
     }
 }
 
-bool NDIReceiver::init() {
+template <class Format>
+bool BasicNDIReceiver<Format>::init() {
     if (!NDIlib_initialize()) {
         std::cerr << "Failed to initialize NDI" << std::endl;
         return false;
@@ -56,105 +80,342 @@ bool NDIReceiver::init() {
     return true;
 }
 
-bool NDIReceiver::connect(const char* sourceName) {
+template <class Format>
+bool BasicNDIReceiver<Format>::connect(const char* sourceName) {
+    connectAsync(sourceName);
+    if (!mReceiver) return false;
+
+    for (int waited = 0; waited < kConnectWaitMs && !isConnected(); waited += 10) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (!isConnected()) {
+        if (sourceName) {
+            std::cerr << "Specified source '" << sourceName << "' not found" << std::endl;
+        } else {
+            std::cerr << "No NDI sources found" << std::endl;
+        }
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+template <class Format>
+void BasicNDIReceiver<Format>::connectAsync(const char* sourceName) {
     if (!mInitialized) {
         std::cerr << "NDI not initialized" << std::endl;
-        return false;
+        return;
+    }
+    disconnect();
+
+    // One receiver for the whole connection; failover retargets it with
+    // NDIlib_recv_connect so frames already handed out stay valid
+    NDIlib_recv_create_v3_t receiverDesc;
+    receiverDesc.color_format = Format::recvColorFormat;
+    receiverDesc.bandwidth = NDIlib_recv_bandwidth_highest;
+    receiverDesc.allow_video_fields = false;
+
+    mReceiver = NDIlib_recv_create_v3(&receiverDesc);
+    if (!mReceiver) {
+        std::cerr << "Failed to create NDI receiver" << std::endl;
+        return;
     }
+    if (mFrameSyncMode) {
+        std::lock_guard<std::mutex> lock(mAudioLock);
+        mFrameSync = NDIlib_framesync_create(mReceiver);
+        if (!mFrameSync) {
+            std::cerr << "Failed to create NDI frame synchronizer, queueing frames instead" << std::endl;
+        }
+        mShownTimestamp = 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mStatusLock);
+        mRequestedSource = sourceName ? sourceName : "";
+        mSourceName.clear();
+    }
+    mState = CONNECTING;
+    mRunning = true;
+    mThread = std::thread(&BasicNDIReceiver::run, this);
+}
+
+template <class Format>
+void BasicNDIReceiver<Format>::disconnect() {
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    if (mReceiver) {
+        if (mFrameSync) {
+            std::lock_guard<std::mutex> frameLock(mFrameLock);
+            std::lock_guard<std::mutex> audioLock(mAudioLock);
+            NDIlib_framesync_destroy(mFrameSync);
+            mFrameSync = nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mFrameLock);
+            if (mHavePending) {
+                NDIlib_recv_free_video_v2(mReceiver, &mPending);
+                mHavePending = false;
+            }
+        }
+        NDIlib_recv_destroy(mReceiver);
+        mReceiver = nullptr;
+    }
+    mState = DISCONNECTED;
+    std::lock_guard<std::mutex> lock(mStatusLock);
+    mSourceName.clear();
+}
+
+template <class Format>
+void BasicNDIReceiver<Format>::setBackupSources(const std::vector<std::string>& sourceNames) {
+    std::lock_guard<std::mutex> lock(mStatusLock);
+    mBackupSources = sourceNames;
+}
+
+template <class Format>
+std::string BasicNDIReceiver<Format>::sourceName() const {
+    std::lock_guard<std::mutex> lock(mStatusLock);
+    return mSourceName;
+}
+
+template <class Format>
+NDIReceiverBase::Stats BasicNDIReceiver<Format>::stats() const {
+    std::lock_guard<std::mutex> lock(mStatusLock);
+    return mStats;
+}
+
+#ifndef _WIN32
+template <class Format>
+void BasicNDIReceiver<Format>::setRecorder(NDIRecorder* recorder) {
+    std::lock_guard<std::mutex> lock(mRecorderLock);
+    mRecorder = recorder;
+}
+#endif
+
+template <class Format>
+void BasicNDIReceiver<Format>::run() {
+    if (mThreadStart) mThreadStart();
 
-    // Create a finder to locate NDI sources
     NDIlib_find_instance_t finder = NDIlib_find_create_v2();
     if (!finder) {
         std::cerr << "Failed to create NDI finder" << std::endl;
-        return false;
+        mState = DISCONNECTED;
+        return;
     }
 
-    // Wait for sources to be available
-    uint32_t num_sources = 0;
-    const NDIlib_source_t* sources = nullptr;
-    
-    // Wait up to 5 seconds for sources
-    for (int i = 0; i < 50 && num_sources == 0; i++) {
-        NDIlib_find_wait_for_sources(finder, 100); // Wait 100ms
-        sources = NDIlib_find_get_current_sources(finder, &num_sources);
+    bool haveSource = false;
+    std::string failedSource;
+    int64_t failedUntilNs = 0;
+
+    while (mRunning) {
+        if (!haveSource) {
+            // Give a source that just failed a rest unless nothing else is there
+            bool skipFailed = steadyNs() < failedUntilNs;
+            haveSource = selectSource(finder, failedSource, skipFailed) ||
+                         (skipFailed && selectSource(finder, failedSource, false));
+            if (haveSource) {
+                mLastFrameNs = steadyNs();
+                mState = CONNECTED;
+            }
+            continue;
+        }
+
+        int64_t now;
+        bool lost;
+        if (mFrameSync) {
+            // update() pulls the frames, only watch that new ones keep coming
+            std::this_thread::sleep_for(std::chrono::milliseconds(kCaptureWaitMs));
+            now = steadyNs();
+            lost = now - mLastFrameNs > mTimeoutNs;
+        } else {
+            NDIlib_video_frame_v2_t videoFrame;
+            NDIlib_frame_type_e frameType = NDIlib_recv_capture_v2(
+                mReceiver, &videoFrame, nullptr, nullptr, kCaptureWaitMs
+            );
+
+            now = steadyNs();
+            if (frameType == NDIlib_frame_type_video) {
+                mLastFrameNs = now;
+                record(videoFrame);
+                publish(videoFrame);
+            }
+            lost = frameType == NDIlib_frame_type_error || now - mLastFrameNs > mTimeoutNs;
+        }
+        if (lost) {
+            std::lock_guard<std::mutex> lock(mStatusLock);
+            std::cerr << "NDI source '" << mSourceName << "' stopped sending, reconnecting" << std::endl;
+            failedSource = mSourceName;
+            failedUntilNs = now + 2 * mTimeoutNs;
+            mStats.reconnects++;
+            mState = RECONNECTING;
+            haveSource = false;
+        }
     }
 
-    if (num_sources == 0) {
-        std::cerr << "No NDI sources found" << std::endl;
-        NDIlib_find_destroy(finder);
-        return false;
+    NDIlib_find_destroy(finder);
+}
+
+template <class Format>
+bool BasicNDIReceiver<Format>::selectSource(NDIlib_find_instance_t finder, const std::string& failedSource, bool skipFailed) {
+    NDIlib_find_wait_for_sources(finder, kFindWaitMs);
+    uint32_t numSources = 0;
+    const NDIlib_source_t* sources = NDIlib_find_get_current_sources(finder, &numSources);
+    if (numSources == 0) return false;
+
+    std::vector<std::string> candidates;
+    std::string previous;
+    {
+        std::lock_guard<std::mutex> lock(mStatusLock);
+        if (!mRequestedSource.empty()) candidates.push_back(mRequestedSource);
+        candidates.insert(candidates.end(), mBackupSources.begin(), mBackupSources.end());
+        previous = mSourceName;
     }
 
-    // Select the source
-    const NDIlib_source_t* selected_source = nullptr;
-    if (sourceName) {
-        // Look for specific source
-        for (uint32_t i = 0; i < num_sources; i++) {
-            if (strcmp(sources[i].p_ndi_name, sourceName) == 0) {
-                selected_source = &sources[i];
+    // Requested source first, then backups; with no names any source will do
+    const NDIlib_source_t* selected = nullptr;
+    for (size_t c = 0; c < candidates.size() && !selected; c++) {
+        if (skipFailed && candidates[c] == failedSource) continue;
+        for (uint32_t i = 0; i < numSources; i++) {
+            if (candidates[c] == sources[i].p_ndi_name) {
+                selected = &sources[i];
                 break;
             }
         }
-        if (!selected_source) {
-            std::cerr << "Specified source '" << sourceName << "' not found" << std::endl;
-            NDIlib_find_destroy(finder);
-            return false;
+    }
+    if (candidates.empty()) {
+        for (uint32_t i = 0; i < numSources && !selected; i++) {
+            if (!skipFailed || failedSource != sources[i].p_ndi_name) {
+                selected = &sources[i];
+            }
         }
-    } else {
-        // Use first available source
-        selected_source = &sources[0];
-        std::cout << "Connected to first available source: " << selected_source->p_ndi_name << std::endl;
     }
+    if (!selected) return false;
 
-    // Create the receiver
-    NDIlib_recv_create_v3_t receiverDesc;
-    receiverDesc.source_to_connect_to = *selected_source;
-    receiverDesc.color_format = NDIlib_recv_color_format_BGRX_BGRA;
-    receiverDesc.bandwidth = NDIlib_recv_bandwidth_highest;
-    receiverDesc.allow_video_fields = false;
+    NDIlib_recv_connect(mReceiver, selected);
 
-    mReceiver = NDIlib_recv_create_v3(&receiverDesc);
-    
-    // Clean up finder
-    NDIlib_find_destroy(finder);
+    std::lock_guard<std::mutex> lock(mStatusLock);
+    mSourceName = selected->p_ndi_name;
+    if (!previous.empty() && previous != mSourceName) {
+        mStats.failovers++;
+        std::cout << "Failing over from NDI source '" << previous << "' to '" << mSourceName << "'" << std::endl;
+    } else {
+        std::cout << "Connected to NDI source: " << mSourceName << std::endl;
+    }
+    return true;
+}
 
-    if (!mReceiver) {
-        std::cerr << "Failed to create NDI receiver" << std::endl;
-        return false;
+template <class Format>
+void BasicNDIReceiver<Format>::publish(NDIlib_video_frame_v2_t& frame) {
+    bool dropped = false;
+    {
+        std::lock_guard<std::mutex> lock(mFrameLock);
+        if (mHavePending) {
+            // Render thread has not picked up the previous frame, only the newest matters
+            NDIlib_recv_free_video_v2(mReceiver, &mPending);
+            dropped = true;
+        }
+        mPending = frame;
+        mHavePending = true;
     }
 
-    return true;
+    std::lock_guard<std::mutex> lock(mStatusLock);
+    mStats.framesReceived++;
+    if (dropped) mStats.framesDropped++;
 }
 
-bool NDIReceiver::update(Texture& tex) {
-    if (!mReceiver) return false;
+template <class Format>
+void BasicNDIReceiver<Format>::record(const NDIlib_video_frame_v2_t& frame) {
+#ifndef _WIN32
+    std::lock_guard<std::mutex> lock(mRecorderLock);
+    if (mRecorder) {
+        mRecorder->append(frame);
+    }
+#else
+    (void)frame;
+#endif
+}
 
-    NDIlib_video_frame_v2_t videoFrame;
-    NDIlib_frame_type_e frameType = NDIlib_recv_capture_v2(
-        mReceiver, &videoFrame, nullptr, nullptr, 1000
-    );
-
-    if (frameType == NDIlib_frame_type_video) {
-        // If texture dimensions changed, update the texture
-        if (mWidth != videoFrame.xres || mHeight != videoFrame.yres) {
-            mWidth = videoFrame.xres;
-            mHeight = videoFrame.yres;
-            
-            // Configure texture format and resize
-            // tex.format(GL_RGBA);
-            // tex.type(GL_UNSIGNED_BYTE);
-            tex.resize(mWidth, mHeight);
+template <class Format>
+bool BasicNDIReceiver<Format>::captureFrame(NDIlib_video_frame_v2_t& frame) {
+    if (mFrameSync) {
+        if (!mFrameLock.try_lock()) return false;
+        // The synchronizer returns the frame due now, repeating the last
+        // one while the source is behind the render clock
+        NDIlib_framesync_capture_video(mFrameSync, &frame, NDIlib_frame_format_type_progressive);
+        int64_t stamp = frame.timestamp != NDIlib_recv_timestamp_undefined ? frame.timestamp : frame.timecode;
+        if (!frame.p_data || stamp == mShownTimestamp) {
+            bool repeated = frame.p_data != nullptr;
+            NDIlib_framesync_free_video(mFrameSync, &frame);
+            mFrameLock.unlock();
+            if (repeated) {
+                std::lock_guard<std::mutex> lock(mStatusLock);
+                mStats.framesRepeated++;
+            }
+            return false;
         }
+        mShownTimestamp = stamp;
+        mLastFrameNs = steadyNs();
+        record(frame);
+        std::lock_guard<std::mutex> lock(mStatusLock);
+        mStats.framesReceived++;
+        return true;
+    }
 
-        // Update texture with new frame data
-        tex.submit(videoFrame.p_data, GL_BGRA, GL_UNSIGNED_BYTE);
+    // The capture thread only holds the lock to swap frames; if it is busy,
+    // pick the frame up next time instead of waiting. The lock stays held
+    // until releaseFrame() so the frame cannot be replaced while in use.
+    if (!mFrameLock.try_lock()) return false;
+    if (!mHavePending) {
+        mFrameLock.unlock();
+        return false;
+    }
+    frame = mPending;
+    return true;
+}
 
-        // Free the video frame
-        NDIlib_recv_free_video_v2(mReceiver, &videoFrame);
-        return true;
+template <class Format>
+void BasicNDIReceiver<Format>::releaseFrame(NDIlib_video_frame_v2_t& frame) {
+    if (mFrameSync) {
+        NDIlib_framesync_free_video(mFrameSync, &frame);
+        mFrameLock.unlock();
+        return;
     }
+    NDIlib_recv_free_video_v2(mReceiver, &frame);
+    mHavePending = false;
+    mFrameLock.unlock();
+}
 
-    return false;
+template <class Format>
+void BasicNDIReceiver<Format>::captureAudio(float* const* channels, int channelCount, int frames, int sampleRate) {
+    std::unique_lock<std::mutex> lock(mAudioLock, std::try_to_lock);
+    NDIlib_audio_frame_v2_t audio;
+    bool haveAudio = lock.owns_lock() && mFrameSync;
+    if (haveAudio) {
+        // Resampled to sampleRate to follow the caller's clock, silence if the source has no audio
+        NDIlib_framesync_capture_audio(mFrameSync, &audio, sampleRate, channelCount, frames);
+        haveAudio = audio.p_data != nullptr;
+    }
+    for (int c = 0; c < channelCount; c++) {
+        int copied = 0;
+        if (haveAudio && c < audio.no_channels) {
+            const float* source = (const float*)((const uint8_t*)audio.p_data + (size_t)c * audio.channel_stride_in_bytes);
+            copied = audio.no_samples < frames ? audio.no_samples : frames;
+            memcpy(channels[c], source, copied * sizeof(float));
+        }
+        memset(channels[c] + copied, 0, (frames - copied) * sizeof(float));
+    }
+    if (lock.owns_lock() && mFrameSync) {
+        NDIlib_framesync_free_audio(mFrameSync, &audio);
+    }
 }
 
-} // namespace al
\ No newline at end of file
+// The formats NDI can be asked to deliver; frames are still uploaded by
+// their actual FourCC since a source may send a variant of the request
+template class BasicNDIReceiver<NDIFormat::BGRA>;
+template class BasicNDIReceiver<NDIFormat::RGBA>;
+template class BasicNDIReceiver<NDIFormat::UYVY>;
+template class BasicNDIReceiver<NDIFormat::UYVA>;
+template class BasicNDIReceiver<NDIFormat::P216>;
+
+} // namespace al
@@ -0,0 +1,322 @@
+#include "al_ext/ndi/al_NDIRecording.hpp"
+#include "al_ext/ndi/al_NDIPixelFormat.hpp"
+#include "al_NDIInternal.hpp"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+
+namespace al {
+
+namespace {
+
+const char kRecordingMagic[8] = {'A', 'L', 'N', 'D', 'I', 'R', 'E', 'C'};
+const uint32_t kRecordingVersion = 1;
+const uint32_t kNDIRecordMagic = 0x4D415246; // "FRAM"
+const uint64_t kRecordAlign = 64;
+const uint64_t kGrowBytes = 256ull << 20;
+
+uint64_t alignUp(uint64_t value) {
+    return (value + kRecordAlign - 1) & ~(kRecordAlign - 1);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// NDIRecorder
+
+NDIRecorder::NDIRecorder()
+    : mFile(-1)
+    , mMapping(nullptr)
+    , mCapacity(0)
+{}
+
+NDIRecorder::~NDIRecorder() {
+    close();
+}
+
+bool NDIRecorder::open(const char* path) {
+    close();
+
+    mFile = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (mFile < 0) {
+        std::cerr << "Failed to create NDI recording " << path << std::endl;
+        return false;
+    }
+    mPath = path;
+    if (!reserve(kGrowBytes)) {
+        close();
+        return false;
+    }
+
+    NDIRecordingHeader* h = header();
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, kRecordingMagic, sizeof(h->magic));
+    h->version = kRecordingVersion;
+    h->headerBytes = (uint32_t)alignUp(sizeof(NDIRecordingHeader));
+    h->dataEnd = h->headerBytes;
+    h->createdNs = steadyNs();
+    mIndex.clear();
+    return true;
+}
+
+bool NDIRecorder::reserve(uint64_t bytes) {
+    if (bytes <= mCapacity) return true;
+    uint64_t capacity = mCapacity;
+    while (capacity < bytes) capacity += kGrowBytes;
+
+    if (ftruncate(mFile, (off_t)capacity) < 0) {
+        std::cerr << "Failed to grow NDI recording " << mPath << std::endl;
+        return false;
+    }
+    if (mMapping) munmap(mMapping, mCapacity);
+    void* mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map NDI recording " << mPath << std::endl;
+        mMapping = nullptr;
+        mCapacity = 0;
+        return false;
+    }
+    mMapping = (uint8_t*)mapping;
+    mCapacity = capacity;
+    return true;
+}
+
+bool NDIRecorder::append(const NDIlib_video_frame_v2_t& frame, int64_t receivedNs) {
+    if (!mMapping || !frame.p_data) return false;
+
+    // Planar formats (UYVA, P216, I420) store more than stride * yres bytes
+    uint64_t dataBytes = NDIFormat::frameBytes(frame);
+    if (!dataBytes) return false;
+    uint32_t metadataBytes = frame.p_metadata ? (uint32_t)strlen(frame.p_metadata) + 1 : 0;
+    uint64_t recordBytes = alignUp(sizeof(NDIRecordHeader) + dataBytes + metadataBytes);
+
+    uint64_t offset = header()->dataEnd;
+    if (!reserve(offset + recordBytes)) return false;
+
+    NDIRecordHeader* r = (NDIRecordHeader*)(mMapping + offset);
+    memset(r, 0, sizeof(*r));
+    r->magic = kNDIRecordMagic;
+    r->metadataBytes = metadataBytes;
+    r->recordBytes = recordBytes;
+    r->dataBytes = dataBytes;
+    r->receivedNs = receivedNs ? receivedNs : steadyNs();
+    r->timestamp = frame.timestamp;
+    r->timecode = frame.timecode;
+    r->xres = frame.xres;
+    r->yres = frame.yres;
+    r->lineStride = frame.line_stride_in_bytes;
+    if (!r->lineStride) {
+        NDIFormat::visitFormat(frame.FourCC, [&](auto traits) { r->lineStride = decltype(traits)::lineStride(frame.xres); });
+    }
+    r->fourCC = (uint32_t)frame.FourCC;
+    r->frameRateN = frame.frame_rate_N;
+    r->frameRateD = frame.frame_rate_D;
+    r->aspectRatio = frame.picture_aspect_ratio;
+    r->frameFormat = (int32_t)frame.frame_format_type;
+
+    uint8_t* payload = (uint8_t*)(r + 1);
+    memcpy(payload, frame.p_data, dataBytes);
+    if (metadataBytes) memcpy(payload + dataBytes, frame.p_metadata, metadataBytes);
+
+    // Commit: a reader never sees a record beyond dataEnd
+    NDIRecordIndexEntry entry;
+    entry.offset = offset;
+    entry.receivedNs = r->receivedNs;
+    mIndex.push_back(entry);
+    header()->dataEnd = offset + recordBytes;
+    header()->frameCount = mIndex.size();
+    return true;
+}
+
+uint64_t NDIRecorder::frameCount() const {
+    return mMapping ? header()->frameCount : 0;
+}
+
+void NDIRecorder::close() {
+    if (mMapping) {
+        uint64_t indexOffset = header()->dataEnd;
+        uint64_t indexBytes = mIndex.size() * sizeof(NDIRecordIndexEntry);
+        if (reserve(indexOffset + indexBytes)) {
+            if (indexBytes) memcpy(mMapping + indexOffset, mIndex.data(), indexBytes);
+            header()->indexOffset = indexOffset;
+        }
+        uint64_t used = header()->indexOffset ? indexOffset + indexBytes : header()->dataEnd;
+        msync(mMapping, mCapacity, MS_SYNC);
+        munmap(mMapping, mCapacity);
+        mMapping = nullptr;
+        mCapacity = 0;
+        if (ftruncate(mFile, (off_t)used) < 0) {
+            std::cerr << "Failed to trim NDI recording " << mPath << std::endl;
+        }
+    }
+    if (mFile >= 0) {
+        ::close(mFile);
+        mFile = -1;
+    }
+    mIndex.clear();
+}
+
+// ---------------------------------------------------------------------------
+// NDIReplaySource
+
+NDIReplaySource::NDIReplaySource()
+    : mFile(-1)
+    , mMapping(nullptr)
+    , mSize(0)
+    , mSpeed(ORIGINAL)
+    , mLoop(false)
+    , mPosition(0)
+    , mStartNs(0)
+    , mFirstFrameNs(0)
+{}
+
+NDIReplaySource::~NDIReplaySource() {
+    close();
+}
+
+bool NDIReplaySource::open(const char* path) {
+    close();
+
+    mFile = ::open(path, O_RDONLY);
+    if (mFile < 0) {
+        std::cerr << "Failed to open NDI recording " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(mFile, &info) < 0 || (uint64_t)info.st_size < sizeof(NDIRecordingHeader)) {
+        std::cerr << "NDI recording " << path << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+    mSize = (uint64_t)info.st_size;
+    void* mapping = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, mFile, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map NDI recording " << path << std::endl;
+        mSize = 0;
+        close();
+        return false;
+    }
+    mMapping = (const uint8_t*)mapping;
+
+    const NDIRecordingHeader* h = (const NDIRecordingHeader*)mMapping;
+    if (memcmp(h->magic, kRecordingMagic, sizeof(h->magic)) != 0 || h->version != kRecordingVersion) {
+        std::cerr << path << " is not an NDI recording" << std::endl;
+        close();
+        return false;
+    }
+    if (!buildIndex()) {
+        std::cerr << "NDI recording " << path << " has a corrupt index" << std::endl;
+        close();
+        return false;
+    }
+    rewind();
+    return true;
+}
+
+bool NDIReplaySource::buildIndex() {
+    const NDIRecordingHeader* h = (const NDIRecordingHeader*)mMapping;
+    mIndex.clear();
+
+    uint64_t indexBytes = h->frameCount * sizeof(NDIRecordIndexEntry);
+    if (h->indexOffset && h->indexOffset + indexBytes <= mSize) {
+        const NDIRecordIndexEntry* entries = (const NDIRecordIndexEntry*)(mMapping + h->indexOffset);
+        mIndex.assign(entries, entries + h->frameCount);
+    } else {
+        // Recording was not closed cleanly: walk the committed records
+        uint64_t end = h->dataEnd < mSize ? h->dataEnd : mSize;
+        uint64_t offset = h->headerBytes;
+        while (offset + sizeof(NDIRecordHeader) <= end) {
+            const NDIRecordHeader* r = (const NDIRecordHeader*)(mMapping + offset);
+            if (r->magic != kNDIRecordMagic || r->recordBytes == 0 || offset + r->recordBytes > end) break;
+            NDIRecordIndexEntry entry;
+            entry.offset = offset;
+            entry.receivedNs = r->receivedNs;
+            mIndex.push_back(entry);
+            offset += r->recordBytes;
+        }
+    }
+
+    for (size_t i = 0; i < mIndex.size(); i++) {
+        const NDIRecordHeader* r = record(i);
+        if (!r || r->magic != kNDIRecordMagic) return false;
+    }
+    return true;
+}
+
+void NDIReplaySource::close() {
+    if (mMapping) {
+        munmap((void*)mMapping, mSize);
+        mMapping = nullptr;
+    }
+    if (mFile >= 0) {
+        ::close(mFile);
+        mFile = -1;
+    }
+    mSize = 0;
+    mIndex.clear();
+    mPosition = 0;
+}
+
+void NDIReplaySource::rewind() {
+    mPosition = 0;
+    mStartNs = steadyNs();
+    mFirstFrameNs = mIndex.empty() ? 0 : mIndex[0].receivedNs;
+}
+
+const NDIRecordHeader* NDIReplaySource::record(size_t index) const {
+    if (index >= mIndex.size()) return nullptr;
+    uint64_t offset = mIndex[index].offset;
+    if (offset + sizeof(NDIRecordHeader) > mSize) return nullptr;
+    const NDIRecordHeader* r = (const NDIRecordHeader*)(mMapping + offset);
+    if (offset + r->recordBytes > mSize) return nullptr;
+    return r;
+}
+
+bool NDIReplaySource::frame(size_t index, NDIlib_video_frame_v2_t& out, int64_t* receivedNs) const {
+    const NDIRecordHeader* r = record(index);
+    if (!r) return false;
+
+    out.xres = r->xres;
+    out.yres = r->yres;
+    out.FourCC = (NDIlib_FourCC_video_type_e)r->fourCC;
+    out.frame_rate_N = r->frameRateN;
+    out.frame_rate_D = r->frameRateD;
+    out.picture_aspect_ratio = r->aspectRatio;
+    out.frame_format_type = (NDIlib_frame_format_type_e)r->frameFormat;
+    out.timecode = r->timecode;
+    out.p_data = (uint8_t*)(r + 1);
+    out.line_stride_in_bytes = r->lineStride;
+    out.p_metadata = r->metadataBytes ? (const char*)(out.p_data + r->dataBytes) : nullptr;
+    out.timestamp = r->timestamp;
+    if (receivedNs) *receivedNs = r->receivedNs;
+    return true;
+}
+
+bool NDIReplaySource::captureFrame(NDIlib_video_frame_v2_t& videoFrame) {
+    if (!mMapping || mIndex.empty()) return false;
+    if (mPosition >= mIndex.size()) {
+        if (!mLoop) return false;
+        rewind();
+    }
+
+    if (mSpeed == ORIGINAL) {
+        int64_t due = mIndex[mPosition].receivedNs - mFirstFrameNs;
+        if (steadyNs() - mStartNs < due) return false;
+        // Skip frames that are already late so replay keeps the original pace
+        while (mPosition + 1 < mIndex.size() &&
+               steadyNs() - mStartNs >= mIndex[mPosition + 1].receivedNs - mFirstFrameNs) {
+            mPosition++;
+        }
+    }
+
+    if (!frame(mPosition, videoFrame)) return false;
+    mPosition++;
+    return true;
+}
+
+} // namespace al
@@ -1,25 +1,68 @@
 #include "al_ext/ndi/al_NDISender.hpp"
+#include "al_ext/ndi/al_FrameProfiler.hpp"
+#include "al_ext/ndi/al_NDIPixelFormat.hpp"
+#include "al_NDIInternal.hpp"
+#include <string.h>
+
 #include <iostream>
 // From Tim Wood's NDI examples
 namespace al {
 
-NDISender::NDISender()
+namespace {
+
+const double kSmoothing = 0.1;       // weight of the newest sample in the timing averages
+const size_t kMaxSwitchHistory = 64; // rate switches kept in Stats::switches
+
+// Even sizes keep chroma-subsampled receivers happy
+int scaledSize(int size, float scale) {
+    int scaled = (int)(size * scale + 0.5f) & ~1;
+    return scaled < 2 ? 2 : scaled;
+}
+
+void smooth(double& average, double sample, bool first) {
+    average = first ? sample : average + kSmoothing * (sample - average);
+}
+
+} // namespace
+
+template <class Format>
+BasicNDISender<Format>::BasicNDISender()
     : mSender(nullptr)
     , mInitialized(false)
     , mHardwareEnabled(false)
+    , mStats()
+    , mSignature(0)
+    , mSignatureValid(false)
+    , mWatched(false)
+    , mLastTransmitNs(0)
+    , mOverloadFrames(0)
+    , mHeadroomFrames(0)
+    , mIntervalSamples(0)
+    , mFrameCounter(0)
+    , mInitNs(0)
+    , mLastSwitchNs(0)
+    , mLastSendNs(0)
+    , mPendingData(nullptr)
+    , mCopyIndex(0)
+    , mProfiler(nullptr)
+    , mMetadataIndex(0)
 {
     memset(&mHardwareCtx, 0, sizeof(mHardwareCtx));
+    mParamsXml[0] = '\0';
 }
 
-NDISender::~NDISender() {
+template <class Format>
+BasicNDISender<Format>::~BasicNDISender() {
     cleanupHardwareContext();
     if (mSender) {
+        flush();
         NDIlib_send_destroy(mSender);
         mSender = nullptr;
     }
 }
 
-bool NDISender::init(const char* senderName, const VideoConfig& config, bool enableHardware) {
+template <class Format>
+bool BasicNDISender<Format>::init(const char* senderName, const VideoConfig& config, bool enableHardware) {
     if (!NDIlib_initialize()) {
         std::cerr << "Failed to initialize NDI" << std::endl;
         return false;
@@ -28,7 +71,7 @@ bool NDISender::init(const char* senderName, const VideoConfig& config, bool ena
     NDIlib_send_create_t desc;
     desc.p_ndi_name = senderName;
     desc.p_groups = nullptr;
-    desc.clock_video = true;
+    desc.clock_video = config.clockVideo;
     desc.clock_audio = false;
 
     mSender = NDIlib_send_create(&desc);
@@ -38,6 +81,9 @@ bool NDISender::init(const char* senderName, const VideoConfig& config, bool ena
     }
 
     mInitialized = true;
+    mConfig = config;
+    mInitNs = steadyNs();
+    mLastSwitchNs = mInitNs;
 
     if (enableHardware) {
         mHardwareEnabled = initHardwareContext(config.width, config.height);
@@ -51,12 +97,13 @@ bool NDISender::init(const char* senderName, const VideoConfig& config, bool ena
     return true;
 }
 
-bool NDISender::initHardwareContext(int width, int height) {
+template <class Format>
+bool BasicNDISender<Format>::initHardwareContext(int width, int height) {
     // Allocate CPU memory for pixel data
     // NDI requires pixel data in CPU memory for software sending.
     // Hardware acceleration would use GPU textures directly, but that's not
     // available on macOS OpenGL. We copy GPU textures to CPU memory instead.
-    size_t dataSize = width * height * 4; // RGBA8 = 4 bytes per pixel
+    size_t dataSize = Format::frameBytes(width, height, lineStrideFor(width));
     mHardwareCtx.pPixelData = new uint8_t[dataSize];
     if (!mHardwareCtx.pPixelData) {
         std::cerr << "Failed to allocate pixel data memory" << std::endl;
@@ -71,6 +118,9 @@ bool NDISender::initHardwareContext(int width, int height) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
 
+    // Source textures are attached here so they can be blitted into sharedTexture
+    glGenFramebuffers(1, &mHardwareCtx.sourceFBO);
+
     // Create persistent FBO for copying
     glGenFramebuffers(1, &mHardwareCtx.copyFBO);
     glBindFramebuffer(GL_FRAMEBUFFER, mHardwareCtx.copyFBO);
@@ -88,25 +138,28 @@ bool NDISender::initHardwareContext(int width, int height) {
     }
 
     // Initialize video frame structure
-    mHardwareCtx.videoFrame.FourCC = NDIlib_FourCC_type_BGRA;
+    mHardwareCtx.videoFrame.FourCC = Format::fourCC;
     mHardwareCtx.videoFrame.frame_format_type = NDIlib_frame_format_type_progressive;
     mHardwareCtx.videoFrame.timecode = NDIlib_send_timecode_synthesize;
     // Point to our allocated CPU pixel buffer (not a texture ID!)
     mHardwareCtx.videoFrame.p_data = mHardwareCtx.pPixelData;
     mHardwareCtx.videoFrame.xres = width;
     mHardwareCtx.videoFrame.yres = height;
+    mHardwareCtx.videoFrame.line_stride_in_bytes = lineStrideFor(width);
     mHardwareCtx.videoFrame.picture_aspect_ratio = (float)width / (float)height;
-    mHardwareCtx.videoFrame.frame_rate_N = 60000;
-    mHardwareCtx.videoFrame.frame_rate_D = 1000;
+    setFrameRate(mRateControl.enabled ? mRateControl.ladder[mStats.rung].frameRateDivisor : 1);
 
     mHardwareCtx.width = width;
     mHardwareCtx.height = height;
+    mStats.width = width;
+    mStats.height = height;
     mHardwareCtx.needsResize = false;
 
     return true;
 }
 
-void NDISender::cleanupHardwareContext() {
+template <class Format>
+void BasicNDISender<Format>::cleanupHardwareContext() {
     if (mHardwareCtx.pPixelData) {
         delete[] mHardwareCtx.pPixelData;
         mHardwareCtx.pPixelData = nullptr;
@@ -115,20 +168,25 @@ void NDISender::cleanupHardwareContext() {
         glDeleteFramebuffers(1, &mHardwareCtx.copyFBO);
         mHardwareCtx.copyFBO = 0;
     }
+    if (mHardwareCtx.sourceFBO) {
+        glDeleteFramebuffers(1, &mHardwareCtx.sourceFBO);
+        mHardwareCtx.sourceFBO = 0;
+    }
     if (mHardwareCtx.sharedTexture) {
         glDeleteTextures(1, &mHardwareCtx.sharedTexture);
         mHardwareCtx.sharedTexture = 0;
     }
 }
 
-bool NDISender::resizeHardwareContext(int width, int height) {
+template <class Format>
+bool BasicNDISender<Format>::resizeHardwareContext(int width, int height) {
     if (width == mHardwareCtx.width && height == mHardwareCtx.height) {
         return true;
     }
 
     // Reallocate pixel data buffer for new dimensions
     // Must match the texture size for proper data transfer
-    size_t newDataSize = width * height * 4; // RGBA8 = 4 bytes per pixel
+    size_t newDataSize = Format::frameBytes(width, height, lineStrideFor(width));
     uint8_t* newPixelData = new uint8_t[newDataSize];
     if (!newPixelData) {
         std::cerr << "Failed to reallocate pixel data memory" << std::endl;
@@ -148,75 +206,425 @@ bool NDISender::resizeHardwareContext(int width, int height) {
     // Update video frame info
     mHardwareCtx.videoFrame.xres = width;
     mHardwareCtx.videoFrame.yres = height;
+    mHardwareCtx.videoFrame.line_stride_in_bytes = lineStrideFor(width);
     mHardwareCtx.videoFrame.picture_aspect_ratio = (float)width / (float)height;
 
     mHardwareCtx.width = width;
     mHardwareCtx.height = height;
     mHardwareCtx.needsResize = false;
+    mStats.width = width;
+    mStats.height = height;
+    mSignatureValid = false;
 
     return true;
 }
 
-bool NDISender::resize(int width, int height) {
+template <class Format>
+bool BasicNDISender<Format>::resize(int width, int height) {
     if (!mHardwareEnabled) return false;
     mHardwareCtx.needsResize = true;
     return resizeHardwareContext(width, height);
 }
 
-bool NDISender::sendDirect(GLuint textureId) {
+template <class Format>
+void BasicNDISender<Format>::rateControl(const RateControl& control) {
+    mRateControl = control;
+    if (mRateControl.ladder.empty()) {
+        mRateControl.ladder.push_back(RateRung());
+    }
+    mStats.rung = 0;
+    mOverloadFrames = 0;
+    mHeadroomFrames = 0;
+    if (mHardwareEnabled) {
+        setFrameRate(mRateControl.enabled ? mRateControl.ladder[0].frameRateDivisor : 1);
+    }
+}
+
+template <class Format>
+void BasicNDISender<Format>::setFrameRate(int divisor) {
+    mHardwareCtx.videoFrame.frame_rate_N = mConfig.frameRateN;
+    mHardwareCtx.videoFrame.frame_rate_D = mConfig.frameRateD * divisor;
+}
+
+template <class Format>
+int BasicNDISender<Format>::lineStrideFor(int width) const {
+    int stride = Format::lineStride(width);
+    int alignment = mConfig.lineAlignment;
+    return alignment > 0 ? (stride + alignment - 1) / alignment * alignment : stride;
+}
+
+template <class Format>
+bool BasicNDISender<Format>::sendDirect(GLuint textureId) {
+    return sendDirect(textureId, 0, 0, -1, -1);
+}
+
+template <class Format>
+bool BasicNDISender<Format>::sendDirect(GLuint textureId, int x, int y, int width, int height) {
     if (!mInitialized || !mHardwareEnabled) return false;
 
-    // Get the dimensions of the input texture
-    GLint width, height;
+    RateRung rung = mRateControl.enabled ? mRateControl.ladder[mStats.rung] : RateRung();
+    if (mFrameCounter++ % rung.frameRateDivisor != 0) {
+        mStats.framesDecimated++;
+        return true;
+    }
+
+    // Nobody is watching: no readback, no send
+    if (mSkipPolicy.skipWithoutReceivers && !hasReceivers()) {
+        mStats.framesUnwatched++;
+        mLastSendNs = 0;
+        return true;
+    }
+
+    // Get the dimensions of the input texture and clip the region to it
+    GLint textureWidth, textureHeight;
     glBindTexture(GL_TEXTURE_2D, textureId);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textureWidth);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textureHeight);
     glBindTexture(GL_TEXTURE_2D, 0);
+    if (width < 0) width = textureWidth - x;
+    if (height < 0) height = textureHeight - y;
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+        x + width > textureWidth || y + height > textureHeight) {
+        std::cerr << "NDI send region outside the texture" << std::endl;
+        return false;
+    }
+
+    // The rate controller's rung decides the output size, the GPU downscales
+    int outWidth = rung.scale < 1.0f ? scaledSize(width, rung.scale) : width;
+    int outHeight = rung.scale < 1.0f ? scaledSize(height, rung.scale) : height;
 
     // Resize if needed
-    if (width != mHardwareCtx.width || height != mHardwareCtx.height) {
-        if (!resizeHardwareContext(width, height)) {
+    if (outWidth != mHardwareCtx.width || outHeight != mHardwareCtx.height) {
+        if (!resizeHardwareContext(outWidth, outHeight)) {
             return false;
         }
     }
 
-    // Save current FBO binding
-    GLint previousFBO;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFBO);
+    int64_t start = steadyNs();
+
+    // Save current FBO bindings
+    GLint previousDrawFBO, previousReadFBO;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDrawFBO);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFBO);
+
+    // Blit the source texture into the persistent shared texture, scaling if needed
+    {
+        FrameProfiler::Scope scope(mProfiler, "ndi blit");
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, mHardwareCtx.sourceFBO);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_TEXTURE_2D, textureId, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mHardwareCtx.copyFBO);
+        glBlitFramebuffer(x, y, x + width, y + height,
+                         0, 0, outWidth, outHeight,
+                         GL_COLOR_BUFFER_BIT, outWidth == width && outHeight == height ? GL_NEAREST : GL_LINEAR);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    }
 
-    // Copy the texture using the persistent FBO
-    glBindFramebuffer(GL_FRAMEBUFFER, mHardwareCtx.copyFBO);
-    
-    // Bind source texture
-    glBindTexture(GL_TEXTURE_2D, textureId);
-    
-    // Copy using a blit operation for potentially better performance
-    glBlitFramebuffer(0, 0, width, height,
-                     0, 0, width, height,
-                     GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    // Unchanged content: skip readback and send, except for a periodic heartbeat
+    if (mSkipPolicy.skipUnchanged) {
+        uint64_t signature = frameSignature();
+        bool unchanged = mSignatureValid && signature == mSignature;
+        mSignature = signature;
+        mSignatureValid = true;
+        int64_t heartbeatNs = (int64_t)(mSkipPolicy.heartbeatSeconds * 1e9);
+        bool heartbeat = heartbeatNs > 0 && steadyNs() - mLastTransmitNs >= heartbeatNs;
+        if (unchanged && !heartbeat) {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDrawFBO);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFBO);
+            mStats.framesUnchanged++;
+            mLastSendNs = 0;
+            return true;
+        }
+        if (unchanged) {
+            mStats.framesHeartbeat++;
+            mLastSendNs = 0;
+        }
+    }
 
     // Read the pixel data from the GPU texture to CPU memory
     // This is the critical fix: NDI requires CPU-accessible pixel data,
     // so we must transfer from GPU to CPU after rendering
-    glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, mHardwareCtx.pPixelData);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mHardwareCtx.copyFBO);
+    {
+        FrameProfiler::Scope scope(mProfiler, "ndi readback");
+        if (Format::direct) {
+            glPixelStorei(GL_PACK_ROW_LENGTH, NDIFormat::rowLength<Format>(lineStrideFor(outWidth)));
+            glReadPixels(0, 0, outWidth, outHeight, Format::glFormat, Format::glType, mHardwareCtx.pPixelData);
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+        } else {
+            // YUV formats are packed on the CPU from an RGBA readback
+            mReadback.resize((size_t)outWidth * outHeight * 4);
+            glReadPixels(0, 0, outWidth, outHeight, GL_RGBA, GL_UNSIGNED_BYTE, mReadback.data());
+            Format::fromRGBA(mReadback.data(), outWidth, outHeight,
+                             mHardwareCtx.pPixelData, lineStrideFor(outWidth));
+        }
+    }
 
     // Restore previous state
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, previousFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDrawFBO);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFBO);
+
+    int64_t readbackEnd = steadyNs();
 
     // Send the frame via NDI
     // Now p_data points to valid CPU pixel data instead of a texture ID
+    {
+        FrameProfiler::Scope scope(mProfiler, "ndi send");
+        transmit();
+    }
+
+    int64_t sendEnd = steadyNs();
+    mStats.framesSent++;
+    updateRate((readbackEnd - start) / 1e6, (sendEnd - readbackEnd) / 1e6, width, height, sendEnd);
+
+    return true;
+}
+
+template <class Format>
+void BasicNDISender<Format>::frameParams(const NDIFrameParams& params) {
+    if (params.empty()) {
+        mParamsXml[0] = '\0';
+    } else if (params.toXml(mParamsXml, sizeof(mParamsXml)) == 0) {
+        std::cerr << "NDI frame params do not fit in " << sizeof(mParamsXml) << " bytes" << std::endl;
+    }
+}
+
+template <class Format>
+const char* BasicNDISender<Format>::frameMetadata() {
+    if (!mParamsXml[0]) return nullptr;
+    // The previous asynchronous frame may still be reading the other buffer
+    char* metadata = mMetadata[mMetadataIndex];
+    mMetadataIndex ^= 1;
+    memcpy(metadata, mParamsXml, strlen(mParamsXml) + 1);
+    return metadata;
+}
+
+template <class Format>
+void BasicNDISender<Format>::transmit() {
+    mHardwareCtx.videoFrame.p_metadata = frameMetadata();
     NDIlib_send_send_video_v2(mSender, &mHardwareCtx.videoFrame);
+    mLastTransmitNs = steadyNs();
+    // A synchronous send also releases the previous asynchronous frame
+    completePending();
+}
+
+template <class Format>
+bool BasicNDISender<Format>::send(const uint8_t* data, int width, int height, int lineStride,
+                                  NDIlib_FourCC_video_type_e fourCC, int64_t timecode,
+                                  const Completion& onComplete) {
+    if (!mInitialized || !data || width <= 0 || height <= 0) return false;
+    bool supported = NDIFormat::visitFormat(fourCC, [&](auto traits) {
+        if (lineStride == 0) lineStride = decltype(traits)::lineStride(width);
+    });
+    if (!supported) {
+        std::cerr << "Unsupported NDI video format " << std::hex << (uint32_t)fourCC << std::dec << std::endl;
+        return false;
+    }
 
+    NDIlib_video_frame_v2_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.xres = width;
+    frame.yres = height;
+    frame.FourCC = fourCC;
+    frame.frame_rate_N = mConfig.frameRateN;
+    frame.frame_rate_D = mConfig.frameRateD;
+    frame.picture_aspect_ratio = (float)width / (float)height;
+    frame.frame_format_type = NDIlib_frame_format_type_progressive;
+    frame.timecode = timecode;
+    frame.p_data = const_cast<uint8_t*>(data); // NDI only reads it
+    frame.line_stride_in_bytes = lineStride;
+    frame.p_metadata = frameMetadata();
+
+    int64_t start = steadyNs();
+    NDIlib_send_send_video_async_v2(mSender, &frame);
+    int64_t end = steadyNs();
+
+    // Returning from an asynchronous send releases the previous one
+    completePending();
+    mPendingData = data;
+    mPendingCompletion = onComplete;
+
+    mStats.framesSent++;
+    bool first = mStats.framesSent == 1;
+    smooth(mStats.sendMs, (end - start) / 1e6, first);
+    if (mLastSendNs != 0) {
+        smooth(mStats.intervalMs, (end - mLastSendNs) / 1e6, mIntervalSamples++ == 0);
+    }
+    mLastSendNs = end;
+    mLastTransmitNs = end;
+    mStats.width = width;
+    mStats.height = height;
     return true;
 }
 
+template <class Format>
+bool BasicNDISender<Format>::sendCopy(const uint8_t* data, int width, int height, int lineStride,
+                                      NDIlib_FourCC_video_type_e fourCC, int64_t timecode) {
+    if (!data || width <= 0 || height <= 0) return false;
+    NDIlib_video_frame_v2_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.xres = width;
+    frame.yres = height;
+    frame.FourCC = fourCC;
+    frame.line_stride_in_bytes = lineStride;
+    size_t bytes = NDIFormat::frameBytes(frame);
+    if (bytes == 0) {
+        std::cerr << "Unsupported NDI video format " << std::hex << (uint32_t)fourCC << std::dec << std::endl;
+        return false;
+    }
+
+    // The other buffer may still be in flight, this one was released by the last send
+    std::vector<uint8_t>& copy = mCopyBuffers[mCopyIndex];
+    mCopyIndex ^= 1;
+    copy.assign(data, data + bytes);
+    return send(copy.data(), width, height, lineStride, fourCC, timecode);
+}
+
+template <class Format>
+void BasicNDISender<Format>::flush() {
+    if (!mSender || !mPendingData) return;
+    NDIlib_send_send_video_async_v2(mSender, nullptr);
+    completePending();
+}
+
+template <class Format>
+void BasicNDISender<Format>::completePending() {
+    if (!mPendingData) return;
+    const uint8_t* data = mPendingData;
+    Completion done;
+    done.swap(mPendingCompletion);
+    mPendingData = nullptr;
+    if (done) done(data);
+}
+
+template <class Format>
+bool BasicNDISender<Format>::hasReceivers() {
+    bool watched = NDIlib_send_get_no_connections(mSender, 0) > 0;
+    if (watched && !mWatched) {
+        // A receiver just connected, it needs a full frame
+        mSignatureValid = false;
+    }
+    mWatched = watched;
+    return watched;
+}
+
+template <class Format>
+uint64_t BasicNDISender<Format>::frameSignature() {
+    // Let the GPU average the frame down to a few thousand texels, then hash those
+    int level = 0;
+    int levelWidth = mHardwareCtx.width;
+    int levelHeight = mHardwareCtx.height;
+    while ((levelWidth > mSkipPolicy.signatureSize || levelHeight > mSkipPolicy.signatureSize) &&
+           (levelWidth > 1 || levelHeight > 1)) {
+        levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+        levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+        level++;
+    }
+    mSignatureData.resize((size_t)levelWidth * levelHeight * 4);
+
+    glBindTexture(GL_TEXTURE_2D, mHardwareCtx.sharedTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level); // no smaller levels needed
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, mSignatureData.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < mSignatureData.size(); i++) {
+        hash = (hash ^ mSignatureData[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+template <class Format>
+void BasicNDISender<Format>::updateRate(double readbackMs, double sendMs, int sourceWidth, int sourceHeight, int64_t now) {
+    bool first = mStats.framesSent == 1;
+    smooth(mStats.readbackMs, readbackMs, first);
+    smooth(mStats.sendMs, sendMs, first);
+    // Skipped frames leave mLastSendNs at 0 so idle gaps do not count as falling behind
+    if (mLastSendNs != 0) {
+        smooth(mStats.intervalMs, (now - mLastSendNs) / 1e6, mIntervalSamples++ == 0);
+    }
+    mLastSendNs = now;
+
+    const RateControl& rc = mRateControl;
+    if (!rc.enabled || rc.ladder.size() < 2 || first) return;
+
+    // With clock_video NDI blocks in send to pace the stream, that is not load
+    double costMs = mStats.readbackMs + (mConfig.clockVideo ? 0.0 : mStats.sendMs);
+    const RateRung& rung = rc.ladder[mStats.rung];
+    double framePeriodMs = 1000.0 * mConfig.frameRateD / mConfig.frameRateN;
+    double callIntervalMs = mStats.intervalMs / rung.frameRateDivisor;
+    bool behind = callIntervalMs > framePeriodMs * (1.0 + rc.behindTolerance);
+    bool overloaded = costMs > rc.latencyBudgetMs || behind;
+
+    int next = mStats.rung;
+    if (overloaded) {
+        mHeadroomFrames = 0;
+        if (++mOverloadFrames >= rc.downgradeFrames && mStats.rung + 1 < (int)rc.ladder.size()) {
+            next = mStats.rung + 1;
+        }
+    } else {
+        mOverloadFrames = 0;
+        if (mStats.rung > 0) {
+            // Readback cost grows with the pixel count of the better rung
+            const RateRung& up = rc.ladder[mStats.rung - 1];
+            double predictedMs = costMs * (up.scale * up.scale) / (rung.scale * rung.scale);
+            bool headroom = predictedMs < rc.latencyBudgetMs * rc.upgradeHeadroom &&
+                            callIntervalMs <= framePeriodMs * (1.0 + rc.behindTolerance * 0.5);
+            mHeadroomFrames = headroom ? mHeadroomFrames + 1 : 0;
+            if (mHeadroomFrames >= rc.upgradeFrames) {
+                next = mStats.rung - 1;
+            }
+        }
+    }
+
+    if (next == mStats.rung || now - mLastSwitchNs < (int64_t)(rc.minDwellSeconds * 1e9)) return;
+
+    RateSwitch change;
+    change.timeSeconds = (now - mInitNs) / 1e9;
+    change.fromRung = mStats.rung;
+    change.toRung = next;
+    change.width = scaledSize(sourceWidth, rc.ladder[next].scale);
+    change.height = scaledSize(sourceHeight, rc.ladder[next].scale);
+    change.frameRateDivisor = rc.ladder[next].frameRateDivisor;
+    change.readbackMs = mStats.readbackMs;
+    change.sendMs = mStats.sendMs;
+    change.intervalMs = mStats.intervalMs;
+    if (mStats.switches.size() >= kMaxSwitchHistory) {
+        mStats.switches.erase(mStats.switches.begin());
+    }
+    mStats.switches.push_back(change);
+    mStats.switchCount++;
+
+    std::cout << "NDI sender rate " << (next > mStats.rung ? "down" : "up") << ": "
+              << change.width << "x" << change.height << " @ 1/" << change.frameRateDivisor
+              << " rate (readback " << change.readbackMs << " ms, interval " << change.intervalMs
+              << " ms)" << std::endl;
+
+    mStats.rung = next;
+    mOverloadFrames = 0;
+    mHeadroomFrames = 0;
+    mIntervalSamples = 0; // the frame rate divisor may have changed
+    mLastSwitchNs = now;
+    setFrameRate(change.frameRateDivisor);
+}
+
 // bool NDISender::sendDirect(FBO& fbo) {
 //     return sendDirect(fbo.tex());
 // }
 
-bool NDISender::sendDirect(Texture& tex) {
+template <class Format>
+bool BasicNDISender<Format>::sendDirect(Texture& tex) {
     return sendDirect(tex.id());
 }
 
-} // namespace al
\ No newline at end of file
+template class BasicNDISender<NDIFormat::BGRA>;
+template class BasicNDISender<NDIFormat::RGBA>;
+template class BasicNDISender<NDIFormat::UYVY>;
+template class BasicNDISender<NDIFormat::UYVA>;
+template class BasicNDISender<NDIFormat::P216>;
+template class BasicNDISender<NDIFormat::PA16>;
+template class BasicNDISender<NDIFormat::I420>;
+
+} // namespace al
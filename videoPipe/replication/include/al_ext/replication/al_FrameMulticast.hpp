@@ -0,0 +1,300 @@
+#ifndef INCLUDE_AL_FRAME_MULTICAST_HPP
+#define INCLUDE_AL_FRAME_MULTICAST_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "al_ext/replication/al_FrameProtocol.hpp"
+#include "al_ext/replication/al_ThreadPlacement.hpp"
+
+// Video frame replication over UDP multicast (or broadcast).
+// The primary sends each frame once to the group, split into
+// sequence-numbered chunks; replicas reassemble and request missing chunks
+// with NACKs, which the primary answers with multicast retransmissions.
+// Primary egress therefore does not depend on the number of replicas.
+// Optional XOR parity (FEC) lets replicas rebuild isolated losses without
+// waiting for a retransmission round-trip.
+//
+// Every sender picks a random session id when it starts. Chunks of a new
+// session, or from a new address, make replicas drop what they had, so a
+// restarted primary is followed even though its generations start again.
+//
+// On Linux datagrams are sent and received in batches (sendmmsg/recvmmsg),
+// one syscall per batch, and equal-sized datagrams are handed to the kernel
+// as one UDP GSO send where the path allows it. Other platforms send and
+// receive one datagram per call.
+
+namespace al {
+
+class FrameMulticastSender {
+public:
+    struct Config {
+        Config()
+            : group("239.255.42.99"), port(16001), interfaceAddress("0.0.0.0")
+            , ttl(1), chunkBytes(8000), historyFrames(3), resendHoldoffMs(5)
+            , fecOverhead(0.0f), batchSize(64), segmentationOffload(true) {}
+        std::string group;            // multicast group, or a broadcast address
+        uint16_t port;
+        std::string interfaceAddress; // "127.0.0.1" to test on a single host
+        int ttl;
+        size_t chunkBytes;            // payload bytes per datagram, see chunkBytesForMtu()
+        int historyFrames;            // frames kept for NACK retransmission
+        int resendHoldoffMs;          // ignore NACKs for chunks sent this recently
+        float fecOverhead;            // parity chunks per data chunk, 0 disables FEC
+        int batchSize;                // datagrams per sendmmsg, 1 sends them one at a time
+        bool segmentationOffload;     // UDP GSO; needs datagrams within the path MTU, turns
+                                      // itself off if the kernel or route refuses it
+        ThreadPlacement placement;    // applied by the send thread when it starts
+    };
+
+    struct Stats {
+        uint64_t framesPublished;
+        uint64_t framesSuperseded;    // published before the previous one went out
+        uint64_t chunksSent;
+        uint64_t paritySent;
+        uint64_t bytesSent;
+        uint64_t nacksReceived;
+        uint64_t chunksRetransmitted;
+        uint64_t sendCalls;           // syscalls that sent datagrams
+        int framesPending;            // published, not picked up by the send thread yet (0 or 1)
+    };
+
+    FrameMulticastSender();
+    ~FrameMulticastSender();
+
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Copies the frame and queues it for transmission on the send thread.
+    // If the previous frame has not gone out yet it is replaced. metadata
+    // (at most kMaxFrameMetadataBytes) is delivered with exactly this frame.
+    bool publish(const uint8_t* data, size_t bytes, int width, int height,
+                 uint32_t format, uint32_t generation, int64_t timestampNs = 0,
+                 const uint8_t* metadata = nullptr, size_t metadataBytes = 0);
+
+    bool isInitialized() const { return mInitialized; }
+    Stats stats() const;
+
+private:
+    struct HistorySlot {
+        HistorySlot() : valid(false) {}
+        std::mutex lock;
+        FrameChunkHeader header;
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> parity;
+        std::vector<int64_t> lastSentNs; // per chunk, for NACK holdoff
+        bool valid;
+    };
+
+    void sendLoop();
+    void sendFrame(HistorySlot& slot);
+    void computeParity(HistorySlot& slot);
+    void sendChunk(HistorySlot& slot, uint32_t index, int64_t nowNs);
+    void sendParity(HistorySlot& slot, uint32_t index);
+    // Datagrams are queued with their payload in place and go out when the
+    // batch is full or flushPackets() is called, before the slot is unlocked
+    void queuePacket(const FrameChunkHeader& header, const uint8_t* payload, size_t bytes);
+    void flushPackets();
+    size_t sendBatch(size_t first, size_t count);
+    size_t sendSegmented(size_t first, size_t count);
+    void serviceNacks();
+    HistorySlot& slotFor(uint32_t generation);
+
+    Config mConfig;
+    int mSocket;
+    uint32_t mSession; // FrameChunkHeader::session, chosen in init()
+    int mWakePipe[2];
+    sockaddr_in mGroupAddr;
+    std::unique_ptr<HistorySlot[]> mHistory;
+
+    struct QueuedPacket {
+        FrameChunkHeader header;
+        const uint8_t* payload;
+        size_t bytes;
+    };
+    std::vector<QueuedPacket> mQueue;
+#ifdef __linux__
+    std::vector<mmsghdr> mMessages;
+#endif
+    std::vector<iovec> mIovecs;
+    std::vector<uint8_t> mSegmentBuffer; // GSO: datagrams back to back
+    std::vector<uint8_t> mControl;       // GSO: one UDP_SEGMENT cmsg per message
+    bool mSegmentation;
+    std::atomic<uint32_t> mPendingGeneration;
+    std::atomic<bool> mHasPending;
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    bool mInitialized;
+
+    std::atomic<uint64_t> mFramesPublished;
+    std::atomic<uint64_t> mFramesSuperseded;
+    std::atomic<uint64_t> mChunksSent;
+    std::atomic<uint64_t> mParitySent;
+    std::atomic<uint64_t> mBytesSent;
+    std::atomic<uint64_t> mNacksReceived;
+    std::atomic<uint64_t> mChunksRetransmitted;
+    std::atomic<uint64_t> mSendCalls;
+
+    FrameMulticastSender(const FrameMulticastSender&) = delete;
+    FrameMulticastSender& operator=(const FrameMulticastSender&) = delete;
+};
+
+class FrameMulticastReceiver {
+public:
+    struct Config {
+        Config()
+            : group("239.255.42.99"), port(16001), interfaceAddress("0.0.0.0")
+            , nackDelayMs(3), nackIntervalMs(10), maxNacksPerFrame(8)
+            , frameTimeoutMs(250), maxFrameBytes(256u << 20), dropRate(0.0f), batchSize(32) {}
+        std::string group;
+        uint16_t port;
+        std::string interfaceAddress;
+        int nackDelayMs;      // quiet time on a frame before missing chunks are NACKed
+        int nackIntervalMs;   // minimum time between NACKs for the same frame
+        int maxNacksPerFrame; // give up on a frame after this many NACKs
+        int frameTimeoutMs;   // drop incomplete frames with no traffic for this long
+        size_t maxFrameBytes;
+        float dropRate;       // loss injection for testing: fraction of datagrams discarded
+        int batchSize;        // datagrams per recvmmsg
+        ThreadPlacement placement; // applied by the receive thread when it starts
+    };
+
+    struct Stats {
+        uint64_t framesCompleted;
+        uint64_t framesDropped;   // incomplete frames given up or superseded
+        uint64_t chunksReceived;
+        uint64_t chunksDuplicate;
+        uint64_t chunksRecovered; // rebuilt from FEC parity
+        uint64_t chunksRejected;  // malformed, or laid out unlike the rest of their frame
+        uint64_t chunksInjectedLoss;
+        uint64_t nacksSent;
+        uint64_t chunksRequested;
+        uint64_t receiveCalls;    // syscalls that returned datagrams
+        uint64_t senderChanges;   // primary restarted or replaced; its frames start over
+        int framesAssembling;     // incomplete frames in flight, at most 3
+    };
+
+    // Called on the receive thread with every frame as it completes, in
+    // generation order within a sender session, for consumers that cannot
+    // skip frames (VideoDecoder). The data is only valid during the call.
+    typedef std::function<void(const ReplicatedFrame&)> FrameHandler;
+
+    FrameMulticastReceiver();
+    ~FrameMulticastReceiver();
+
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Returns true and fills frame if a newer complete frame arrived since
+    // the last call. Never blocks on the network.
+    bool latestFrame(ReplicatedFrame& frame);
+
+    // IPv4 address the frames come from, empty until the first datagram;
+    // where a late-joining replica asks for a snapshot
+    std::string senderAddress() const;
+
+    // Set before init()
+    void frameHandler(FrameHandler handler) { mFrameHandler = handler; }
+
+    // Changes Config::dropRate while running, e.g. to inject loss in phases
+    void dropRate(float rate) { mDropRate.store(rate, std::memory_order_relaxed); }
+
+    bool isInitialized() const { return mInitialized; }
+    Stats stats() const;
+
+private:
+    static const int kAssemblySlots = 3;
+
+    struct Assembly {
+        Assembly() : active(false), receivedCount(0), lastChunkNs(0), lastNackNs(0), nackCount(0) {}
+        bool active;
+        FrameChunkHeader header;
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> received;
+        std::vector<uint8_t> parity;
+        std::vector<uint8_t> parityReceived;
+        std::vector<uint32_t> groupReceived; // data chunks received per parity group
+        uint32_t receivedCount;
+        int64_t lastChunkNs;
+        int64_t lastNackNs;
+        int nackCount;
+    };
+
+    void receiveLoop();
+    // Fills the datagram buffers, leaving each length in mIovecs[i].iov_len
+    int receiveBatch();
+    void handleDatagram(const uint8_t* data, size_t length, const sockaddr_in& from, int64_t nowNs);
+    void handleChunk(const FrameChunkHeader& header, const uint8_t* payload,
+                     size_t payloadBytes, const sockaddr_in& from, int64_t nowNs);
+    // Forgets the frames of the previous sender, whose generations mean nothing now
+    void restartSession();
+    void storeChunk(Assembly& assembly, uint32_t index, const uint8_t* payload, size_t bytes);
+    void tryRecover(Assembly& assembly, uint32_t group);
+    Assembly* assemblyFor(const FrameChunkHeader& header);
+    void completeFrame(Assembly& assembly);
+    void serviceNacks(int64_t nowNs);
+    void sendNack(Assembly& assembly, int64_t nowNs);
+
+    Config mConfig;
+    int mSocket;
+    Assembly mAssembly[kAssemblySlots];
+    sockaddr_in mSenderAddr;
+    bool mHaveSender;
+    uint32_t mSession;               // of mSenderAddr
+    std::atomic<uint32_t> mSenderIp; // mSenderAddr for other threads, network order
+    bool mHaveCompleted;
+    uint32_t mCompletedGeneration;
+    std::vector<uint8_t> mPacket;      // batchSize datagram buffers
+#ifdef __linux__
+    std::vector<mmsghdr> mMessages;
+#endif
+    std::vector<iovec> mIovecs;
+    std::vector<sockaddr_in> mFrom;
+    std::minstd_rand mLossRandom;
+    std::atomic<float> mDropRate;
+    FrameHandler mFrameHandler;
+
+    // Completed frames are handed to the render thread by swapping buffers
+    std::mutex mFrameLock;
+    std::vector<uint8_t> mReady;
+    std::vector<uint8_t> mFront;
+    FrameChunkHeader mReadyHeader;
+    FrameChunkHeader mFrontHeader;
+    bool mReadyIsNew;
+    int64_t mReadyReceivedNs;
+    int64_t mFrontReceivedNs;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    bool mInitialized;
+
+    std::atomic<uint64_t> mFramesCompleted;
+    std::atomic<uint64_t> mFramesDropped;
+    std::atomic<uint64_t> mChunksReceived;
+    std::atomic<uint64_t> mChunksDuplicate;
+    std::atomic<uint64_t> mChunksRecovered;
+    std::atomic<uint64_t> mChunksRejected;
+    std::atomic<uint64_t> mChunksInjectedLoss;
+    std::atomic<uint64_t> mNacksSent;
+    std::atomic<uint64_t> mChunksRequested;
+    std::atomic<uint64_t> mReceiveCalls;
+    std::atomic<uint64_t> mSenderChanges;
+    std::atomic<int> mFramesAssembling;
+
+    FrameMulticastReceiver(const FrameMulticastReceiver&) = delete;
+    FrameMulticastReceiver& operator=(const FrameMulticastReceiver&) = delete;
+};
+
+} // namespace al
+
+#endif
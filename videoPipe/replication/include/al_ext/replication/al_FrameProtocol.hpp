@@ -0,0 +1,154 @@
+#ifndef INCLUDE_AL_FRAME_PROTOCOL_HPP
+#define INCLUDE_AL_FRAME_PROTOCOL_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Wire format shared by the video replication transports.
+// Fields are sent in host byte order; the cluster is assumed homogeneous
+// (little-endian x86_64 / arm64), the magic check rejects anything else.
+
+namespace al {
+
+static const uint32_t kFrameChunkMagic = 0x52464C41; // "ALFR"
+static const uint32_t kSnapshotMagic = 0x4E534C41;   // "ALSN"
+static const uint8_t kFrameProtocolVersion = 3;
+
+// Largest UDP payload we will ever put on the wire
+static const size_t kMaxDatagramBytes = 65507;
+
+// Per-frame metadata (e.g. NDIFrameParams XML) travels with the pixels it
+// belongs to, after them in the frame payload; larger blocks are refused
+static const size_t kMaxFrameMetadataBytes = 2048;
+
+#pragma pack(push, 1)
+struct FrameChunkHeader {
+    enum Type : uint8_t {
+        DATA = 1,  // one chunk of frame payload
+        NACK = 2,  // replica -> primary, followed by (first, count) ranges
+        PARITY = 3 // XOR of every data chunk i with i % parityCount == chunkIndex
+    };
+
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint16_t flags;
+    uint32_t generation;  // frame generation, increases by one per new frame
+    uint32_t session;     // random per sender start; generations restart with it
+    uint32_t chunkIndex;  // DATA/PARITY: index of this chunk, NACK: number of ranges
+    uint32_t chunkCount;  // number of chunks in the frame
+    uint32_t chunkBytes;  // nominal payload bytes per chunk (last may be short)
+    uint32_t frameBytes;  // total payload bytes in the frame, metadata included
+    uint32_t metadataBytes; // trailing payload bytes that are frame metadata
+    uint32_t parityCount; // FEC parity chunks sent after the data, 0 if disabled
+    // Frame description is repeated in every chunk so any chunk can open a frame
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;      // ReplicatedFrame::Format
+    int64_t timestampNs;  // frameClockNs() on the primary at publish time
+};
+
+struct FrameNackRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+// Late-join snapshot over TCP: the replica sends one header with only magic
+// and version set, the primary answers with a header followed by stateBytes
+// of control state and frameBytes of frame payload, then closes
+struct SnapshotHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t reserved[3];
+    uint32_t generation;  // 0 if the primary has no frame yet
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;      // ReplicatedFrame::Format
+    uint32_t frameBytes;  // metadata included
+    uint32_t metadataBytes;
+    uint32_t stateBytes;
+    int64_t timestampNs;  // publish time of the frame on the primary
+};
+#pragma pack(pop)
+
+// Complete frame as handed out by a replication receiver. The data pointer
+// is owned by the receiver and stays valid until the next call that
+// returns a frame.
+struct ReplicatedFrame {
+    enum Format : uint32_t {
+        RGBA8 = 1,
+        BC1 = 2,   // DXT1 blocks, see al_TextureCompression.hpp
+        VIDEO = 3  // one VideoEncoder packet, see al_VideoCodec.hpp
+    };
+
+    ReplicatedFrame()
+        : data(nullptr), bytes(0), metadata(nullptr), metadataBytes(0), width(0), height(0)
+        , format(RGBA8), generation(0), timestampNs(0), receivedNs(0) {}
+
+    const uint8_t* data;
+    size_t bytes;
+    const uint8_t* metadata; // published with this frame, nullptr if none
+    size_t metadataBytes;
+    int width;
+    int height;
+    uint32_t format;
+    uint32_t generation;
+    int64_t timestampNs;  // publish time on the primary
+    int64_t receivedNs;   // time the frame became complete on this node
+};
+
+// Wall clock in nanoseconds used for frame timestamps. Comparing stamps
+// across hosts requires the nodes to be NTP/PTP synchronised.
+int64_t frameClockNs();
+
+// Monotonic clock in nanoseconds for intervals and deadlines on this node.
+// Unlike frameClockNs it never steps, and it means nothing on another host.
+int64_t steadyClockNs();
+
+// True if generation a is newer than b, tolerant to wrap-around
+inline bool generationNewer(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) > 0;
+}
+
+// Largest chunk whose datagram fits an MTU without IP fragmentation, e.g.
+// 1420 for 1500-byte Ethernet or 8920 for 9000-byte jumbo frames (20 bytes
+// IPv4 + 8 UDP). Needed for segmentation offload; larger chunks fragment.
+inline size_t chunkBytesForMtu(int mtu) {
+    return (size_t)mtu - 28 - sizeof(FrameChunkHeader);
+}
+
+inline uint32_t chunkCountFor(size_t frameBytes, size_t chunkBytes) {
+    return (uint32_t)((frameBytes + chunkBytes - 1) / chunkBytes);
+}
+
+// Number of parity chunks for an overhead ratio, e.g. 0.05 adds 5% traffic
+inline uint32_t parityCountFor(uint32_t chunkCount, float overhead) {
+    if (overhead <= 0.0f || chunkCount == 0) return 0;
+    uint32_t count = (uint32_t)(chunkCount * overhead + 0.999f);
+    if (count < 1) count = 1;
+    return count < chunkCount ? count : chunkCount;
+}
+
+// Data chunks covered by parity chunk `group` (stride interleaved, so a
+// burst of consecutive losses lands in different groups)
+inline uint32_t parityGroupSize(uint32_t chunkCount, uint32_t parityCount, uint32_t group) {
+    return (chunkCount - group + parityCount - 1) / parityCount;
+}
+
+inline size_t chunkPayloadBytes(const FrameChunkHeader& h, uint32_t index) {
+    size_t offset = (size_t)index * h.chunkBytes;
+    size_t remaining = h.frameBytes - offset;
+    return remaining < h.chunkBytes ? remaining : h.chunkBytes;
+}
+
+inline void xorInto(uint8_t* dst, const uint8_t* src, size_t bytes) {
+    size_t words = bytes / sizeof(uint64_t);
+    uint64_t* d = (uint64_t*)dst;
+    const uint64_t* s = (const uint64_t*)src;
+    for (size_t i = 0; i < words; i++) d[i] ^= s[i];
+    for (size_t i = words * sizeof(uint64_t); i < bytes; i++) dst[i] ^= src[i];
+}
+
+} // namespace al
+
+#endif
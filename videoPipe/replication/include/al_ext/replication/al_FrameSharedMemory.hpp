@@ -0,0 +1,145 @@
+#ifndef INCLUDE_AL_FRAME_SHARED_MEMORY_HPP
+#define INCLUDE_AL_FRAME_SHARED_MEMORY_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "al_ext/replication/al_FrameProtocol.hpp"
+
+// Same-host video replication through a POSIX shared-memory ring. The
+// primary writes each frame once into a free slot (glGetTexImage can read
+// back straight into it); replicas on the same machine, e.g. one per GPU,
+// map the ring and upload from the shared pages without any copy or
+// network round-trip. Remote replicas cannot open the ring and keep using
+// the network transport.
+//
+// Slots carry a version counter that is odd while the slot is written.
+// A reader pins the slot it hands out until its next call, and the writer
+// skips pinned slots; only when every other slot is pinned (readers
+// stalled or crashed) does it overwrite one, which the reader detects
+// and counts as torn. The writer stamps a heartbeat on every frame, so a
+// ring left behind by a primary that is gone reads as unavailable.
+
+namespace al {
+
+struct SharedFrameRingHeader;
+struct SharedFrameSlot;
+
+class SharedFrameWriter {
+public:
+    struct Config {
+        Config() : name("/al_frames_16001"), slotCount(4), maxFrameBytes(4096u * 2048u * 4u) {}
+        std::string name;     // shm_open name, one ring per stream
+        int slotCount;        // 2 + the number of local replicas, at most 64
+        size_t maxFrameBytes; // per slot; pages are only committed once written
+    };
+
+    struct Stats {
+        uint64_t framesPublished;
+        uint64_t slotsOverwritten; // pinned slot reused because none was free
+        uint64_t framesTooLarge;
+    };
+
+    SharedFrameWriter();
+    ~SharedFrameWriter();
+
+    bool init(const Config& config = Config());
+    // Unlinks the ring; mapped readers see the heartbeat stop
+    void shutdown();
+
+    // Two-step publish for writing in place: beginFrame returns a slot of
+    // at least bytes to fill (nullptr if the frame is too large), and
+    // commitFrame makes it the newest frame, together with its metadata
+    // (at most kMaxFrameMetadataBytes, copied into the slot header)
+    uint8_t* beginFrame(size_t bytes);
+    void commitFrame(int width, int height, uint32_t format, uint32_t generation,
+                     int64_t timestampNs = 0,
+                     const uint8_t* metadata = nullptr, size_t metadataBytes = 0);
+
+    // Copies a frame into the ring
+    bool publish(const uint8_t* data, size_t bytes, int width, int height,
+                 uint32_t format, uint32_t generation, int64_t timestampNs = 0,
+                 const uint8_t* metadata = nullptr, size_t metadataBytes = 0);
+
+    // Marks the writer alive without a new frame, e.g. once per onAnimate
+    // while the video is paused
+    void heartbeat();
+
+    bool isInitialized() const { return mRing != nullptr; }
+    Stats stats() const { return mStats; }
+
+private:
+    SharedFrameSlot* slot(int index);
+
+    Config mConfig;
+    int mFd;
+    SharedFrameRingHeader* mRing;
+    size_t mMappedBytes;
+    int mWriting;      // slot between beginFrame and commitFrame, -1 if none
+    size_t mWritingBytes;
+    uint64_t mSequence;
+    Stats mStats;
+
+    SharedFrameWriter(const SharedFrameWriter&) = delete;
+    SharedFrameWriter& operator=(const SharedFrameWriter&) = delete;
+};
+
+class SharedFrameReader {
+public:
+    struct Config {
+        Config() : name("/al_frames_16001"), staleMs(1000), retryMs(500) {}
+        std::string name;
+        int staleMs; // heartbeat age after which the writer counts as gone
+        int retryMs; // interval between attempts to (re)open the ring
+    };
+
+    struct Stats {
+        uint64_t framesRead;
+        uint64_t framesTorn; // overwritten while pinned, see above
+        uint64_t reattaches;
+    };
+
+    SharedFrameReader();
+    ~SharedFrameReader();
+
+    // Opens the ring if it exists; returns false (and retries in
+    // latestFrame) if no primary on this host is writing one
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Returns true and fills frame if a newer frame was committed since the
+    // last call. frame.data points into shared memory and stays valid until
+    // the next call. Never blocks.
+    bool latestFrame(ReplicatedFrame& frame);
+
+    // The ring exists and its writer is alive; when false, fall back to the
+    // network transport
+    bool isAvailable();
+    Stats stats() const { return mStats; }
+
+private:
+    bool attach();
+    void detach();
+    void release();
+    SharedFrameSlot* slot(int index);
+
+    Config mConfig;
+    int mFd;
+    SharedFrameRingHeader* mRing;
+    size_t mMappedBytes;
+    int mPinned;         // slot handed out by the last latestFrame, -1 if none
+    uint64_t mPinnedSequence;
+    uint64_t mLastSequence;
+    int64_t mNextAttachNs;
+    Stats mStats;
+
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+};
+
+} // namespace al
+
+#endif
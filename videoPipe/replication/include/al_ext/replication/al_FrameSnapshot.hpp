@@ -0,0 +1,142 @@
+#ifndef INCLUDE_AL_FRAME_SNAPSHOT_HPP
+#define INCLUDE_AL_FRAME_SNAPSHOT_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "al_ext/replication/al_FrameProtocol.hpp"
+#include "al_ext/replication/al_ThreadPlacement.hpp"
+
+// Late join for replicas. The primary keeps the latest complete frame and
+// control state and serves them over TCP on request, so a replica started
+// or restarted mid-show shows a correct frame one round-trip (plus one
+// bulk transfer) after it asks, instead of waiting to assemble a frame from
+// the multicast stream. Once it has the snapshot the replica carries on
+// with the regular stream; frames of a newer generation replace it.
+//
+// The server answers one request at a time on its own thread, so replicas
+// joining together are served back to back.
+
+namespace al {
+
+class FrameSnapshotServer {
+public:
+    struct Config {
+        Config() : port(16002), interfaceAddress("0.0.0.0"), sendTimeoutMs(2000) {}
+        uint16_t port;
+        std::string interfaceAddress; // address to listen on
+        int sendTimeoutMs;            // give up on a replica that stops reading
+        ThreadPlacement placement;    // applied by the server thread when it starts
+    };
+
+    struct Stats {
+        uint64_t snapshotsServed;
+        uint64_t requestsFailed; // bad request or the replica went away
+        uint64_t bytesServed;
+    };
+
+    FrameSnapshotServer();
+    ~FrameSnapshotServer();
+
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Copies the frame, and its metadata, as the one to hand to joining replicas
+    void updateFrame(const uint8_t* data, size_t bytes, int width, int height,
+                     uint32_t format, uint32_t generation, int64_t timestampNs = 0,
+                     const uint8_t* metadata = nullptr, size_t metadataBytes = 0);
+    // Copies the control state sent along with the frame
+    void updateState(const void* state, size_t bytes);
+
+    bool isInitialized() const { return mInitialized; }
+    Stats stats() const;
+
+private:
+    struct FrameBuffer {
+        SnapshotHeader header;
+        std::vector<uint8_t> data;
+    };
+    typedef std::vector<uint8_t> StateBuffer;
+
+    void serveLoop();
+    void serve(int client);
+
+    Config mConfig;
+    int mSocket;
+
+    // Double buffered: updates fill the spare and swap it in, so a snapshot
+    // the server thread holds is never written. A spare still held by the
+    // server is replaced by a fresh allocation.
+    std::mutex mLock;
+    std::shared_ptr<FrameBuffer> mFrame;
+    std::shared_ptr<FrameBuffer> mSpareFrame;
+    std::shared_ptr<StateBuffer> mState;
+    std::shared_ptr<StateBuffer> mSpareState;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    bool mInitialized;
+
+    std::atomic<uint64_t> mSnapshotsServed;
+    std::atomic<uint64_t> mRequestsFailed;
+    std::atomic<uint64_t> mBytesServed;
+
+    FrameSnapshotServer(const FrameSnapshotServer&) = delete;
+    FrameSnapshotServer& operator=(const FrameSnapshotServer&) = delete;
+};
+
+class FrameSnapshotClient {
+public:
+    struct Config {
+        Config() : host("127.0.0.1"), port(16002), timeoutMs(2000), retryMs(250), maxFrameBytes(256u << 20) {}
+        std::string host;     // the primary
+        uint16_t port;
+        int timeoutMs;        // per attempt, connect to last byte
+        int retryMs;          // wait between attempts until one succeeds
+        size_t maxFrameBytes;
+    };
+
+    FrameSnapshotClient();
+    ~FrameSnapshotClient();
+
+    // Starts fetching a snapshot in the background, retrying until one
+    // with a frame arrives or shutdown() is called
+    bool request(const Config& config = Config());
+    void shutdown();
+
+    // Returns true once, when the snapshot has arrived; the frame and
+    // state() stay valid until the next request()
+    bool latestFrame(ReplicatedFrame& frame);
+    const std::vector<uint8_t>& state() const { return mState; }
+
+    bool isPending() const { return mRunning && !mReady; }
+    // request() to snapshot received, in milliseconds
+    double fetchMs() const { return mFetchMs; }
+
+private:
+    void fetchLoop();
+    bool fetch();
+
+    Config mConfig;
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    std::atomic<bool> mReady; // snapshot complete, buffers no longer written
+    bool mDelivered;
+    SnapshotHeader mHeader;
+    std::vector<uint8_t> mState;
+    std::vector<uint8_t> mFrame;
+    int64_t mRequestNs;
+    int64_t mReceivedNs;
+    double mFetchMs;
+
+    FrameSnapshotClient(const FrameSnapshotClient&) = delete;
+    FrameSnapshotClient& operator=(const FrameSnapshotClient&) = delete;
+};
+
+} // namespace al
+
+#endif
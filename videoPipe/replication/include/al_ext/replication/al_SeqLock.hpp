@@ -0,0 +1,77 @@
+#ifndef INCLUDE_AL_SEQ_LOCK_HPP
+#define INCLUDE_AL_SEQ_LOCK_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+namespace al {
+
+// Hands a small value from one writer thread to any number of reader
+// threads without locks, e.g. the control part of the app state from the
+// simulation to the audio callback. Neither side ever waits for the other:
+// store() always completes, and load() gives up after a few attempts if
+// the writer keeps overwriting the value, leaving the caller's previous
+// copy in place. Meant for a few dozen bytes; copy large data elsewhere.
+//
+// The value is kept in relaxed atomic words between two reads of a
+// sequence counter (odd while a store is in progress), so a torn copy is
+// detected and discarded rather than being a data race.
+template <class T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock values are copied bytewise");
+
+public:
+    // Attempts load() makes before reporting the value as busy
+    static const int kMaxAttempts = 16;
+
+    SeqLock() : mSequence(0) {
+        for (std::atomic<uint64_t>& word : mWords) word.store(0, std::memory_order_relaxed);
+    }
+
+    // Single writer; never blocks
+    void store(const T& value) {
+        uint64_t words[kWordCount] = {};
+        memcpy(words, &value, sizeof(T));
+        uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < kWordCount; i++) mWords[i].store(words[i], std::memory_order_relaxed);
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Copies the latest value into value and returns true; returns false,
+    // leaving value unchanged, if every attempt overlapped a store
+    bool load(T& value) const {
+        for (int attempt = 0; attempt < kMaxAttempts; attempt++) {
+            uint32_t before = mSequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            uint64_t words[kWordCount];
+            for (int i = 0; i < kWordCount; i++) words[i] = mWords[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mSequence.load(std::memory_order_relaxed) == before) {
+                memcpy(&value, words, sizeof(T));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Number of completed stores, 0 before the first
+    uint32_t version() const { return mSequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    static const int kWordCount = (int)((sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+
+    std::atomic<uint32_t> mSequence;
+    std::atomic<uint64_t> mWords[kWordCount];
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+};
+
+} // namespace al
+
+#endif
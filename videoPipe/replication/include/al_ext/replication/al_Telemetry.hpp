@@ -0,0 +1,194 @@
+#ifndef INCLUDE_AL_TELEMETRY_HPP
+#define INCLUDE_AL_TELEMETRY_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "al_ext/replication/al_SeqLock.hpp"
+#include "al_ext/replication/al_ThreadPlacement.hpp"
+
+// Pipeline health of every node, so a stall on one of many replicas shows
+// up on the primary instead of needing an SSH session per machine.
+//
+// Each node hands its latest numbers to a TelemetryPublisher, which sends
+// them as one OSC message (/al/telemetry, see kTelemetryAddress) a few
+// times a second from its own thread. The render thread only copies the
+// sample under a sequence counter: no lock, no allocation, no syscall.
+// The primary runs a TelemetryAggregator that keeps the last message of
+// every node and flags nodes that stall, fall behind or drop frames. The
+// messages are plain OSC, so any OSC monitor can listen in as well.
+
+namespace al {
+
+// OSC address and type tags of a telemetry message:
+// node name, role, sequence, fps, frame generation, upload ms, lag ms,
+// frames dropped, send queue, receive queue
+static const char* const kTelemetryAddress = "/al/telemetry";
+static const char* const kTelemetryTypeTags = ",siififfiii";
+
+struct TelemetrySample {
+    enum Role : int32_t { PRIMARY = 0, REPLICA = 1 };
+
+    TelemetrySample()
+        : role(REPLICA), fps(0.0f), frameGeneration(0), uploadMs(0.0f), replicationLagMs(0.0f)
+        , framesDropped(0), sendQueue(0), receiveQueue(0) {}
+
+    int32_t role;
+    float fps;                // rendered frames per second
+    uint32_t frameGeneration; // newest frame shown (replica) or published (primary)
+    float uploadMs;           // replica texture upload, primary readback
+    float replicationLagMs;   // primary publish to shown here; needs synchronised clocks
+    uint32_t framesDropped;   // replica: incomplete frames given up, primary: superseded
+    int32_t sendQueue;        // frames waiting for the send thread
+    int32_t receiveQueue;     // incomplete frames being reassembled
+};
+
+class TelemetryPublisher {
+public:
+    struct Config {
+        Config() : host("127.0.0.1"), port(16003), intervalMs(250) {}
+        std::string host;          // the aggregator, usually the primary
+        uint16_t port;
+        std::string nodeName;      // empty = hostname:pid
+        int intervalMs;            // between messages
+        ThreadPlacement placement; // applied by the publish thread when it starts
+    };
+
+    TelemetryPublisher();
+    ~TelemetryPublisher();
+
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Latest numbers, from any one thread (the render thread). Wait-free and
+    // allocation-free; only the newest sample per interval is sent.
+    void update(const TelemetrySample& sample);
+
+    // Changes the aggregator address, e.g. once a replica learns where the
+    // primary is. Returns false if host is not an IPv4 address.
+    bool destination(const std::string& host);
+
+    bool isInitialized() const { return mInitialized; }
+    uint64_t messagesSent() const { return mMessagesSent; }
+
+private:
+    void publishLoop();
+    bool readSample(TelemetrySample& sample);
+
+    Config mConfig;
+    int mSocket;
+    std::atomic<uint32_t> mDestination; // IPv4, network order
+    char mNodeName[32];
+
+    SeqLock<TelemetrySample> mSample;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    bool mInitialized;
+    std::atomic<uint64_t> mMessagesSent;
+
+    TelemetryPublisher(const TelemetryPublisher&) = delete;
+    TelemetryPublisher& operator=(const TelemetryPublisher&) = delete;
+};
+
+class TelemetryAggregator {
+public:
+    struct Config {
+        Config()
+            : port(16003), interfaceAddress("0.0.0.0"), maxNodes(64)
+            , staleMs(2000), minFps(30.0f), maxLagMs(100.0f) {}
+        uint16_t port;
+        std::string interfaceAddress;
+        int maxNodes;              // further nodes are ignored
+        int staleMs;               // silence after which a node counts as stalled
+        float minFps;              // below this a node counts as slow
+        float maxLagMs;            // above this a node counts as lagging
+        ThreadPlacement placement; // applied by the receive thread when it starts
+    };
+
+    enum Health {
+        OK,
+        DROPPING, // frames dropped since its previous message
+        LAGGING,  // replicationLagMs above maxLagMs
+        SLOW,     // fps below minFps
+        STALE     // no message for staleMs
+    };
+
+    struct NodeStatus {
+        std::string name;
+        std::string address;
+        TelemetrySample sample;
+        double ageMs;         // since its last message
+        uint64_t messages;
+        uint64_t messagesLost; // gaps in its sequence numbers
+        Health health;        // worst condition that applies
+    };
+
+    struct Stats {
+        uint64_t messagesReceived;
+        uint64_t messagesMalformed;
+        uint64_t nodesIgnored; // over maxNodes
+    };
+
+    static const char* healthName(Health health);
+
+    TelemetryAggregator();
+    ~TelemetryAggregator();
+
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Every node heard from, in order of first contact
+    std::vector<NodeStatus> nodes() const;
+    // Number of nodes whose health is not OK
+    int unhealthyCount() const;
+    // One line per node
+    std::string report() const;
+
+    bool isInitialized() const { return mInitialized; }
+    Stats stats() const;
+
+private:
+    struct Node {
+        char name[32];
+        uint32_t address;
+        TelemetrySample sample;
+        uint32_t previousDropped;
+        uint32_t lastSequence;
+        int64_t lastNs;
+        uint64_t messages;
+        uint64_t messagesLost;
+    };
+
+    void receiveLoop();
+    void handleMessage(const uint8_t* data, size_t length, uint32_t address, int64_t nowNs);
+    Health healthOf(const Node& node, int64_t nowNs) const;
+
+    Config mConfig;
+    int mSocket;
+
+    mutable std::mutex mLock; // guards mNodes and mNodeCount
+    std::vector<Node> mNodes;  // maxNodes, allocated by init()
+    int mNodeCount;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    bool mInitialized;
+
+    std::atomic<uint64_t> mMessagesReceived;
+    std::atomic<uint64_t> mMessagesMalformed;
+    std::atomic<uint64_t> mNodesIgnored;
+
+    TelemetryAggregator(const TelemetryAggregator&) = delete;
+    TelemetryAggregator& operator=(const TelemetryAggregator&) = delete;
+};
+
+} // namespace al
+
+#endif
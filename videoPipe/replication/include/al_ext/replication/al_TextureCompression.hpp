@@ -0,0 +1,93 @@
+#ifndef INCLUDE_AL_TEXTURE_COMPRESSION_HPP
+#define INCLUDE_AL_TEXTURE_COMPRESSION_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "al_ext/replication/al_ThreadPlacement.hpp"
+
+// Real-time BC1 (DXT1) encoding of RGBA8 frames for replication. A BC1
+// frame is 8 bytes per 4x4 block, 1/8 of RGBA8, and is uploaded by the
+// replicas with glCompressedTexSubImage2D (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+// and sampled by the GPU without ever being decompressed. Alpha is dropped.
+//
+// Blocks are laid out row by row, top row first, like the RGBA8 frames, so
+// a BC1 frame can replace a glGetTexImage readback one for one. Widths and
+// heights that are not a multiple of 4 repeat the edge pixels.
+
+namespace al {
+
+inline size_t bc1Bytes(int width, int height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+// Expands BC1 blocks back to RGBA8 (alpha 255), for checking quality or
+// replicas without S3TC support
+void decodeBC1(const uint8_t* blocks, int width, int height, uint8_t* rgba);
+
+class BC1Encoder {
+public:
+    enum Quality {
+        FAST, // bounding-box endpoints, a few ns per pixel
+        HIGH  // principal-axis endpoints refined by least squares, ~3x slower
+    };
+
+    struct Config {
+        Config() : quality(FAST), threads(0), rowsPerTask(4) {}
+        Quality quality;
+        int threads;     // encoding threads including the caller, 0 = one per core
+        int rowsPerTask; // block rows a thread claims at a time
+        ThreadPlacement placement; // applied by the worker threads, not the caller
+    };
+
+    BC1Encoder();
+    ~BC1Encoder();
+
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Encodes tightly packed RGBA8 into dst, which holds bc1Bytes(width,
+    // height). Splits the frame across the worker threads and returns once
+    // every block is written.
+    void encode(const uint8_t* rgba, int width, int height, uint8_t* dst);
+
+    void quality(Quality q) { mConfig.quality = q; }
+    Quality quality() const { return mConfig.quality; }
+    int threads() const { return (int)mWorkers.size() + 1; }
+    double lastEncodeMs() const { return mLastEncodeMs; }
+
+private:
+    void workerLoop();
+    void encodeTasks();
+
+    Config mConfig;
+    std::vector<std::thread> mWorkers;
+    bool mInitialized;
+
+    // Current job, published to the workers under mLock
+    std::mutex mLock;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    uint64_t mJob;
+    int mBusyWorkers;
+    bool mRunning;
+    const uint8_t* mSource;
+    uint8_t* mDest;
+    int mWidth;
+    int mHeight;
+    std::atomic<int> mNextRow;
+    double mLastEncodeMs;
+
+    BC1Encoder(const BC1Encoder&) = delete;
+    BC1Encoder& operator=(const BC1Encoder&) = delete;
+};
+
+} // namespace al
+
+#endif
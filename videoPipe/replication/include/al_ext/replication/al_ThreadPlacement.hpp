@@ -0,0 +1,90 @@
+#ifndef INCLUDE_AL_THREAD_PLACEMENT_HPP
+#define INCLUDE_AL_THREAD_PLACEMENT_HPP
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// CPU affinity, scheduling priority and NUMA placement for the pipeline
+// threads, so render, audio and video I/O on a multi-socket render server
+// stop competing for the same cores.
+//
+// A ThreadPlacement is applied by the thread it describes, when it starts:
+// the transports and encoders take one in their Config, NDIReceiver runs a
+// start hook on its capture thread, and the app applies the render and
+// audio placements from onCreate / the first onSound. A NUMA node also sets
+// the thread's memory policy, so the frame buffers it allocates and first
+// touches afterwards are local to the cores it runs on.
+//
+// Affinity, nice and NUMA policy are Linux only. SCHED_FIFO needs
+// CAP_SYS_NICE or an rtprio limit (/etc/security/limits.conf); failures
+// are reported and the remaining settings are still applied.
+
+namespace al {
+
+struct ThreadPlacement {
+    ThreadPlacement() : fifoPriority(0), nice(0), numaNode(-1) {}
+    std::vector<int> cpus; // allowed CPUs, empty = the NUMA node's CPUs, or any
+    int fifoPriority;      // 1-99 runs SCHED_FIFO at that priority, 0 keeps SCHED_OTHER
+    int nice;              // -20 (highest) to 19, SCHED_OTHER only
+    int numaNode;          // node for CPUs and allocations, -1 = no preference
+
+    bool isDefault() const {
+        return cpus.empty() && fifoPriority == 0 && nice == 0 && numaNode < 0;
+    }
+
+    // Applies the placement to the calling thread and names it (shown by
+    // top -H and debuggers; Linux truncates to 15 characters). Returns
+    // false if any setting could not be applied.
+    bool apply(const char* threadName = nullptr) const;
+};
+
+// Parses a CPU list in the sysfs cpulist format, e.g. "0-3,8,10-11"
+bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+// CPUs of a NUMA node, empty if the node does not exist
+std::vector<int> numaNodeCpus(int node);
+
+// Moves existing pages of [data, data + bytes) to a NUMA node, for buffers
+// allocated before the owning thread's placement was applied
+bool bindToNumaNode(void* data, size_t bytes, int node);
+
+// Placement for every thread role, e.g. from a string kept next to the
+// app's other per-machine settings:
+//
+//   "render:node=0,cpus=0-5; audio:cpus=6,fifo=80; capture:cpus=7,nice=-10;
+//    replication_send:node=0; encode:cpus=8-15,node=1"
+//
+// Keys are cpus, fifo, nice and node; roles not listed keep the default.
+class ThreadPlacementConfig {
+public:
+    enum Role {
+        RENDER,              // app onDraw / onAnimate
+        AUDIO,               // app onSound
+        CAPTURE,             // NDIReceiver capture and reconnect
+        REPLICATION_SEND,    // FrameMulticastSender
+        REPLICATION_RECEIVE, // FrameMulticastReceiver
+        ENCODE,              // BC1Encoder, VideoEncoder and VideoDecoder workers
+        ROLE_COUNT
+    };
+
+    // Lower-case name used by parse() and as the thread name
+    static const char* roleName(Role role);
+
+    ThreadPlacement& operator[](Role role) { return mRoles[role]; }
+    const ThreadPlacement& operator[](Role role) const { return mRoles[role]; }
+
+    // Returns false and leaves the config unchanged on a syntax error
+    bool parse(const std::string& spec);
+
+    // Applies a role's placement to the calling thread
+    bool apply(Role role) const { return mRoles[role].apply(roleName(role)); }
+
+private:
+    ThreadPlacement mRoles[ROLE_COUNT];
+};
+
+} // namespace al
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef INCLUDE_AL_VIDEO_CODEC_HPP
+#define INCLUDE_AL_VIDEO_CODEC_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "al_ext/replication/al_FrameProtocol.hpp"
+#include "al_ext/replication/al_ThreadPlacement.hpp"
+
+// Software video compression for replicating frames over links too slow
+// for RGBA8 (1024x768 at 60 fps is about 190 MB/s, 1 GbE carries 118).
+// H.264, HEVC or MPEG-4 Part 2 through libavcodec, trading bandwidth for
+// CPU: a few MB/s on the wire against a few ms of encode and decode.
+//
+// Both sides are pipelined per frame. VideoEncoder::submit() converts the
+// RGBA8 frame to YUV 4:2:0 on a pool of worker threads and returns; a
+// coding thread compresses it while the next frame converts, and the
+// packet is picked up with receive(). VideoDecoder::submit() queues a
+// packet for its decoding thread, which converts each picture back to
+// RGBA8 on the pool, and latestFrame() hands out the newest one.
+//
+// Packets travel as ReplicatedFrame::VIDEO frames (VideoPacketHeader, then
+// one coded picture). Inter-coded pictures refer to the ones before them,
+// so decoders must see every packet in order (feed them from
+// FrameMulticastReceiver::frameHandler, not latestFrame) and, after a gap,
+// skip to the next keyframe; keyframeInterval bounds that wait and the
+// time a late joiner waits, keyframeInterval 1 codes every frame intra.
+//
+// Compression is only available if libavcodec was found when the library
+// was built (AL_HAVE_LIBAVCODEC); otherwise init() fails and callers keep
+// sending RGBA8 or BC1.
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+namespace al {
+
+static const uint32_t kVideoPacketMagic = 0x44564C41; // "ALVD"
+
+#pragma pack(push, 1)
+struct VideoPacketHeader {
+    enum Flags : uint8_t {
+        KEYFRAME = 1 // decodable without the packets before it
+    };
+
+    uint32_t magic;
+    uint8_t codec;     // VideoEncoder::Codec
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t sequence; // consecutive per coded picture, a gap means a lost reference
+    uint32_t bytes;    // coded picture bytes that follow
+};
+#pragma pack(pop)
+
+// Worker threads that split a frame's rows between them and the caller,
+// like BC1Encoder's; defined in al_VideoCodec.cpp
+class VideoRowPool;
+
+class VideoEncoder {
+public:
+    enum Codec : uint8_t {
+        H264 = 1,
+        HEVC = 2,
+        MPEG4 = 3 // MPEG-4 Part 2, built into every libavcodec
+    };
+
+    struct Config {
+        Config()
+            : codec(H264), bitrateKbps(20000), keyframeInterval(60), frameRate(60)
+            , preset("veryfast"), threads(0), codecThreads(0), pipelineDepth(2) {}
+        Codec codec;
+        int bitrateKbps;      // target rate; 20000 is 2.5 MB/s
+        int keyframeInterval; // frames between keyframes, 1 codes every frame intra
+        int frameRate;        // expected frames per second, for rate control
+        std::string preset;   // speed preset of encoders that have one (x264, x265)
+        int threads;          // colour conversion threads including the caller, 0 = one per core
+        int codecThreads;     // libavcodec slice threads, 0 = automatic
+        int pipelineDepth;    // frames converted but not yet coded; submit() drops beyond it
+        ThreadPlacement placement; // applied by the conversion and coding threads
+    };
+
+    struct Stats {
+        uint64_t framesSubmitted;
+        uint64_t framesEncoded;
+        uint64_t framesDropped; // submitted while the pipeline was full
+        uint64_t keyframes;
+        uint64_t bytesEncoded;  // headers included
+        double convertMs;       // RGBA8 to YUV of the last frame, in submit()
+        double encodeMs;        // libavcodec time of the last frame
+        double latencyMs;       // submit() to packet ready, smoothed
+        double bitrateMbps;     // output over the last second
+    };
+
+    // One coded frame, ready to publish as ReplicatedFrame::VIDEO
+    struct Packet {
+        Packet() : width(0), height(0), generation(0), timestampNs(0), keyframe(false) {}
+        std::vector<uint8_t> data;     // VideoPacketHeader and coded picture
+        std::vector<uint8_t> metadata; // as submitted with the frame
+        int width;
+        int height;
+        uint32_t generation;
+        int64_t timestampNs;           // as submitted
+        bool keyframe;
+    };
+
+    // False if the library was built without libavcodec
+    static bool available();
+
+    VideoEncoder();
+    ~VideoEncoder();
+
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Converts tightly packed RGBA8 and queues it for coding; returns false
+    // and drops the frame if pipelineDepth frames are already waiting.
+    // A frame of a new size restarts the stream with a keyframe.
+    bool submit(const uint8_t* rgba, int width, int height, uint32_t generation,
+                int64_t timestampNs = 0, const uint8_t* metadata = nullptr, size_t metadataBytes = 0);
+
+    // Moves the oldest coded frame into packet; false if none is ready.
+    // Publish at most one per frame: the multicast sender replaces a frame
+    // that has not gone out yet, and a replaced packet costs the replicas
+    // everything up to the next keyframe.
+    bool receive(Packet& packet);
+
+    bool isInitialized() const { return mInitialized; }
+    Stats stats() const;
+
+private:
+    // A frame on its way through the coder
+    struct FrameInfo {
+        FrameInfo() : pts(0), width(0), height(0), generation(0), timestampNs(0), submittedNs(0) {}
+        int64_t pts;
+        int width;
+        int height;
+        uint32_t generation;
+        int64_t timestampNs;
+        int64_t submittedNs;
+        std::vector<uint8_t> metadata;
+    };
+
+    struct Slot {
+        Slot() : frame(nullptr) {}
+        AVFrame* frame; // YUV 4:2:0 planes
+        FrameInfo info;
+    };
+
+    void encodeLoop();
+    bool openCodec(int width, int height);
+    void closeCodec();
+    void encodeSlot(Slot& slot);
+    void drainPackets(int64_t startNs);
+
+    Config mConfig;
+    std::unique_ptr<VideoRowPool> mPool;
+    std::vector<Slot> mSlots;
+    bool mInitialized;
+
+    // Coding thread state, touched by encodeLoop only
+    AVCodecContext* mContext;
+    AVPacket* mPacket;
+    int mCodecWidth;
+    int mCodecHeight;
+    int64_t mPts;
+    uint32_t mSequence;
+    std::deque<FrameInfo> mInFlight; // sent to the codec, by pts
+
+    // Slot hand-off and coded output, under mLock
+    mutable std::mutex mLock;
+    std::condition_variable mWake;
+    std::deque<int> mFree;
+    std::deque<int> mQueued;
+    std::deque<Packet> mOutput;
+    std::vector<Packet> mSpare; // emptied packets, reused to avoid allocation
+    bool mRunning;
+    std::thread mThread;
+    Stats mStats;
+    int64_t mRateWindowNs;
+    uint64_t mRateWindowBytes;
+
+    VideoEncoder(const VideoEncoder&) = delete;
+    VideoEncoder& operator=(const VideoEncoder&) = delete;
+};
+
+class VideoDecoder {
+public:
+    struct Config {
+        Config() : threads(0), codecThreads(0), queueDepth(4) {}
+        int threads;      // colour conversion threads including the decoding thread, 0 = one per core
+        int codecThreads; // libavcodec slice threads, 0 = automatic
+        int queueDepth;   // packets waiting to be decoded; beyond it the oldest is dropped
+        ThreadPlacement placement; // applied by the decoding and conversion threads
+    };
+
+    struct Stats {
+        uint64_t packetsSubmitted;
+        uint64_t framesDecoded;
+        uint64_t packetsDropped; // queue full, or not a valid packet
+        uint64_t packetsSkipped; // waiting for a keyframe after a gap or an error
+        uint64_t bytesReceived;
+        double decodeMs;         // libavcodec time of the last picture
+        double convertMs;        // YUV to RGBA8 of the last picture
+        double latencyMs;        // submit() to picture ready, smoothed
+        double bitrateMbps;      // input over the last second
+    };
+
+    VideoDecoder();
+    ~VideoDecoder();
+
+    bool init(const Config& config = Config());
+    void shutdown();
+
+    // Copies a ReplicatedFrame::VIDEO frame into the decode queue. Safe to
+    // call from the receive thread while latestFrame() runs on another.
+    bool submit(const ReplicatedFrame& frame);
+
+    // Returns true and fills frame (RGBA8) if a newer picture was decoded
+    // since the last call; the data stays valid until the next call that
+    // returns true, like FrameMulticastReceiver::latestFrame()
+    bool latestFrame(ReplicatedFrame& frame);
+
+    bool isInitialized() const { return mInitialized; }
+    Stats stats() const;
+
+private:
+    struct Input {
+        Input() : width(0), height(0), generation(0), timestampNs(0), submittedNs(0) {}
+        std::vector<uint8_t> data; // VideoPacketHeader and coded picture
+        std::vector<uint8_t> metadata;
+        int width;
+        int height;
+        uint32_t generation;
+        int64_t timestampNs;
+        int64_t submittedNs;
+    };
+
+    struct FrameInfo {
+        FrameInfo() : pts(0), width(0), height(0), generation(0), timestampNs(0), submittedNs(0) {}
+        int64_t pts;
+        int width;
+        int height;
+        uint32_t generation;
+        int64_t timestampNs;
+        int64_t submittedNs;
+        std::vector<uint8_t> metadata;
+    };
+
+    struct Picture {
+        Picture() : width(0), height(0), generation(0), timestampNs(0), receivedNs(0) {}
+        std::vector<uint8_t> rgba;
+        std::vector<uint8_t> metadata;
+        int width;
+        int height;
+        uint32_t generation;
+        int64_t timestampNs;
+        int64_t receivedNs;
+    };
+
+    void decodeLoop();
+    void decodeInput(Input& input);
+    bool openCodec(uint8_t codec);
+    void closeCodec();
+    void drainFrames(int64_t startNs);
+
+    Config mConfig;
+    std::unique_ptr<VideoRowPool> mPool;
+    bool mInitialized;
+
+    // Decoding thread state, touched by decodeLoop only
+    AVCodecContext* mContext;
+    AVFrame* mFrame;
+    AVPacket* mPacket;
+    uint8_t mCodec;
+    bool mHaveSequence;
+    uint32_t mNextSequence;
+    bool mWaitingForKeyframe;
+    int64_t mPts;
+    std::deque<FrameInfo> mInFlight; // sent to the codec, by pts
+    Picture mDecoded;
+
+    // Input queue and finished pictures, under mLock
+    mutable std::mutex mLock;
+    std::condition_variable mWake;
+    std::deque<Input> mQueue;
+    std::vector<Input> mSpare;
+    bool mRunning;
+    std::thread mThread;
+    Picture mReady;
+    Picture mFront;
+    bool mReadyIsNew;
+    Stats mStats;
+    int64_t mRateWindowNs;
+    uint64_t mRateWindowBytes;
+
+    VideoDecoder(const VideoDecoder&) = delete;
+    VideoDecoder& operator=(const VideoDecoder&) = delete;
+};
+
+} // namespace al
+
+#endif
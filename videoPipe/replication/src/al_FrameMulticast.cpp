@@ -0,0 +1,981 @@
+#include "al_ext/replication/al_FrameMulticast.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <random>
+
+namespace al {
+
+namespace {
+
+bool resolveAddress(const std::string& host, uint16_t port, sockaddr_in& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    return inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1;
+}
+
+bool isMulticast(const sockaddr_in& addr) {
+    return IN_MULTICAST(ntohl(addr.sin_addr.s_addr));
+}
+
+void setBufferSize(int socket, int option, int bytes) {
+    // The kernel clamps this to net.core.[rw]mem_max
+    setsockopt(socket, SOL_SOCKET, option, &bytes, sizeof(bytes));
+}
+
+int64_t msToNs(int ms) {
+    return (int64_t)ms * 1000000;
+}
+
+#ifdef __linux__
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+// Kernel limit on segments per GSO send (UDP_MAX_SEGMENTS)
+const size_t kMaxSegments = 64;
+#endif
+
+// Chunks of one frame must agree on where their payload goes
+bool sameLayout(const FrameChunkHeader& a, const FrameChunkHeader& b) {
+    return a.chunkBytes == b.chunkBytes && a.chunkCount == b.chunkCount &&
+           a.frameBytes == b.frameBytes && a.metadataBytes == b.metadataBytes &&
+           a.parityCount == b.parityCount;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// FrameMulticastSender
+
+FrameMulticastSender::FrameMulticastSender()
+    : mSocket(-1)
+    , mSession(0)
+    , mSegmentation(false)
+    , mPendingGeneration(0)
+    , mHasPending(false)
+    , mRunning(false)
+    , mInitialized(false)
+    , mFramesPublished(0)
+    , mFramesSuperseded(0)
+    , mChunksSent(0)
+    , mParitySent(0)
+    , mBytesSent(0)
+    , mNacksReceived(0)
+    , mChunksRetransmitted(0)
+    , mSendCalls(0)
+{
+    mWakePipe[0] = mWakePipe[1] = -1;
+    memset(&mGroupAddr, 0, sizeof(mGroupAddr));
+}
+
+FrameMulticastSender::~FrameMulticastSender() {
+    shutdown();
+}
+
+bool FrameMulticastSender::init(const Config& config) {
+    if (mInitialized) return true;
+    mConfig = config;
+
+    if (mConfig.chunkBytes == 0 || mConfig.chunkBytes + sizeof(FrameChunkHeader) > kMaxDatagramBytes) {
+        std::cerr << "Invalid replication chunk size " << mConfig.chunkBytes << std::endl;
+        return false;
+    }
+    if (mConfig.historyFrames < 2) mConfig.historyFrames = 2;
+    if (mConfig.batchSize < 1) mConfig.batchSize = 1;
+
+    if (!resolveAddress(mConfig.group, mConfig.port, mGroupAddr)) {
+        std::cerr << "Invalid replication group address " << mConfig.group << std::endl;
+        return false;
+    }
+
+    // A restarted primary counts generations from 1 again; a new session
+    // tells replicas to forget the frames of the old one
+    std::random_device random;
+    mSession = (uint32_t)random() ^ (uint32_t)frameClockNs();
+    if (mSession == 0) mSession = 1;
+
+    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (mSocket < 0) {
+        std::cerr << "Failed to create replication socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Bind to an ephemeral port so replicas can send NACKs back to us
+    sockaddr_in local;
+    resolveAddress("0.0.0.0", 0, local);
+    if (bind(mSocket, (sockaddr*)&local, sizeof(local)) < 0) {
+        std::cerr << "Failed to bind replication socket: " << strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+
+    if (isMulticast(mGroupAddr)) {
+        in_addr iface;
+        if (inet_pton(AF_INET, mConfig.interfaceAddress.c_str(), &iface) != 1) {
+            std::cerr << "Invalid replication interface " << mConfig.interfaceAddress << std::endl;
+            shutdown();
+            return false;
+        }
+        unsigned char ttl = (unsigned char)mConfig.ttl;
+        unsigned char loop = 1; // replicas on this host must see our packets
+        setsockopt(mSocket, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface));
+        setsockopt(mSocket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(mSocket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    } else {
+        int broadcast = 1;
+        setsockopt(mSocket, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+    }
+    setBufferSize(mSocket, SO_SNDBUF, 8 << 20);
+
+    if (pipe(mWakePipe) < 0) {
+        std::cerr << "Failed to create replication wake pipe" << std::endl;
+        shutdown();
+        return false;
+    }
+    fcntl(mWakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(mWakePipe[1], F_SETFL, O_NONBLOCK);
+
+    mHistory.reset(new HistorySlot[mConfig.historyFrames]);
+    size_t datagramBytes = sizeof(FrameChunkHeader) + mConfig.chunkBytes;
+    mQueue.reserve(mConfig.batchSize);
+    mIovecs.resize((size_t)mConfig.batchSize * 2);
+#ifdef __linux__
+    mMessages.resize(mConfig.batchSize);
+    // A single datagram per send gains nothing from GSO
+    mSegmentation = mConfig.segmentationOffload && mConfig.batchSize > 1 &&
+                    2 * datagramBytes <= kMaxDatagramBytes;
+    if (mSegmentation) {
+        mSegmentBuffer.resize((size_t)mConfig.batchSize * datagramBytes);
+        mControl.resize((size_t)mConfig.batchSize * CMSG_SPACE(sizeof(uint16_t)));
+    }
+#else
+    mSegmentation = false;
+#endif
+
+    mRunning = true;
+    mThread = std::thread(&FrameMulticastSender::sendLoop, this);
+    mInitialized = true;
+    return true;
+}
+
+void FrameMulticastSender::shutdown() {
+    mRunning = false;
+    if (mWakePipe[1] >= 0) {
+        char wake = 0;
+        (void)!write(mWakePipe[1], &wake, 1);
+    }
+    if (mThread.joinable()) mThread.join();
+    for (int i = 0; i < 2; i++) {
+        if (mWakePipe[i] >= 0) close(mWakePipe[i]);
+        mWakePipe[i] = -1;
+    }
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+    mInitialized = false;
+}
+
+FrameMulticastSender::HistorySlot& FrameMulticastSender::slotFor(uint32_t generation) {
+    return mHistory[generation % (uint32_t)mConfig.historyFrames];
+}
+
+bool FrameMulticastSender::publish(const uint8_t* data, size_t bytes, int width, int height,
+                                   uint32_t format, uint32_t generation, int64_t timestampNs,
+                                   const uint8_t* metadata, size_t metadataBytes) {
+    if (!metadata) metadataBytes = 0;
+    if (!mInitialized || !data || bytes == 0 || bytes + metadataBytes > 0xFFFFFFFFu) return false;
+    if (metadataBytes > kMaxFrameMetadataBytes) {
+        std::cerr << "Frame metadata of " << metadataBytes << " bytes exceeds "
+                  << kMaxFrameMetadataBytes << std::endl;
+        return false;
+    }
+
+    HistorySlot& slot = slotFor(generation);
+    {
+        std::lock_guard<std::mutex> lock(slot.lock);
+        FrameChunkHeader& h = slot.header;
+        memset(&h, 0, sizeof(h));
+        h.magic = kFrameChunkMagic;
+        h.version = kFrameProtocolVersion;
+        h.type = FrameChunkHeader::DATA;
+        h.generation = generation;
+        h.session = mSession;
+        h.chunkBytes = (uint32_t)mConfig.chunkBytes;
+        h.frameBytes = (uint32_t)(bytes + metadataBytes);
+        h.metadataBytes = (uint32_t)metadataBytes;
+        h.chunkCount = chunkCountFor(h.frameBytes, mConfig.chunkBytes);
+        h.parityCount = parityCountFor(h.chunkCount, mConfig.fecOverhead);
+        h.width = (uint32_t)width;
+        h.height = (uint32_t)height;
+        h.format = format;
+        h.timestampNs = timestampNs ? timestampNs : frameClockNs();
+
+        slot.data.assign(data, data + bytes);
+        slot.data.insert(slot.data.end(), metadata, metadata + metadataBytes);
+        slot.lastSentNs.assign(h.chunkCount, 0);
+        slot.valid = true;
+    }
+
+    mPendingGeneration = generation;
+    if (mHasPending.exchange(true)) mFramesSuperseded++;
+    mFramesPublished++;
+
+    char wake = 1;
+    (void)!write(mWakePipe[1], &wake, 1);
+    return true;
+}
+
+void FrameMulticastSender::sendLoop() {
+    if (!mConfig.placement.isDefault()) mConfig.placement.apply("replication_send");
+
+    pollfd fds[2];
+    fds[0].fd = mSocket;
+    fds[0].events = POLLIN;
+    fds[1].fd = mWakePipe[0];
+    fds[1].events = POLLIN;
+
+    while (mRunning) {
+        fds[0].revents = fds[1].revents = 0;
+        if (poll(fds, 2, 50) < 0 && errno != EINTR) break;
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(mWakePipe[0], drain, sizeof(drain)) > 0) {}
+        }
+        if (mHasPending.exchange(false)) {
+            sendFrame(slotFor(mPendingGeneration));
+        }
+        serviceNacks();
+    }
+}
+
+void FrameMulticastSender::sendFrame(HistorySlot& slot) {
+    std::lock_guard<std::mutex> lock(slot.lock);
+    if (!slot.valid) return;
+    computeParity(slot);
+    int64_t now = frameClockNs();
+    for (uint32_t i = 0; i < slot.header.chunkCount && mRunning; i++) {
+        sendChunk(slot, i, now);
+    }
+    // Parity goes last so it covers losses anywhere in the frame
+    for (uint32_t i = 0; i < slot.header.parityCount && mRunning; i++) {
+        sendParity(slot, i);
+    }
+    flushPackets();
+}
+
+void FrameMulticastSender::computeParity(HistorySlot& slot) {
+    const FrameChunkHeader& h = slot.header;
+    if (h.parityCount == 0) return;
+    // Short last chunk is implicitly zero padded
+    slot.parity.assign((size_t)h.parityCount * h.chunkBytes, 0);
+    for (uint32_t i = 0; i < h.chunkCount; i++) {
+        xorInto(slot.parity.data() + (size_t)(i % h.parityCount) * h.chunkBytes,
+                slot.data.data() + (size_t)i * h.chunkBytes, chunkPayloadBytes(h, i));
+    }
+}
+
+void FrameMulticastSender::sendChunk(HistorySlot& slot, uint32_t index, int64_t nowNs) {
+    FrameChunkHeader h = slot.header;
+    h.chunkIndex = index;
+    queuePacket(h, slot.data.data() + (size_t)index * h.chunkBytes, chunkPayloadBytes(h, index));
+    slot.lastSentNs[index] = nowNs;
+}
+
+void FrameMulticastSender::sendParity(HistorySlot& slot, uint32_t index) {
+    FrameChunkHeader h = slot.header;
+    h.type = FrameChunkHeader::PARITY;
+    h.chunkIndex = index;
+    queuePacket(h, slot.parity.data() + (size_t)index * h.chunkBytes, h.chunkBytes);
+}
+
+void FrameMulticastSender::queuePacket(const FrameChunkHeader& header, const uint8_t* payload, size_t bytes) {
+    QueuedPacket packet;
+    packet.header = header;
+    packet.payload = payload;
+    packet.bytes = bytes;
+    mQueue.push_back(packet);
+    if ((int)mQueue.size() >= mConfig.batchSize) flushPackets();
+}
+
+void FrameMulticastSender::flushPackets() {
+    size_t next = 0;
+    while (next < mQueue.size()) {
+        size_t sent;
+        if (mSegmentation) {
+            sent = sendSegmented(next, mQueue.size() - next);
+            if (!mSegmentation) continue; // refused, send the same datagrams without GSO
+        } else {
+            sent = sendBatch(next, mQueue.size() - next);
+        }
+        if (sent == 0) {
+            next++; // dropped by the kernel, NACKs recover it
+            continue;
+        }
+        for (size_t i = next; i < next + sent; i++) {
+            if (mQueue[i].header.type == FrameChunkHeader::PARITY) {
+                mParitySent++;
+            } else {
+                mChunksSent++;
+            }
+            mBytesSent += sizeof(FrameChunkHeader) + mQueue[i].bytes;
+        }
+        next += sent;
+    }
+    mQueue.clear();
+}
+
+size_t FrameMulticastSender::sendBatch(size_t first, size_t count) {
+    // Header and payload are gathered from where they are, no staging copy
+    for (size_t i = 0; i < count; i++) {
+        const QueuedPacket& packet = mQueue[first + i];
+        mIovecs[2 * i].iov_base = (void*)&packet.header;
+        mIovecs[2 * i].iov_len = sizeof(FrameChunkHeader);
+        mIovecs[2 * i + 1].iov_base = (void*)packet.payload;
+        mIovecs[2 * i + 1].iov_len = packet.bytes;
+    }
+#ifdef __linux__
+    for (size_t i = 0; i < count; i++) {
+        msghdr& message = mMessages[i].msg_hdr;
+        memset(&message, 0, sizeof(message));
+        message.msg_name = &mGroupAddr;
+        message.msg_namelen = sizeof(mGroupAddr);
+        message.msg_iov = &mIovecs[2 * i];
+        message.msg_iovlen = 2;
+    }
+    int sent = sendmmsg(mSocket, mMessages.data(), (unsigned)count, 0);
+    mSendCalls++;
+    return sent > 0 ? (size_t)sent : 0;
+#else
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_name = &mGroupAddr;
+    message.msg_namelen = sizeof(mGroupAddr);
+    message.msg_iov = &mIovecs[0];
+    message.msg_iovlen = 2;
+    ssize_t sent = sendmsg(mSocket, &message, 0);
+    mSendCalls++;
+    return sent == (ssize_t)(sizeof(FrameChunkHeader) + mQueue[first].bytes) ? 1 : 0;
+#endif
+}
+
+size_t FrameMulticastSender::sendSegmented(size_t first, size_t count) {
+#ifdef __linux__
+    // Runs of equal-sized datagrams (only the last may be shorter) are
+    // copied back to back and sent as one message each; the kernel or NIC
+    // splits them at the UDP_SEGMENT size
+    size_t messages = 0, packets = 0, offset = 0;
+    size_t segmentsIn[64];
+    while (packets < count && messages < 64) {
+        size_t length = sizeof(FrameChunkHeader) + mQueue[first + packets].bytes;
+        size_t limit = kMaxDatagramBytes / length;
+        if (limit > kMaxSegments) limit = kMaxSegments;
+        size_t segments = 0;
+        uint8_t* start = mSegmentBuffer.data() + offset;
+        while (packets < count && segments < limit) {
+            const QueuedPacket& packet = mQueue[first + packets];
+            size_t packetLength = sizeof(FrameChunkHeader) + packet.bytes;
+            if (packetLength > length) break;
+            memcpy(mSegmentBuffer.data() + offset, &packet.header, sizeof(FrameChunkHeader));
+            memcpy(mSegmentBuffer.data() + offset + sizeof(FrameChunkHeader), packet.payload, packet.bytes);
+            offset += packetLength;
+            segments++;
+            packets++;
+            if (packetLength < length) break; // a short datagram ends the run
+        }
+
+        msghdr& message = mMessages[messages].msg_hdr;
+        memset(&message, 0, sizeof(message));
+        message.msg_name = &mGroupAddr;
+        message.msg_namelen = sizeof(mGroupAddr);
+        mIovecs[messages].iov_base = start;
+        mIovecs[messages].iov_len = (size_t)(mSegmentBuffer.data() + offset - start);
+        message.msg_iov = &mIovecs[messages];
+        message.msg_iovlen = 1;
+        if (segments > 1) {
+            uint8_t* control = mControl.data() + messages * CMSG_SPACE(sizeof(uint16_t));
+            memset(control, 0, CMSG_SPACE(sizeof(uint16_t)));
+            message.msg_control = control;
+            message.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segmentSize = (uint16_t)length;
+            memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+        }
+        segmentsIn[messages++] = segments;
+    }
+
+    int sent = sendmmsg(mSocket, mMessages.data(), (unsigned)messages, 0);
+    mSendCalls++;
+    if (sent <= 0) {
+        if (errno == EINVAL || errno == EIO || errno == ENOPROTOOPT || errno == EOPNOTSUPP) {
+            // Old kernel, or datagrams above the route MTU
+            std::cerr << "UDP segmentation offload unavailable (" << strerror(errno)
+                      << "), sending datagrams individually" << std::endl;
+            mSegmentation = false;
+        }
+        return 0;
+    }
+    size_t sentPackets = 0;
+    for (int i = 0; i < sent; i++) sentPackets += segmentsIn[i];
+    return sentPackets;
+#else
+    (void)first; (void)count;
+    mSegmentation = false;
+    return 0;
+#endif
+}
+
+void FrameMulticastSender::serviceNacks() {
+    uint8_t buffer[kMaxDatagramBytes];
+    while (true) {
+        ssize_t length = recv(mSocket, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (length < (ssize_t)sizeof(FrameChunkHeader)) return;
+
+        const FrameChunkHeader* h = (const FrameChunkHeader*)buffer;
+        if (h->magic != kFrameChunkMagic || h->version != kFrameProtocolVersion ||
+            h->type != FrameChunkHeader::NACK || h->session != mSession) {
+            continue;
+        }
+        uint32_t rangeCount = h->chunkIndex;
+        if (sizeof(FrameChunkHeader) + rangeCount * sizeof(FrameNackRange) > (size_t)length) {
+            continue;
+        }
+        mNacksReceived++;
+
+        HistorySlot& slot = slotFor(h->generation);
+        std::lock_guard<std::mutex> lock(slot.lock);
+        if (!slot.valid || slot.header.generation != h->generation) continue;
+
+        // Several replicas usually miss the same chunks; the holdoff answers
+        // them all with a single multicast retransmission. The queued
+        // retransmissions are flushed before the slot is unlocked.
+        int64_t now = frameClockNs();
+        int64_t holdoff = msToNs(mConfig.resendHoldoffMs);
+        const FrameNackRange* ranges = (const FrameNackRange*)(buffer + sizeof(FrameChunkHeader));
+        for (uint32_t r = 0; r < rangeCount; r++) {
+            uint32_t end = ranges[r].first + ranges[r].count;
+            if (end > slot.header.chunkCount || end < ranges[r].first) continue;
+            for (uint32_t i = ranges[r].first; i < end; i++) {
+                if (now - slot.lastSentNs[i] < holdoff) continue;
+                sendChunk(slot, i, now);
+                mChunksRetransmitted++;
+            }
+        }
+        flushPackets();
+    }
+}
+
+FrameMulticastSender::Stats FrameMulticastSender::stats() const {
+    Stats s;
+    s.framesPublished = mFramesPublished;
+    s.framesSuperseded = mFramesSuperseded;
+    s.chunksSent = mChunksSent;
+    s.paritySent = mParitySent;
+    s.bytesSent = mBytesSent;
+    s.nacksReceived = mNacksReceived;
+    s.chunksRetransmitted = mChunksRetransmitted;
+    s.sendCalls = mSendCalls;
+    s.framesPending = mHasPending ? 1 : 0;
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// FrameMulticastReceiver
+
+FrameMulticastReceiver::FrameMulticastReceiver()
+    : mSocket(-1)
+    , mHaveSender(false)
+    , mSession(0)
+    , mSenderIp(0)
+    , mHaveCompleted(false)
+    , mCompletedGeneration(0)
+    , mDropRate(0.0f)
+    , mReadyIsNew(false)
+    , mReadyReceivedNs(0)
+    , mFrontReceivedNs(0)
+    , mRunning(false)
+    , mInitialized(false)
+    , mFramesCompleted(0)
+    , mFramesDropped(0)
+    , mChunksReceived(0)
+    , mChunksDuplicate(0)
+    , mChunksRecovered(0)
+    , mChunksRejected(0)
+    , mChunksInjectedLoss(0)
+    , mNacksSent(0)
+    , mChunksRequested(0)
+    , mReceiveCalls(0)
+    , mSenderChanges(0)
+    , mFramesAssembling(0)
+{
+    memset(&mSenderAddr, 0, sizeof(mSenderAddr));
+    memset(&mReadyHeader, 0, sizeof(mReadyHeader));
+    memset(&mFrontHeader, 0, sizeof(mFrontHeader));
+}
+
+FrameMulticastReceiver::~FrameMulticastReceiver() {
+    shutdown();
+}
+
+bool FrameMulticastReceiver::init(const Config& config) {
+    if (mInitialized) return true;
+    mConfig = config;
+    mDropRate.store(config.dropRate, std::memory_order_relaxed);
+
+    sockaddr_in group;
+    if (!resolveAddress(mConfig.group, mConfig.port, group)) {
+        std::cerr << "Invalid replication group address " << mConfig.group << std::endl;
+        return false;
+    }
+
+    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (mSocket < 0) {
+        std::cerr << "Failed to create replication socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Several replicas on one host share the group port
+    int reuse = 1;
+    setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#ifdef SO_REUSEPORT
+    setsockopt(mSocket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+#endif
+    setBufferSize(mSocket, SO_RCVBUF, 32 << 20);
+
+    sockaddr_in local;
+    resolveAddress("0.0.0.0", mConfig.port, local);
+    if (bind(mSocket, (sockaddr*)&local, sizeof(local)) < 0) {
+        std::cerr << "Failed to bind replication port " << mConfig.port << ": "
+                  << strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+
+    if (isMulticast(group)) {
+        ip_mreq membership;
+        membership.imr_multiaddr = group.sin_addr;
+        if (inet_pton(AF_INET, mConfig.interfaceAddress.c_str(), &membership.imr_interface) != 1 ||
+            setsockopt(mSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0) {
+            std::cerr << "Failed to join replication group " << mConfig.group << " on "
+                      << mConfig.interfaceAddress << std::endl;
+            shutdown();
+            return false;
+        }
+    }
+
+    if (mConfig.batchSize < 1) mConfig.batchSize = 1;
+    mPacket.resize((size_t)mConfig.batchSize * kMaxDatagramBytes);
+    mIovecs.resize(mConfig.batchSize);
+    mFrom.resize(mConfig.batchSize);
+#ifdef __linux__
+    mMessages.resize(mConfig.batchSize);
+    for (int i = 0; i < mConfig.batchSize; i++) {
+        mIovecs[i].iov_base = mPacket.data() + (size_t)i * kMaxDatagramBytes;
+        mIovecs[i].iov_len = kMaxDatagramBytes;
+    }
+#endif
+    mLossRandom.seed((unsigned)frameClockNs());
+    mRunning = true;
+    mThread = std::thread(&FrameMulticastReceiver::receiveLoop, this);
+    mInitialized = true;
+    return true;
+}
+
+void FrameMulticastReceiver::shutdown() {
+    mRunning = false;
+    if (mThread.joinable()) mThread.join();
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+    mInitialized = false;
+}
+
+bool FrameMulticastReceiver::latestFrame(ReplicatedFrame& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mFrameLock);
+        if (!mReadyIsNew) return false;
+        mReady.swap(mFront);
+        mFrontHeader = mReadyHeader;
+        mFrontReceivedNs = mReadyReceivedNs;
+        mReadyIsNew = false;
+    }
+    frame.data = mFront.data();
+    frame.bytes = mFrontHeader.frameBytes - mFrontHeader.metadataBytes;
+    frame.metadata = mFrontHeader.metadataBytes ? frame.data + frame.bytes : nullptr;
+    frame.metadataBytes = mFrontHeader.metadataBytes;
+    frame.width = (int)mFrontHeader.width;
+    frame.height = (int)mFrontHeader.height;
+    frame.format = mFrontHeader.format;
+    frame.generation = mFrontHeader.generation;
+    frame.timestampNs = mFrontHeader.timestampNs;
+    frame.receivedNs = mFrontReceivedNs;
+    return true;
+}
+
+void FrameMulticastReceiver::receiveLoop() {
+    if (!mConfig.placement.isDefault()) mConfig.placement.apply("replication_receive");
+
+    pollfd fd;
+    fd.fd = mSocket;
+    fd.events = POLLIN;
+
+    while (mRunning) {
+        fd.revents = 0;
+        if (poll(&fd, 1, 2) < 0 && errno != EINTR) break;
+
+        int64_t now = frameClockNs();
+        // Bound the batch so NACK timers are still serviced under load
+        for (int received = 0; received < 256 && (fd.revents & POLLIN);) {
+            int count = receiveBatch();
+            if (count <= 0) break;
+            for (int i = 0; i < count; i++) {
+                handleDatagram(mPacket.data() + (size_t)i * kMaxDatagramBytes,
+                               mIovecs[i].iov_len, mFrom[i], now);
+            }
+            received += count;
+        }
+        serviceNacks(frameClockNs());
+    }
+}
+
+int FrameMulticastReceiver::receiveBatch() {
+#ifdef __linux__
+    for (int i = 0; i < mConfig.batchSize; i++) {
+        msghdr& message = mMessages[i].msg_hdr;
+        memset(&message, 0, sizeof(message));
+        message.msg_name = &mFrom[i];
+        message.msg_namelen = sizeof(sockaddr_in);
+        mIovecs[i].iov_len = kMaxDatagramBytes;
+        message.msg_iov = &mIovecs[i];
+        message.msg_iovlen = 1;
+    }
+    int count = recvmmsg(mSocket, mMessages.data(), (unsigned)mConfig.batchSize, MSG_DONTWAIT, nullptr);
+    if (count <= 0) return 0;
+    mReceiveCalls++;
+    // iov_len now carries each datagram's length for the caller
+    for (int i = 0; i < count; i++) mIovecs[i].iov_len = mMessages[i].msg_len;
+    return count;
+#else
+    socklen_t fromLength = sizeof(sockaddr_in);
+    ssize_t length = recvfrom(mSocket, mPacket.data(), kMaxDatagramBytes, MSG_DONTWAIT,
+                              (sockaddr*)&mFrom[0], &fromLength);
+    if (length < 0) return 0;
+    mReceiveCalls++;
+    mIovecs[0].iov_len = (size_t)length;
+    return 1;
+#endif
+}
+
+void FrameMulticastReceiver::handleDatagram(const uint8_t* data, size_t length,
+                                            const sockaddr_in& from, int64_t nowNs) {
+    if (length < sizeof(FrameChunkHeader)) return;
+    float dropRate = mDropRate.load(std::memory_order_relaxed);
+    if (dropRate > 0.0f && mLossRandom() < dropRate * (float)std::minstd_rand::max()) {
+        mChunksInjectedLoss++;
+        return;
+    }
+
+    const FrameChunkHeader* h = (const FrameChunkHeader*)data;
+    if (h->magic != kFrameChunkMagic || h->version != kFrameProtocolVersion ||
+        (h->type != FrameChunkHeader::DATA && h->type != FrameChunkHeader::PARITY)) {
+        return;
+    }
+    handleChunk(*h, data + sizeof(FrameChunkHeader), length - sizeof(FrameChunkHeader), from, nowNs);
+}
+
+void FrameMulticastReceiver::handleChunk(const FrameChunkHeader& header, const uint8_t* payload,
+                                         size_t payloadBytes, const sockaddr_in& from, int64_t nowNs) {
+    bool parity = header.type == FrameChunkHeader::PARITY;
+    if (header.chunkBytes == 0 || header.frameBytes == 0 ||
+        header.frameBytes > mConfig.maxFrameBytes ||
+        header.metadataBytes > kMaxFrameMetadataBytes || header.metadataBytes >= header.frameBytes ||
+        header.chunkCount != chunkCountFor(header.frameBytes, header.chunkBytes) ||
+        header.parityCount > header.chunkCount) {
+        mChunksRejected++;
+        return;
+    }
+    if (parity ? (header.chunkIndex >= header.parityCount || payloadBytes != header.chunkBytes)
+               : (header.chunkIndex >= header.chunkCount ||
+                  payloadBytes != chunkPayloadBytes(header, header.chunkIndex))) {
+        mChunksRejected++;
+        return;
+    }
+
+    if (mHaveSender && (header.session != mSession ||
+                        from.sin_addr.s_addr != mSenderAddr.sin_addr.s_addr ||
+                        from.sin_port != mSenderAddr.sin_port)) {
+        restartSession();
+    }
+    mSenderAddr = from;
+    mHaveSender = true;
+    mSession = header.session;
+    mSenderIp = from.sin_addr.s_addr;
+
+    if (mHaveCompleted && !generationNewer(header.generation, mCompletedGeneration)) {
+        mChunksDuplicate++;
+        return;
+    }
+
+    Assembly* assembly = assemblyFor(header);
+    if (!assembly) return;
+    // Offsets are computed from the assembly's layout, so a chunk of the
+    // same generation laid out differently would write outside its buffers
+    if (!sameLayout(header, assembly->header)) {
+        mChunksRejected++;
+        return;
+    }
+    assembly->lastChunkNs = nowNs;
+
+    uint32_t index = header.chunkIndex;
+    if (parity) {
+        if (assembly->parityReceived[index]) {
+            mChunksDuplicate++;
+            return;
+        }
+        memcpy(assembly->parity.data() + (size_t)index * assembly->header.chunkBytes, payload, payloadBytes);
+        assembly->parityReceived[index] = 1;
+        tryRecover(*assembly, index);
+    } else {
+        if (assembly->received[index]) {
+            mChunksDuplicate++;
+            return;
+        }
+        storeChunk(*assembly, index, payload, payloadBytes);
+        mChunksReceived++;
+        if (assembly->header.parityCount) {
+            tryRecover(*assembly, index % assembly->header.parityCount);
+        }
+    }
+
+    if (assembly->receivedCount == assembly->header.chunkCount) {
+        completeFrame(*assembly);
+    }
+}
+
+void FrameMulticastReceiver::restartSession() {
+    for (int i = 0; i < kAssemblySlots; i++) {
+        if (mAssembly[i].active) {
+            mAssembly[i].active = false;
+            mFramesDropped++;
+        }
+    }
+    mHaveCompleted = false;
+    mSenderChanges++;
+}
+
+void FrameMulticastReceiver::storeChunk(Assembly& assembly, uint32_t index,
+                                        const uint8_t* payload, size_t bytes) {
+    memcpy(assembly.data.data() + (size_t)index * assembly.header.chunkBytes, payload, bytes);
+    assembly.received[index] = 1;
+    assembly.receivedCount++;
+    if (assembly.header.parityCount) {
+        assembly.groupReceived[index % assembly.header.parityCount]++;
+    }
+}
+
+void FrameMulticastReceiver::tryRecover(Assembly& assembly, uint32_t group) {
+    const FrameChunkHeader& h = assembly.header;
+    uint32_t groupSize = parityGroupSize(h.chunkCount, h.parityCount, group);
+    // XOR parity can rebuild exactly one missing chunk per group
+    if (!assembly.parityReceived[group] || assembly.groupReceived[group] + 1 != groupSize) return;
+
+    uint32_t missing = group;
+    while (assembly.received[missing]) missing += h.parityCount;
+
+    size_t bytes = chunkPayloadBytes(h, missing);
+    uint8_t* dst = assembly.data.data() + (size_t)missing * h.chunkBytes;
+    memcpy(dst, assembly.parity.data() + (size_t)group * h.chunkBytes, bytes);
+    for (uint32_t i = group; i < h.chunkCount; i += h.parityCount) {
+        if (i == missing) continue;
+        size_t other = chunkPayloadBytes(h, i);
+        xorInto(dst, assembly.data.data() + (size_t)i * h.chunkBytes, other < bytes ? other : bytes);
+    }
+    assembly.received[missing] = 1;
+    assembly.receivedCount++;
+    assembly.groupReceived[group]++;
+    mChunksRecovered++;
+}
+
+FrameMulticastReceiver::Assembly* FrameMulticastReceiver::assemblyFor(const FrameChunkHeader& header) {
+    Assembly* freeSlot = nullptr;
+    Assembly* oldest = nullptr;
+    for (int i = 0; i < kAssemblySlots; i++) {
+        Assembly& a = mAssembly[i];
+        if (!a.active) {
+            if (!freeSlot) freeSlot = &a;
+        } else if (a.header.generation == header.generation) {
+            return &a;
+        } else if (!oldest || generationNewer(oldest->header.generation, a.header.generation)) {
+            oldest = &a;
+        }
+    }
+
+    Assembly* target = freeSlot;
+    if (!target) {
+        // All slots busy: evict the oldest frame, unless this chunk is older still
+        if (!generationNewer(header.generation, oldest->header.generation)) return nullptr;
+        target = oldest;
+        mFramesDropped++;
+    }
+
+    target->active = true;
+    target->header = header;
+    target->data.resize(header.frameBytes);
+    target->received.assign(header.chunkCount, 0);
+    target->parity.resize((size_t)header.parityCount * header.chunkBytes);
+    target->parityReceived.assign(header.parityCount, 0);
+    target->groupReceived.assign(header.parityCount, 0);
+    target->receivedCount = 0;
+    target->lastNackNs = 0;
+    target->nackCount = 0;
+    return target;
+}
+
+void FrameMulticastReceiver::completeFrame(Assembly& assembly) {
+    if (mFrameHandler) {
+        const FrameChunkHeader& h = assembly.header;
+        ReplicatedFrame frame;
+        frame.data = assembly.data.data();
+        frame.bytes = h.frameBytes - h.metadataBytes;
+        frame.metadata = h.metadataBytes ? frame.data + frame.bytes : nullptr;
+        frame.metadataBytes = h.metadataBytes;
+        frame.width = (int)h.width;
+        frame.height = (int)h.height;
+        frame.format = h.format;
+        frame.generation = h.generation;
+        frame.timestampNs = h.timestampNs;
+        frame.receivedNs = assembly.lastChunkNs;
+        mFrameHandler(frame);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mFrameLock);
+        // Swap rather than copy; the assembly inherits the old ready buffer
+        mReady.swap(assembly.data);
+        mReadyHeader = assembly.header;
+        mReadyReceivedNs = assembly.lastChunkNs;
+        mReadyIsNew = true;
+    }
+    mCompletedGeneration = assembly.header.generation;
+    mHaveCompleted = true;
+    mFramesCompleted++;
+    assembly.active = false;
+
+    // Older partial frames can never be shown now
+    for (int i = 0; i < kAssemblySlots; i++) {
+        Assembly& a = mAssembly[i];
+        if (a.active && !generationNewer(a.header.generation, mCompletedGeneration)) {
+            a.active = false;
+            mFramesDropped++;
+        }
+    }
+}
+
+void FrameMulticastReceiver::serviceNacks(int64_t nowNs) {
+    Assembly* newest = nullptr;
+    int assembling = 0;
+    for (int i = 0; i < kAssemblySlots; i++) {
+        Assembly& a = mAssembly[i];
+        if (!a.active) continue;
+        if (nowNs - a.lastChunkNs > msToNs(mConfig.frameTimeoutMs)) {
+            a.active = false;
+            mFramesDropped++;
+            continue;
+        }
+        assembling++;
+        if (!newest || generationNewer(a.header.generation, newest->header.generation)) {
+            newest = &a;
+        }
+    }
+    mFramesAssembling = assembling;
+
+    // Only the newest frame is worth repairing; older ones will be superseded
+    if (!newest || !mHaveSender) return;
+    if (nowNs - newest->lastChunkNs < msToNs(mConfig.nackDelayMs)) return;
+    if (newest->lastNackNs && nowNs - newest->lastNackNs < msToNs(mConfig.nackIntervalMs)) return;
+    if (newest->nackCount >= mConfig.maxNacksPerFrame) {
+        newest->active = false;
+        mFramesDropped++;
+        return;
+    }
+    sendNack(*newest, nowNs);
+}
+
+void FrameMulticastReceiver::sendNack(Assembly& assembly, int64_t nowNs) {
+    static const uint32_t kMaxRanges = 1024;
+    uint8_t packet[sizeof(FrameChunkHeader) + kMaxRanges * sizeof(FrameNackRange)];
+    FrameChunkHeader* h = (FrameChunkHeader*)packet;
+    FrameNackRange* ranges = (FrameNackRange*)(packet + sizeof(FrameChunkHeader));
+
+    uint32_t rangeCount = 0;
+    uint32_t requested = 0;
+    uint32_t count = assembly.header.chunkCount;
+    for (uint32_t i = 0; i < count && rangeCount < kMaxRanges; i++) {
+        if (assembly.received[i]) continue;
+        uint32_t first = i;
+        while (i < count && !assembly.received[i]) i++;
+        ranges[rangeCount].first = first;
+        ranges[rangeCount].count = i - first;
+        requested += i - first;
+        rangeCount++;
+    }
+    if (rangeCount == 0) return;
+
+    memset(h, 0, sizeof(*h));
+    h->magic = kFrameChunkMagic;
+    h->version = kFrameProtocolVersion;
+    h->type = FrameChunkHeader::NACK;
+    h->generation = assembly.header.generation;
+    h->session = assembly.header.session;
+    h->chunkIndex = rangeCount;
+
+    size_t length = sizeof(FrameChunkHeader) + rangeCount * sizeof(FrameNackRange);
+    sendto(mSocket, packet, length, 0, (const sockaddr*)&mSenderAddr, sizeof(mSenderAddr));
+    assembly.lastNackNs = nowNs;
+    assembly.nackCount++;
+    mNacksSent++;
+    mChunksRequested += requested;
+}
+
+std::string FrameMulticastReceiver::senderAddress() const {
+    in_addr addr;
+    addr.s_addr = mSenderIp;
+    if (addr.s_addr == 0) return std::string();
+    char text[INET_ADDRSTRLEN];
+    return inet_ntop(AF_INET, &addr, text, sizeof(text)) ? text : std::string();
+}
+
+FrameMulticastReceiver::Stats FrameMulticastReceiver::stats() const {
+    Stats s;
+    s.framesCompleted = mFramesCompleted;
+    s.framesDropped = mFramesDropped;
+    s.chunksReceived = mChunksReceived;
+    s.chunksDuplicate = mChunksDuplicate;
+    s.chunksRecovered = mChunksRecovered;
+    s.chunksRejected = mChunksRejected;
+    s.chunksInjectedLoss = mChunksInjectedLoss;
+    s.nacksSent = mNacksSent;
+    s.chunksRequested = mChunksRequested;
+    s.receiveCalls = mReceiveCalls;
+    s.senderChanges = mSenderChanges;
+    s.framesAssembling = mFramesAssembling;
+    return s;
+}
+
+} // namespace al
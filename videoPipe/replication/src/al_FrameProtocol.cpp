@@ -0,0 +1,16 @@
+#include "al_ext/replication/al_FrameProtocol.hpp"
+#include <chrono>
+
+namespace al {
+
+int64_t frameClockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t steadyClockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace al
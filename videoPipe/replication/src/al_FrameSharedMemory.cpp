@@ -0,0 +1,387 @@
+#include "al_ext/replication/al_FrameSharedMemory.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+
+namespace al {
+
+// Both structs live in the shared mapping; the atomics must be lock-free to
+// work across processes
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "shared frame ring needs lock-free atomics");
+
+static const uint32_t kSharedRingMagic = 0x52534C41; // "ALSR"
+static const uint32_t kSharedRingVersion = 2;
+static const size_t kSharedPageBytes = 4096; // ring and slot headers; keeps frame data page aligned
+
+struct SharedFrameRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t reserved;
+    uint64_t slotStride;   // bytes from one slot header to the next
+    uint64_t slotCapacity; // frame bytes per slot
+    std::atomic<uint64_t> latest;      // newest frame: sequence << 8 | slot, 0 = none yet
+    std::atomic<int64_t> heartbeatNs;  // CLOCK_MONOTONIC of the last frame or heartbeat()
+};
+
+struct SharedFrameSlot {
+    std::atomic<uint64_t> version;  // odd while the writer owns the slot
+    std::atomic<uint32_t> readers;  // replicas holding the slot
+    uint32_t metadataBytes;         // stored right after this header
+    uint64_t sequence;              // frame sequence, set while version is odd
+    uint64_t bytes;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t generation;
+    int64_t timestampNs;
+    // metadata follows, frame data starts at kSharedPageBytes
+};
+
+static_assert(sizeof(SharedFrameSlot) + kMaxFrameMetadataBytes <= kSharedPageBytes,
+              "frame metadata must fit in the slot header page");
+
+namespace {
+
+int64_t monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t roundUpToPage(size_t bytes) {
+    return (bytes + kSharedPageBytes - 1) / kSharedPageBytes * kSharedPageBytes;
+}
+
+uint8_t* slotData(SharedFrameSlot* slot) {
+    return (uint8_t*)slot + kSharedPageBytes;
+}
+
+uint8_t* slotMetadata(SharedFrameSlot* slot) {
+    return (uint8_t*)slot + sizeof(SharedFrameSlot);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// SharedFrameWriter
+
+SharedFrameWriter::SharedFrameWriter()
+    : mFd(-1)
+    , mRing(nullptr)
+    , mMappedBytes(0)
+    , mWriting(-1)
+    , mWritingBytes(0)
+    , mSequence(0)
+{
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+SharedFrameWriter::~SharedFrameWriter() {
+    shutdown();
+}
+
+bool SharedFrameWriter::init(const Config& config) {
+    if (mRing) return true;
+    mConfig = config;
+    if (mConfig.slotCount < 2) mConfig.slotCount = 2;
+    if (mConfig.slotCount > 64) mConfig.slotCount = 64;
+
+    // A ring left by a previous primary is unlinked rather than reused, so
+    // replicas still mapping it never see it change size under them
+    shm_unlink(mConfig.name.c_str());
+    mFd = shm_open(mConfig.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (mFd < 0) {
+        std::cerr << "Failed to create shared frame ring " << mConfig.name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    size_t stride = kSharedPageBytes + roundUpToPage(mConfig.maxFrameBytes);
+    mMappedBytes = kSharedPageBytes + stride * mConfig.slotCount;
+    if (ftruncate(mFd, (off_t)mMappedBytes) < 0) {
+        std::cerr << "Failed to size shared frame ring " << mConfig.name << ": " << strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+    void* mapped = mmap(nullptr, mMappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Failed to map shared frame ring " << mConfig.name << ": " << strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+
+    // ftruncate zero-fills, so every slot starts even and unpinned
+    mRing = (SharedFrameRingHeader*)mapped;
+    mRing->version = kSharedRingVersion;
+    mRing->slotCount = (uint32_t)mConfig.slotCount;
+    mRing->slotStride = stride;
+    mRing->slotCapacity = mConfig.maxFrameBytes;
+    mRing->latest.store(0);
+    mRing->heartbeatNs.store(monotonicNs());
+    std::atomic_thread_fence(std::memory_order_release);
+    mRing->magic = kSharedRingMagic;
+
+    mWriting = -1;
+    mSequence = 0;
+    memset(&mStats, 0, sizeof(mStats));
+    return true;
+}
+
+void SharedFrameWriter::shutdown() {
+    if (mRing) {
+        munmap(mRing, mMappedBytes);
+        mRing = nullptr;
+        shm_unlink(mConfig.name.c_str());
+    }
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+    mWriting = -1;
+}
+
+SharedFrameSlot* SharedFrameWriter::slot(int index) {
+    return (SharedFrameSlot*)((uint8_t*)mRing + kSharedPageBytes + (size_t)index * mRing->slotStride);
+}
+
+uint8_t* SharedFrameWriter::beginFrame(size_t bytes) {
+    if (!mRing) return nullptr;
+    if (bytes > mConfig.maxFrameBytes) {
+        if (mStats.framesTooLarge++ == 0) {
+            std::cerr << "Frame of " << bytes << " bytes does not fit the shared frame ring ("
+                      << mConfig.maxFrameBytes << ")" << std::endl;
+        }
+        return nullptr;
+    }
+    if (mWriting >= 0) {
+        // Previous beginFrame was never committed; fill the same slot again
+        mWritingBytes = bytes;
+        return slotData(slot(mWriting));
+    }
+
+    uint64_t latest = mRing->latest.load(std::memory_order_acquire);
+    int latestSlot = latest ? (int)(latest & 0xff) : -1;
+
+    // Oldest unpinned slot first. Marking the slot odd before checking its
+    // readers (and readers pinning before checking the version) means one
+    // side always sees the other.
+    int chosen = -1, oldest = -1;
+    uint64_t tried = 0;
+    while (chosen < 0) {
+        int candidate = -1;
+        for (int i = 0; i < mConfig.slotCount; i++) {
+            if (i == latestSlot || (tried >> i & 1)) continue;
+            SharedFrameSlot* s = slot(i);
+            if (oldest < 0 || s->sequence < slot(oldest)->sequence) oldest = i;
+            if (s->readers.load() != 0) continue;
+            if (candidate < 0 || s->sequence < slot(candidate)->sequence) candidate = i;
+        }
+        if (candidate < 0) break;
+        SharedFrameSlot* s = slot(candidate);
+        s->version.fetch_add(1);
+        if (s->readers.load() == 0) {
+            chosen = candidate;
+        } else {
+            s->version.fetch_add(1); // a reader pinned it meanwhile
+            tried |= 1ull << candidate;
+        }
+    }
+    if (chosen < 0) {
+        // Every other slot is pinned; take the oldest, its reader sees it torn
+        chosen = oldest;
+        slot(chosen)->version.fetch_add(1);
+        mStats.slotsOverwritten++;
+    }
+
+    mWriting = chosen;
+    mWritingBytes = bytes;
+    return slotData(slot(chosen));
+}
+
+void SharedFrameWriter::commitFrame(int width, int height, uint32_t format, uint32_t generation,
+                                    int64_t timestampNs,
+                                    const uint8_t* metadata, size_t metadataBytes) {
+    if (!mRing || mWriting < 0) return;
+    if (!metadata || metadataBytes > kMaxFrameMetadataBytes) metadataBytes = 0;
+    SharedFrameSlot* s = slot(mWriting);
+    if (metadataBytes) memcpy(slotMetadata(s), metadata, metadataBytes);
+    s->metadataBytes = (uint32_t)metadataBytes;
+    s->sequence = ++mSequence;
+    s->bytes = mWritingBytes;
+    s->width = (uint32_t)width;
+    s->height = (uint32_t)height;
+    s->format = format;
+    s->generation = generation;
+    s->timestampNs = timestampNs ? timestampNs : frameClockNs();
+    s->version.fetch_add(1, std::memory_order_release);
+
+    mRing->latest.store(mSequence << 8 | (uint64_t)mWriting, std::memory_order_release);
+    mRing->heartbeatNs.store(monotonicNs(), std::memory_order_relaxed);
+    mWriting = -1;
+    mStats.framesPublished++;
+}
+
+bool SharedFrameWriter::publish(const uint8_t* data, size_t bytes, int width, int height,
+                                uint32_t format, uint32_t generation, int64_t timestampNs,
+                                const uint8_t* metadata, size_t metadataBytes) {
+    uint8_t* dst = beginFrame(bytes);
+    if (!dst) return false;
+    memcpy(dst, data, bytes);
+    commitFrame(width, height, format, generation, timestampNs, metadata, metadataBytes);
+    return true;
+}
+
+void SharedFrameWriter::heartbeat() {
+    if (mRing) mRing->heartbeatNs.store(monotonicNs(), std::memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------
+// SharedFrameReader
+
+SharedFrameReader::SharedFrameReader()
+    : mFd(-1)
+    , mRing(nullptr)
+    , mMappedBytes(0)
+    , mPinned(-1)
+    , mPinnedSequence(0)
+    , mLastSequence(0)
+    , mNextAttachNs(0)
+{
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+SharedFrameReader::~SharedFrameReader() {
+    shutdown();
+}
+
+bool SharedFrameReader::init(const Config& config) {
+    shutdown();
+    mConfig = config;
+    memset(&mStats, 0, sizeof(mStats));
+    mNextAttachNs = 0;
+    return isAvailable();
+}
+
+void SharedFrameReader::shutdown() {
+    detach();
+}
+
+SharedFrameSlot* SharedFrameReader::slot(int index) {
+    return (SharedFrameSlot*)((uint8_t*)mRing + kSharedPageBytes + (size_t)index * mRing->slotStride);
+}
+
+bool SharedFrameReader::attach() {
+    int64_t now = monotonicNs();
+    if (now < mNextAttachNs) return false;
+    mNextAttachNs = now + (int64_t)mConfig.retryMs * 1000000;
+
+    mFd = shm_open(mConfig.name.c_str(), O_RDWR, 0);
+    if (mFd < 0) return false; // no primary on this host
+
+    struct stat info;
+    void* mapped = MAP_FAILED;
+    if (fstat(mFd, &info) == 0 && (size_t)info.st_size >= kSharedPageBytes) {
+        mMappedBytes = (size_t)info.st_size;
+        mapped = mmap(nullptr, mMappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    }
+    if (mapped == MAP_FAILED) {
+        close(mFd);
+        mFd = -1;
+        return false;
+    }
+    mRing = (SharedFrameRingHeader*)mapped;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (mRing->magic != kSharedRingMagic || mRing->version != kSharedRingVersion ||
+        kSharedPageBytes + mRing->slotStride * mRing->slotCount > mMappedBytes) {
+        detach();
+        return false;
+    }
+    mLastSequence = 0;
+    mStats.reattaches++;
+    return true;
+}
+
+void SharedFrameReader::detach() {
+    release();
+    if (mRing) {
+        munmap(mRing, mMappedBytes);
+        mRing = nullptr;
+    }
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+void SharedFrameReader::release() {
+    if (!mRing || mPinned < 0) return;
+    SharedFrameSlot* s = slot(mPinned);
+    // Overwritten while pinned: being written now, or rewritten since
+    if ((s->version.load(std::memory_order_acquire) & 1) || s->sequence != mPinnedSequence) {
+        mStats.framesTorn++;
+    }
+    s->readers.fetch_sub(1);
+    mPinned = -1;
+}
+
+bool SharedFrameReader::isAvailable() {
+    if (mRing) {
+        int64_t age = monotonicNs() - mRing->heartbeatNs.load(std::memory_order_relaxed);
+        if (age <= (int64_t)mConfig.staleMs * 1000000) return true;
+        // The primary is gone, or restarted with a new ring
+        detach();
+    }
+    if (!attach()) return false;
+    int64_t age = monotonicNs() - mRing->heartbeatNs.load(std::memory_order_relaxed);
+    if (age > (int64_t)mConfig.staleMs * 1000000) {
+        detach();
+        return false;
+    }
+    return true;
+}
+
+bool SharedFrameReader::latestFrame(ReplicatedFrame& frame) {
+    if (!isAvailable()) return false;
+
+    uint64_t latest = mRing->latest.load(std::memory_order_acquire);
+    uint64_t sequence = latest >> 8;
+    int index = (int)(latest & 0xff);
+    if (latest == 0 || sequence == mLastSequence || index >= (int)mRing->slotCount) return false;
+
+    // Pin before checking the version; see SharedFrameWriter::beginFrame
+    SharedFrameSlot* s = slot(index);
+    s->readers.fetch_add(1);
+    uint64_t version = s->version.load();
+    if ((version & 1) || s->sequence != sequence) {
+        // Lapped between loading latest and pinning; the next call gets the newer frame
+        s->readers.fetch_sub(1);
+        return false;
+    }
+
+    release();
+    mPinned = index;
+    mPinnedSequence = sequence;
+    mLastSequence = sequence;
+    mStats.framesRead++;
+
+    frame.data = slotData(s);
+    frame.bytes = (size_t)s->bytes;
+    frame.metadataBytes = s->metadataBytes <= kMaxFrameMetadataBytes ? s->metadataBytes : 0;
+    frame.metadata = frame.metadataBytes ? slotMetadata(s) : nullptr;
+    frame.width = (int)s->width;
+    frame.height = (int)s->height;
+    frame.format = s->format;
+    frame.generation = s->generation;
+    frame.timestampNs = s->timestampNs;
+    frame.receivedNs = frameClockNs();
+    return true;
+}
+
+} // namespace al
@@ -0,0 +1,357 @@
+#include "al_ext/replication/al_FrameSnapshot.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+
+namespace al {
+
+namespace {
+
+bool resolveAddress(const std::string& host, uint16_t port, sockaddr_in& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    return inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1;
+}
+
+// Waits until the socket is ready for events or deadlineNs (steadyClockNs) passes
+bool waitFor(int socket, short events, int64_t deadlineNs) {
+    while (true) {
+        int64_t remainingMs = (deadlineNs - steadyClockNs()) / 1000000;
+        if (remainingMs < 0) return false;
+        pollfd fd;
+        fd.fd = socket;
+        fd.events = events;
+        fd.revents = 0;
+        int result = poll(&fd, 1, (int)remainingMs + 1);
+        if (result > 0) return true;
+        if (result < 0 && errno != EINTR) return false;
+    }
+}
+
+bool sendAll(int socket, const uint8_t* data, size_t bytes, int64_t deadlineNs) {
+    while (bytes > 0) {
+        ssize_t sent = send(socket, data, bytes, MSG_NOSIGNAL);
+        if (sent > 0) {
+            data += sent;
+            bytes -= (size_t)sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (!waitFor(socket, POLLOUT, deadlineNs)) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool receiveAll(int socket, uint8_t* data, size_t bytes, int64_t deadlineNs) {
+    while (bytes > 0) {
+        ssize_t received = recv(socket, data, bytes, 0);
+        if (received > 0) {
+            data += received;
+            bytes -= (size_t)received;
+        } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (!waitFor(socket, POLLIN, deadlineNs)) return false;
+        } else {
+            return false; // closed early
+        }
+    }
+    return true;
+}
+
+void initHeader(SnapshotHeader& header) {
+    memset(&header, 0, sizeof(header));
+    header.magic = kSnapshotMagic;
+    header.version = kFrameProtocolVersion;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// FrameSnapshotServer
+
+FrameSnapshotServer::FrameSnapshotServer()
+    : mSocket(-1)
+    , mRunning(false)
+    , mInitialized(false)
+    , mSnapshotsServed(0)
+    , mRequestsFailed(0)
+    , mBytesServed(0)
+{}
+
+FrameSnapshotServer::~FrameSnapshotServer() {
+    shutdown();
+}
+
+bool FrameSnapshotServer::init(const Config& config) {
+    if (mInitialized) return true;
+    mConfig = config;
+
+    sockaddr_in local;
+    if (!resolveAddress(mConfig.interfaceAddress, mConfig.port, local)) {
+        std::cerr << "Invalid snapshot interface " << mConfig.interfaceAddress << std::endl;
+        return false;
+    }
+    mSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (mSocket < 0) {
+        std::cerr << "Failed to create snapshot socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(mSocket, (sockaddr*)&local, sizeof(local)) < 0 || listen(mSocket, 16) < 0) {
+        std::cerr << "Failed to listen for snapshot requests on port " << mConfig.port
+                  << ": " << strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+    fcntl(mSocket, F_SETFL, O_NONBLOCK);
+
+    mRunning = true;
+    mThread = std::thread(&FrameSnapshotServer::serveLoop, this);
+    mInitialized = true;
+    return true;
+}
+
+void FrameSnapshotServer::shutdown() {
+    mRunning = false;
+    if (mThread.joinable()) mThread.join();
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+    mInitialized = false;
+}
+
+void FrameSnapshotServer::updateFrame(const uint8_t* data, size_t bytes, int width, int height,
+                                      uint32_t format, uint32_t generation, int64_t timestampNs,
+                                      const uint8_t* metadata, size_t metadataBytes) {
+    if (!metadata || metadataBytes > kMaxFrameMetadataBytes) metadataBytes = 0;
+    std::shared_ptr<FrameBuffer> target;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        target.swap(mSpareFrame);
+    }
+    if (!target || target.use_count() != 1) target = std::make_shared<FrameBuffer>();
+
+    initHeader(target->header);
+    target->header.generation = generation;
+    target->header.width = (uint32_t)width;
+    target->header.height = (uint32_t)height;
+    target->header.format = format;
+    target->header.frameBytes = (uint32_t)(bytes + metadataBytes);
+    target->header.metadataBytes = (uint32_t)metadataBytes;
+    target->header.timestampNs = timestampNs ? timestampNs : frameClockNs();
+    target->data.assign(data, data + bytes);
+    target->data.insert(target->data.end(), metadata, metadata + metadataBytes);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mSpareFrame = mFrame;
+    mFrame = target;
+}
+
+void FrameSnapshotServer::updateState(const void* state, size_t bytes) {
+    std::shared_ptr<StateBuffer> target;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        target.swap(mSpareState);
+    }
+    if (!target || target.use_count() != 1) target = std::make_shared<StateBuffer>();
+    const uint8_t* bytesIn = (const uint8_t*)state;
+    target->assign(bytesIn, bytesIn + bytes);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mSpareState = mState;
+    mState = target;
+}
+
+FrameSnapshotServer::Stats FrameSnapshotServer::stats() const {
+    Stats s;
+    s.snapshotsServed = mSnapshotsServed;
+    s.requestsFailed = mRequestsFailed;
+    s.bytesServed = mBytesServed;
+    return s;
+}
+
+void FrameSnapshotServer::serveLoop() {
+    if (!mConfig.placement.isDefault()) mConfig.placement.apply("snapshot");
+
+    while (mRunning) {
+        pollfd fd;
+        fd.fd = mSocket;
+        fd.events = POLLIN;
+        fd.revents = 0;
+        if (poll(&fd, 1, 50) <= 0) continue;
+
+        int client = accept(mSocket, nullptr, nullptr);
+        if (client < 0) continue;
+        fcntl(client, F_SETFL, O_NONBLOCK);
+        int noDelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        serve(client);
+        close(client);
+    }
+}
+
+void FrameSnapshotServer::serve(int client) {
+    int64_t deadline = steadyClockNs() + (int64_t)mConfig.sendTimeoutMs * 1000000;
+    SnapshotHeader request;
+    if (!receiveAll(client, (uint8_t*)&request, sizeof(request), deadline) ||
+        request.magic != kSnapshotMagic || request.version != kFrameProtocolVersion) {
+        mRequestsFailed++;
+        return;
+    }
+
+    // Hold references so updates during the transfer go to other buffers
+    std::shared_ptr<FrameBuffer> frame;
+    std::shared_ptr<StateBuffer> state;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        frame = mFrame;
+        state = mState;
+    }
+
+    SnapshotHeader header;
+    if (frame) {
+        header = frame->header;
+    } else {
+        initHeader(header);
+    }
+    header.stateBytes = state ? (uint32_t)state->size() : 0;
+
+    bool ok = sendAll(client, (const uint8_t*)&header, sizeof(header), deadline);
+    if (ok && header.stateBytes) ok = sendAll(client, state->data(), state->size(), deadline);
+    if (ok && header.frameBytes) ok = sendAll(client, frame->data.data(), frame->data.size(), deadline);
+    if (ok) {
+        mSnapshotsServed++;
+        mBytesServed += sizeof(header) + header.stateBytes + header.frameBytes;
+    } else {
+        mRequestsFailed++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// FrameSnapshotClient
+
+FrameSnapshotClient::FrameSnapshotClient()
+    : mRunning(false)
+    , mReady(false)
+    , mDelivered(false)
+    , mRequestNs(0)
+    , mReceivedNs(0)
+    , mFetchMs(0.0)
+{
+    initHeader(mHeader);
+}
+
+FrameSnapshotClient::~FrameSnapshotClient() {
+    shutdown();
+}
+
+bool FrameSnapshotClient::request(const Config& config) {
+    shutdown();
+    mConfig = config;
+    sockaddr_in addr;
+    if (!resolveAddress(mConfig.host, mConfig.port, addr)) {
+        std::cerr << "Invalid snapshot host " << mConfig.host << std::endl;
+        return false;
+    }
+    mReady = false;
+    mDelivered = false;
+    mRequestNs = steadyClockNs();
+    mRunning = true;
+    mThread = std::thread(&FrameSnapshotClient::fetchLoop, this);
+    return true;
+}
+
+void FrameSnapshotClient::shutdown() {
+    mRunning = false;
+    if (mThread.joinable()) mThread.join();
+}
+
+bool FrameSnapshotClient::latestFrame(ReplicatedFrame& frame) {
+    if (!mReady || mDelivered) return false;
+    mDelivered = true;
+    frame.data = mFrame.data();
+    frame.bytes = mFrame.size() - mHeader.metadataBytes;
+    frame.metadata = mHeader.metadataBytes ? frame.data + frame.bytes : nullptr;
+    frame.metadataBytes = mHeader.metadataBytes;
+    frame.width = (int)mHeader.width;
+    frame.height = (int)mHeader.height;
+    frame.format = mHeader.format;
+    frame.generation = mHeader.generation;
+    frame.timestampNs = mHeader.timestampNs;
+    frame.receivedNs = mReceivedNs;
+    return true;
+}
+
+void FrameSnapshotClient::fetchLoop() {
+    while (mRunning) {
+        if (fetch()) {
+            mReceivedNs = frameClockNs();
+            mFetchMs = (steadyClockNs() - mRequestNs) / 1e6;
+            mReady = true;
+            mRunning = false;
+            return;
+        }
+        // Sleep in short steps so shutdown() stays responsive
+        int64_t wakeNs = steadyClockNs() + (int64_t)mConfig.retryMs * 1000000;
+        while (mRunning && steadyClockNs() < wakeNs) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+bool FrameSnapshotClient::fetch() {
+    sockaddr_in addr;
+    resolveAddress(mConfig.host, mConfig.port, addr);
+    int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (socket < 0) return false;
+    fcntl(socket, F_SETFL, O_NONBLOCK);
+    int noDelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    int64_t deadline = steadyClockNs() + (int64_t)mConfig.timeoutMs * 1000000;
+    bool ok = true;
+    if (connect(socket, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        ok = errno == EINPROGRESS && waitFor(socket, POLLOUT, deadline) &&
+             getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+    }
+
+    SnapshotHeader request;
+    initHeader(request);
+    SnapshotHeader header;
+    ok = ok && sendAll(socket, (const uint8_t*)&request, sizeof(request), deadline) &&
+         receiveAll(socket, (uint8_t*)&header, sizeof(header), deadline);
+    if (ok && (header.magic != kSnapshotMagic || header.version != kFrameProtocolVersion ||
+               header.frameBytes > mConfig.maxFrameBytes || header.stateBytes > mConfig.maxFrameBytes ||
+               header.metadataBytes > kMaxFrameMetadataBytes || header.metadataBytes > header.frameBytes)) {
+        std::cerr << "Invalid snapshot from " << mConfig.host << std::endl;
+        ok = false;
+    }
+    if (ok) {
+        mState.resize(header.stateBytes);
+        mFrame.resize(header.frameBytes);
+        ok = receiveAll(socket, mState.data(), mState.size(), deadline) &&
+             receiveAll(socket, mFrame.data(), mFrame.size(), deadline);
+    }
+    close(socket);
+
+    // A primary without a frame yet is asked again
+    if (!ok || header.generation == 0 || header.frameBytes <= header.metadataBytes) return false;
+    mHeader = header;
+    return true;
+}
+
+} // namespace al
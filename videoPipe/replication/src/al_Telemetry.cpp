@@ -0,0 +1,440 @@
+#include "al_ext/replication/al_Telemetry.hpp"
+#include "al_ext/replication/al_FrameProtocol.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace al {
+
+namespace {
+
+const size_t kMaxMessageBytes = 256;
+
+bool resolveAddress(const std::string& host, uint16_t port, sockaddr_in& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    return inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1;
+}
+
+// OSC 1.0 encoding into a fixed buffer: big-endian 32-bit values, strings
+// null-terminated and padded to a multiple of 4 bytes
+struct OscWriter {
+    OscWriter(uint8_t* d, size_t c) : data(d), capacity(c), size(0), ok(true) {}
+
+    void string(const char* text) {
+        size_t length = strlen(text) + 1;
+        size_t padded = (length + 3) & ~(size_t)3;
+        if (size + padded > capacity) {
+            ok = false;
+            return;
+        }
+        memcpy(data + size, text, length);
+        memset(data + size + length, 0, padded - length);
+        size += padded;
+    }
+
+    void int32(int32_t value) {
+        if (size + 4 > capacity) {
+            ok = false;
+            return;
+        }
+        uint32_t big = htonl((uint32_t)value);
+        memcpy(data + size, &big, 4);
+        size += 4;
+    }
+
+    void float32(float value) {
+        int32_t bits;
+        memcpy(&bits, &value, 4);
+        int32(bits);
+    }
+
+    uint8_t* data;
+    size_t capacity;
+    size_t size;
+    bool ok;
+};
+
+struct OscReader {
+    OscReader(const uint8_t* d, size_t s) : data(d), size(s), offset(0), ok(true) {}
+
+    const char* string() {
+        if (offset >= size) {
+            ok = false;
+            return "";
+        }
+        const char* text = (const char*)data + offset;
+        size_t length = strnlen(text, size - offset);
+        if (offset + length >= size) {
+            ok = false;
+            return "";
+        }
+        offset += (length + 4) & ~(size_t)3;
+        return text;
+    }
+
+    int32_t int32() {
+        if (offset + 4 > size) {
+            ok = false;
+            return 0;
+        }
+        uint32_t big;
+        memcpy(&big, data + offset, 4);
+        offset += 4;
+        return (int32_t)ntohl(big);
+    }
+
+    float float32() {
+        int32_t bits = int32();
+        float value;
+        memcpy(&value, &bits, 4);
+        return value;
+    }
+
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    bool ok;
+};
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// TelemetryPublisher
+
+TelemetryPublisher::TelemetryPublisher()
+    : mSocket(-1)
+    , mDestination(0)
+    , mRunning(false)
+    , mInitialized(false)
+    , mMessagesSent(0)
+{
+    mNodeName[0] = '\0';
+}
+
+TelemetryPublisher::~TelemetryPublisher() {
+    shutdown();
+}
+
+bool TelemetryPublisher::init(const Config& config) {
+    if (mInitialized) return true;
+    mConfig = config;
+    if (!destination(mConfig.host)) {
+        std::cerr << "Invalid telemetry address " << mConfig.host << std::endl;
+        return false;
+    }
+
+    std::string name = mConfig.nodeName;
+    if (name.empty()) {
+        char host[64] = "node";
+        gethostname(host, sizeof(host) - 1);
+        host[sizeof(host) - 1] = '\0';
+        name = std::string(host) + ":" + std::to_string(getpid());
+    }
+    strncpy(mNodeName, name.c_str(), sizeof(mNodeName) - 1);
+    mNodeName[sizeof(mNodeName) - 1] = '\0';
+
+    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (mSocket < 0) {
+        std::cerr << "Failed to create telemetry socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    mRunning = true;
+    mThread = std::thread(&TelemetryPublisher::publishLoop, this);
+    mInitialized = true;
+    return true;
+}
+
+void TelemetryPublisher::shutdown() {
+    mRunning = false;
+    if (mThread.joinable()) mThread.join();
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+    mInitialized = false;
+}
+
+bool TelemetryPublisher::destination(const std::string& host) {
+    in_addr address;
+    if (inet_pton(AF_INET, host.c_str(), &address) != 1) return false;
+    mDestination = address.s_addr;
+    return true;
+}
+
+void TelemetryPublisher::update(const TelemetrySample& sample) {
+    mSample.store(sample);
+}
+
+bool TelemetryPublisher::readSample(TelemetrySample& sample) {
+    return mSample.version() != 0 && mSample.load(sample);
+}
+
+void TelemetryPublisher::publishLoop() {
+    if (!mConfig.placement.isDefault()) mConfig.placement.apply("telemetry");
+
+    uint8_t packet[kMaxMessageBytes];
+    int32_t sequence = 0;
+    int64_t nextNs = steadyClockNs();
+    while (mRunning) {
+        // Sleep in short steps so shutdown() does not wait a whole interval
+        int64_t now = steadyClockNs();
+        if (now < nextNs) {
+            int64_t remainingMs = (nextNs - now) / 1000000 + 1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(remainingMs < 50 ? remainingMs : 50));
+            continue;
+        }
+        nextNs = now + (int64_t)mConfig.intervalMs * 1000000;
+
+        TelemetrySample sample;
+        if (!readSample(sample)) continue;
+
+        OscWriter osc(packet, sizeof(packet));
+        osc.string(kTelemetryAddress);
+        osc.string(kTelemetryTypeTags);
+        osc.string(mNodeName);
+        osc.int32(sample.role);
+        osc.int32(++sequence);
+        osc.float32(sample.fps);
+        osc.int32((int32_t)sample.frameGeneration);
+        osc.float32(sample.uploadMs);
+        osc.float32(sample.replicationLagMs);
+        osc.int32((int32_t)sample.framesDropped);
+        osc.int32(sample.sendQueue);
+        osc.int32(sample.receiveQueue);
+        if (!osc.ok) continue;
+
+        sockaddr_in to;
+        memset(&to, 0, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_port = htons(mConfig.port);
+        to.sin_addr.s_addr = mDestination;
+        if (sendto(mSocket, packet, osc.size, 0, (sockaddr*)&to, sizeof(to)) == (ssize_t)osc.size) {
+            mMessagesSent++;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// TelemetryAggregator
+
+const char* TelemetryAggregator::healthName(Health health) {
+    switch (health) {
+    case OK: return "ok";
+    case DROPPING: return "dropping";
+    case LAGGING: return "lagging";
+    case SLOW: return "slow";
+    case STALE: return "stale";
+    }
+    return "?";
+}
+
+TelemetryAggregator::TelemetryAggregator()
+    : mSocket(-1)
+    , mNodeCount(0)
+    , mRunning(false)
+    , mInitialized(false)
+    , mMessagesReceived(0)
+    , mMessagesMalformed(0)
+    , mNodesIgnored(0)
+{}
+
+TelemetryAggregator::~TelemetryAggregator() {
+    shutdown();
+}
+
+bool TelemetryAggregator::init(const Config& config) {
+    if (mInitialized) return true;
+    mConfig = config;
+
+    sockaddr_in local;
+    if (!resolveAddress(mConfig.interfaceAddress, mConfig.port, local)) {
+        std::cerr << "Invalid telemetry interface address " << mConfig.interfaceAddress << std::endl;
+        return false;
+    }
+    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (mSocket < 0) {
+        std::cerr << "Failed to create telemetry socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (bind(mSocket, (sockaddr*)&local, sizeof(local)) < 0) {
+        std::cerr << "Failed to bind telemetry port " << mConfig.port << ": "
+                  << strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mNodes.assign(mConfig.maxNodes > 0 ? mConfig.maxNodes : 1, Node());
+        mNodeCount = 0;
+    }
+    mRunning = true;
+    mThread = std::thread(&TelemetryAggregator::receiveLoop, this);
+    mInitialized = true;
+    return true;
+}
+
+void TelemetryAggregator::shutdown() {
+    mRunning = false;
+    if (mThread.joinable()) mThread.join();
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+    mInitialized = false;
+}
+
+void TelemetryAggregator::receiveLoop() {
+    if (!mConfig.placement.isDefault()) mConfig.placement.apply("telemetry");
+
+    pollfd fd;
+    fd.fd = mSocket;
+    fd.events = POLLIN;
+    uint8_t packet[kMaxMessageBytes];
+    while (mRunning) {
+        fd.revents = 0;
+        if (poll(&fd, 1, 100) < 0 && errno != EINTR) break;
+        if (!(fd.revents & POLLIN)) continue;
+
+        sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t length = recvfrom(mSocket, packet, sizeof(packet), MSG_DONTWAIT, (sockaddr*)&from, &fromLength);
+        if (length > 0) handleMessage(packet, (size_t)length, from.sin_addr.s_addr, steadyClockNs());
+    }
+}
+
+void TelemetryAggregator::handleMessage(const uint8_t* data, size_t length, uint32_t address, int64_t nowNs) {
+    OscReader osc(data, length);
+    bool matches = strcmp(osc.string(), kTelemetryAddress) == 0 &&
+                   strcmp(osc.string(), kTelemetryTypeTags) == 0;
+    const char* name = osc.string();
+    TelemetrySample sample;
+    sample.role = osc.int32();
+    uint32_t sequence = (uint32_t)osc.int32();
+    sample.fps = osc.float32();
+    sample.frameGeneration = (uint32_t)osc.int32();
+    sample.uploadMs = osc.float32();
+    sample.replicationLagMs = osc.float32();
+    sample.framesDropped = (uint32_t)osc.int32();
+    sample.sendQueue = osc.int32();
+    sample.receiveQueue = osc.int32();
+    if (!osc.ok || !matches) {
+        mMessagesMalformed++;
+        return;
+    }
+    mMessagesReceived++;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    Node* node = nullptr;
+    for (int i = 0; i < mNodeCount && !node; i++) {
+        if (strncmp(mNodes[i].name, name, sizeof(mNodes[i].name) - 1) == 0) node = &mNodes[i];
+    }
+    if (!node) {
+        if (mNodeCount == (int)mNodes.size()) {
+            mNodesIgnored++;
+            return;
+        }
+        node = &mNodes[mNodeCount++];
+        *node = Node();
+        strncpy(node->name, name, sizeof(node->name) - 1);
+    }
+
+    if (node->messages > 0 && sequence > node->lastSequence) {
+        node->messagesLost += sequence - node->lastSequence - 1;
+    } else if (node->messages > 0) {
+        // Sequence went back: the node restarted
+        node->messagesLost = 0;
+        node->sample.framesDropped = sample.framesDropped;
+    }
+    node->previousDropped = node->messages > 0 ? node->sample.framesDropped : sample.framesDropped;
+    node->sample = sample;
+    node->address = address;
+    node->lastSequence = sequence;
+    node->lastNs = nowNs;
+    node->messages++;
+}
+
+TelemetryAggregator::Health TelemetryAggregator::healthOf(const Node& node, int64_t nowNs) const {
+    if (nowNs - node.lastNs > (int64_t)mConfig.staleMs * 1000000) return STALE;
+    if (node.sample.fps < mConfig.minFps) return SLOW;
+    if (node.sample.replicationLagMs > mConfig.maxLagMs) return LAGGING;
+    if (node.sample.framesDropped > node.previousDropped) return DROPPING;
+    return OK;
+}
+
+std::vector<TelemetryAggregator::NodeStatus> TelemetryAggregator::nodes() const {
+    int64_t now = steadyClockNs();
+    std::vector<NodeStatus> result;
+    std::lock_guard<std::mutex> lock(mLock);
+    result.reserve(mNodeCount);
+    for (int i = 0; i < mNodeCount; i++) {
+        const Node& node = mNodes[i];
+        NodeStatus status;
+        status.name = node.name;
+        char address[INET_ADDRSTRLEN];
+        in_addr in;
+        in.s_addr = node.address;
+        status.address = inet_ntop(AF_INET, &in, address, sizeof(address)) ? address : "";
+        status.sample = node.sample;
+        status.ageMs = (now - node.lastNs) / 1e6;
+        status.messages = node.messages;
+        status.messagesLost = node.messagesLost;
+        status.health = healthOf(node, now);
+        result.push_back(status);
+    }
+    return result;
+}
+
+int TelemetryAggregator::unhealthyCount() const {
+    int64_t now = steadyClockNs();
+    int count = 0;
+    std::lock_guard<std::mutex> lock(mLock);
+    for (int i = 0; i < mNodeCount; i++) {
+        if (healthOf(mNodes[i], now) != OK) count++;
+    }
+    return count;
+}
+
+std::string TelemetryAggregator::report() const {
+    std::vector<NodeStatus> all = nodes();
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << std::left << std::setw(24) << "node" << std::setw(16) << "address" << std::right
+        << std::setw(6) << "fps" << std::setw(8) << "frame" << std::setw(9) << "upload"
+        << std::setw(8) << "lag" << std::setw(8) << "dropped" << std::setw(6) << "sendQ"
+        << std::setw(6) << "recvQ" << std::setw(8) << "age" << "  health\n";
+    for (size_t i = 0; i < all.size(); i++) {
+        const NodeStatus& n = all[i];
+        out << std::left << std::setw(24)
+            << (n.name + (n.sample.role == TelemetrySample::PRIMARY ? " (P)" : ""))
+            << std::setw(16) << n.address << std::right
+            << std::setw(6) << n.sample.fps << std::setw(8) << n.sample.frameGeneration
+            << std::setw(7) << n.sample.uploadMs << "ms" << std::setw(6) << n.sample.replicationLagMs << "ms"
+            << std::setw(8) << n.sample.framesDropped << std::setw(6) << n.sample.sendQueue
+            << std::setw(6) << n.sample.receiveQueue << std::setw(6) << n.ageMs / 1000.0 << " s"
+            << "  " << healthName(n.health) << "\n";
+    }
+    return out.str();
+}
+
+TelemetryAggregator::Stats TelemetryAggregator::stats() const {
+    Stats s;
+    s.messagesReceived = mMessagesReceived;
+    s.messagesMalformed = mMessagesMalformed;
+    s.nodesIgnored = mNodesIgnored;
+    return s;
+}
+
+} // namespace al
@@ -0,0 +1,396 @@
+#include "al_ext/replication/al_TextureCompression.hpp"
+#include "al_ext/replication/al_FrameProtocol.hpp"
+
+#include <string.h>
+
+namespace al {
+
+namespace {
+
+// 16 pixels of RGB as ints, the working set of one block
+struct Block {
+    int rgb[16][3];
+};
+
+void loadBlock(const uint8_t* rgba, int width, int height, int bx, int by, Block& block) {
+    if (bx * 4 + 4 <= width && by * 4 + 4 <= height) {
+        for (int y = 0; y < 4; y++) {
+            const uint8_t* p = rgba + ((size_t)(by * 4 + y) * width + bx * 4) * 4;
+            for (int x = 0; x < 4; x++, p += 4) {
+                int* out = block.rgb[y * 4 + x];
+                out[0] = p[0];
+                out[1] = p[1];
+                out[2] = p[2];
+            }
+        }
+        return;
+    }
+    // Edge block, repeat the last column / row
+    for (int y = 0; y < 4; y++) {
+        int py = by * 4 + y < height ? by * 4 + y : height - 1;
+        const uint8_t* row = rgba + (size_t)py * width * 4;
+        for (int x = 0; x < 4; x++) {
+            int px = bx * 4 + x < width ? bx * 4 + x : width - 1;
+            const uint8_t* p = row + px * 4;
+            int* out = block.rgb[y * 4 + x];
+            out[0] = p[0];
+            out[1] = p[1];
+            out[2] = p[2];
+        }
+    }
+}
+
+int clamp255(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+uint16_t pack565(const int* c) {
+    return (uint16_t)((((clamp255(c[0]) * 31 + 127) / 255) << 11) |
+                      (((clamp255(c[1]) * 63 + 127) / 255) << 5) |
+                      ((clamp255(c[2]) * 31 + 127) / 255));
+}
+
+void unpack565(uint16_t c, int* rgb) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Four-color palette of a block with color0 > color1
+void palette(uint16_t c0, uint16_t c1, int colors[4][3]) {
+    unpack565(c0, colors[0]);
+    unpack565(c1, colors[1]);
+    for (int k = 0; k < 3; k++) {
+        colors[2][k] = (2 * colors[0][k] + colors[1][k]) / 3;
+        colors[3][k] = (colors[0][k] + 2 * colors[1][k]) / 3;
+    }
+}
+
+// Picks the nearest palette entry per pixel, returns the total squared error
+int chooseIndices(const Block& block, uint16_t c0, uint16_t c1, uint32_t& indices) {
+    int colors[4][3];
+    palette(c0, c1, colors);
+    int error = 0;
+    indices = 0;
+    for (int i = 0; i < 16; i++) {
+        const int* p = block.rgb[i];
+        int best = 0, bestError = 1 << 30;
+        for (int c = 0; c < 4; c++) {
+            int dr = p[0] - colors[c][0], dg = p[1] - colors[c][1], db = p[2] - colors[c][2];
+            int e = dr * dr + dg * dg + db * db;
+            if (e < bestError) {
+                bestError = e;
+                best = c;
+            }
+        }
+        indices |= (uint32_t)best << (2 * i);
+        error += bestError;
+    }
+    return error;
+}
+
+// Index of each pixel from its position along the color0 - color1 line,
+// one dot product per pixel; close to chooseIndices() for the mostly
+// collinear blocks of video
+void projectIndices(const Block& block, uint16_t c0, uint16_t c1, uint32_t& indices) {
+    static const uint32_t kIndexFromStep[4] = {1, 3, 2, 0}; // color1 .. color0
+    int colors[4][3];
+    palette(c0, c1, colors);
+    int d[3] = {colors[0][0] - colors[1][0], colors[0][1] - colors[1][1], colors[0][2] - colors[1][2]};
+    int length = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    indices = 0;
+    if (length == 0) return;
+    float scale = 3.0f / length;
+    int base = colors[1][0] * d[0] + colors[1][1] * d[1] + colors[1][2] * d[2];
+    for (int i = 0; i < 16; i++) {
+        const int* p = block.rgb[i];
+        int dot = p[0] * d[0] + p[1] * d[1] + p[2] * d[2] - base;
+        int step = (int)(dot * scale + 0.5f);
+        step = step < 0 ? 0 : (step > 3 ? 3 : step);
+        indices |= kIndexFromStep[step] << (2 * i);
+    }
+}
+
+// Endpoints spanning the block's bounding box, inset by 1/16 of the range
+// (the extremes are rarely worth a palette entry) and flipped onto the
+// diagonal the colors actually follow
+void boundingBoxEndpoints(const Block& block, int* hi, int* lo) {
+    int minC[3] = {255, 255, 255}, maxC[3] = {0, 0, 0};
+    int mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < 3; k++) {
+            int v = block.rgb[i][k];
+            if (v < minC[k]) minC[k] = v;
+            if (v > maxC[k]) maxC[k] = v;
+            mean[k] += v;
+        }
+    }
+    // Sign of the covariance of red and blue with green decides the diagonal
+    int covR = 0, covB = 0;
+    for (int i = 0; i < 16; i++) {
+        int g = block.rgb[i][1] * 16 - mean[1];
+        covR += (block.rgb[i][0] * 16 - mean[0]) * g;
+        covB += (block.rgb[i][2] * 16 - mean[2]) * g;
+    }
+    for (int k = 0; k < 3; k++) {
+        int inset = (maxC[k] - minC[k]) >> 4;
+        hi[k] = maxC[k] - inset;
+        lo[k] = minC[k] + inset;
+    }
+    if (covR < 0) { int t = hi[0]; hi[0] = lo[0]; lo[0] = t; }
+    if (covB < 0) { int t = hi[2]; hi[2] = lo[2]; lo[2] = t; }
+}
+
+// Extremes of the block along its principal axis (power iteration on the
+// color covariance)
+void principalAxisEndpoints(const Block& block, int* hi, int* lo) {
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < 3; k++) mean[k] += block.rgb[i][k];
+    }
+    for (int k = 0; k < 3; k++) mean[k] /= 16.0f;
+
+    float cov[6] = {0, 0, 0, 0, 0, 0}; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; i++) {
+        float r = block.rgb[i][0] - mean[0], g = block.rgb[i][1] - mean[1], b = block.rgb[i][2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    float axis[3] = {0.9f, 1.0f, 0.7f};
+    for (int iteration = 0; iteration < 4; iteration++) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float m = x * x > y * y ? (x * x > z * z ? x : z) : (y * y > z * z ? y : z);
+        if (m == 0.0f) break; // flat block
+        axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+    }
+
+    float minT = 1e30f, maxT = -1e30f;
+    int minI = 0, maxI = 0;
+    for (int i = 0; i < 16; i++) {
+        float t = block.rgb[i][0] * axis[0] + block.rgb[i][1] * axis[1] + block.rgb[i][2] * axis[2];
+        if (t < minT) { minT = t; minI = i; }
+        if (t > maxT) { maxT = t; maxI = i; }
+    }
+    for (int k = 0; k < 3; k++) {
+        hi[k] = block.rgb[maxI][k];
+        lo[k] = block.rgb[minI][k];
+    }
+}
+
+// Least-squares endpoints for a fixed index assignment; false if degenerate
+bool refineEndpoints(const Block& block, uint32_t indices, int* hi, int* lo) {
+    static const float kWeight[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0, ab = 0, bb = 0;
+    float ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float a = kWeight[(indices >> (2 * i)) & 3];
+        float b = 1.0f - a;
+        aa += a * a; ab += a * b; bb += b * b;
+        for (int k = 0; k < 3; k++) {
+            ax[k] += a * block.rgb[i][k];
+            bx[k] += b * block.rgb[i][k];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (det < 1e-3f) return false;
+    for (int k = 0; k < 3; k++) {
+        hi[k] = (int)((ax[k] * bb - bx[k] * ab) / det + 0.5f);
+        lo[k] = (int)((bx[k] * aa - ax[k] * ab) / det + 0.5f);
+    }
+    return true;
+}
+
+void writeBlock(uint16_t c0, uint16_t c1, uint32_t indices, uint8_t* out) {
+    // Four-color mode needs color0 > color1: swap the endpoints and mirror
+    // the indices (0 <-> 1, 2 <-> 3). Equal endpoints select color0 only.
+    if (c0 < c1) {
+        uint16_t t = c0; c0 = c1; c1 = t;
+        indices ^= 0x55555555u;
+    } else if (c0 == c1) {
+        indices = 0;
+    }
+    out[0] = (uint8_t)c0; out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)c1; out[3] = (uint8_t)(c1 >> 8);
+    memcpy(out + 4, &indices, 4);
+}
+
+void encodeBlock(const Block& block, BC1Encoder::Quality quality, uint8_t* out) {
+    int hi[3], lo[3];
+    if (quality == BC1Encoder::HIGH) {
+        principalAxisEndpoints(block, hi, lo);
+    } else {
+        boundingBoxEndpoints(block, hi, lo);
+    }
+    uint16_t c0 = pack565(hi), c1 = pack565(lo);
+    // Palette math below assumes four-color order
+    if (c0 < c1) { uint16_t t = c0; c0 = c1; c1 = t; }
+    uint32_t indices;
+    if (quality == BC1Encoder::FAST) {
+        projectIndices(block, c0, c1, indices);
+        writeBlock(c0, c1, indices, out);
+        return;
+    }
+    int error = chooseIndices(block, c0, c1, indices);
+
+    if (error > 0 && c0 != c1 && refineEndpoints(block, indices, hi, lo)) {
+        uint16_t r0 = pack565(hi), r1 = pack565(lo);
+        if (r0 < r1) { uint16_t t = r0; r0 = r1; r1 = t; }
+        uint32_t refined;
+        if (r0 != r1) {
+            int refinedError = chooseIndices(block, r0, r1, refined);
+            if (refinedError < error) {
+                c0 = r0; c1 = r1; indices = refined;
+            }
+        }
+    }
+    writeBlock(c0, c1, indices, out);
+}
+
+} // namespace
+
+void decodeBC1(const uint8_t* blocks, int width, int height, uint8_t* rgba) {
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    for (int by = 0; by < blocksHigh; by++) {
+        for (int bx = 0; bx < blocksWide; bx++) {
+            const uint8_t* b = blocks + ((size_t)by * blocksWide + bx) * 8;
+            uint16_t c0 = (uint16_t)(b[0] | (b[1] << 8)), c1 = (uint16_t)(b[2] | (b[3] << 8));
+            uint32_t indices;
+            memcpy(&indices, b + 4, 4);
+            int colors[4][3];
+            if (c0 > c1) {
+                palette(c0, c1, colors);
+            } else {
+                unpack565(c0, colors[0]);
+                unpack565(c1, colors[1]);
+                for (int k = 0; k < 3; k++) {
+                    colors[2][k] = (colors[0][k] + colors[1][k]) / 2;
+                    colors[3][k] = 0; // transparent black, never written by the encoder
+                }
+            }
+            for (int i = 0; i < 16; i++) {
+                int x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+                if (x >= width || y >= height) continue;
+                const int* c = colors[(indices >> (2 * i)) & 3];
+                uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+                p[0] = (uint8_t)c[0];
+                p[1] = (uint8_t)c[1];
+                p[2] = (uint8_t)c[2];
+                p[3] = 255;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// BC1Encoder
+
+BC1Encoder::BC1Encoder()
+    : mInitialized(false)
+    , mJob(0)
+    , mBusyWorkers(0)
+    , mRunning(false)
+    , mSource(nullptr)
+    , mDest(nullptr)
+    , mWidth(0)
+    , mHeight(0)
+    , mNextRow(0)
+    , mLastEncodeMs(0.0)
+{}
+
+BC1Encoder::~BC1Encoder() {
+    shutdown();
+}
+
+bool BC1Encoder::init(const Config& config) {
+    shutdown();
+    mConfig = config;
+    if (mConfig.rowsPerTask < 1) mConfig.rowsPerTask = 1;
+    int threads = mConfig.threads > 0 ? mConfig.threads : (int)std::thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+
+    // The calling thread encodes too
+    mRunning = true;
+    for (int i = 1; i < threads; i++) {
+        mWorkers.emplace_back(&BC1Encoder::workerLoop, this);
+    }
+    mInitialized = true;
+    return true;
+}
+
+void BC1Encoder::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mRunning = false;
+    }
+    mWake.notify_all();
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        mWorkers[i].join();
+    }
+    mWorkers.clear();
+    mInitialized = false;
+}
+
+void BC1Encoder::encode(const uint8_t* rgba, int width, int height, uint8_t* dst) {
+    if (width <= 0 || height <= 0) return;
+    if (!mInitialized) init(mConfig);
+    int64_t start = steadyClockNs();
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mSource = rgba;
+        mDest = dst;
+        mWidth = width;
+        mHeight = height;
+        mNextRow = 0;
+        mBusyWorkers = (int)mWorkers.size();
+        mJob++;
+    }
+    mWake.notify_all();
+
+    encodeTasks();
+
+    std::unique_lock<std::mutex> lock(mLock);
+    mDone.wait(lock, [this] { return mBusyWorkers == 0; });
+    mLastEncodeMs = (steadyClockNs() - start) / 1e6;
+}
+
+void BC1Encoder::workerLoop() {
+    if (!mConfig.placement.isDefault()) mConfig.placement.apply("encode");
+
+    uint64_t seenJob = 0;
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mWake.wait(lock, [&] { return !mRunning || mJob != seenJob; });
+        if (!mRunning) return;
+        seenJob = mJob;
+
+        lock.unlock();
+        encodeTasks();
+        lock.lock();
+
+        if (--mBusyWorkers == 0) mDone.notify_one();
+    }
+}
+
+void BC1Encoder::encodeTasks() {
+    int blocksWide = (mWidth + 3) / 4, blocksHigh = (mHeight + 3) / 4;
+    Quality quality = mConfig.quality;
+    Block block;
+    while (true) {
+        int first = mNextRow.fetch_add(mConfig.rowsPerTask);
+        if (first >= blocksHigh) return;
+        int last = first + mConfig.rowsPerTask < blocksHigh ? first + mConfig.rowsPerTask : blocksHigh;
+        for (int by = first; by < last; by++) {
+            uint8_t* out = mDest + (size_t)by * blocksWide * 8;
+            for (int bx = 0; bx < blocksWide; bx++, out += 8) {
+                loadBlock(mSource, mWidth, mHeight, bx, by, block);
+                encodeBlock(block, quality, out);
+            }
+        }
+    }
+}
+
+} // namespace al
@@ -0,0 +1,262 @@
+#include "al_ext/replication/al_ThreadPlacement.hpp"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#include <fstream>
+#include <iostream>
+
+namespace al {
+
+namespace {
+
+#ifdef __linux__
+// Raw syscalls rather than libnuma, which is not installed on every node
+const int kMaxNumaNodes = 1024;
+
+long setMemoryPolicy(int mode, const unsigned long* nodes, unsigned long maxNode) {
+    return syscall(SYS_set_mempolicy, mode, nodes, maxNode);
+}
+
+long bindMemory(void* data, unsigned long bytes, int mode, const unsigned long* nodes,
+                unsigned long maxNode, unsigned flags) {
+    return syscall(SYS_mbind, data, bytes, mode, nodes, maxNode, flags);
+}
+
+bool nodeMask(int node, std::vector<unsigned long>& mask) {
+    if (node < 0 || node >= kMaxNumaNodes) return false;
+    const int bits = 8 * sizeof(unsigned long);
+    mask.assign(kMaxNumaNodes / bits, 0);
+    mask[node / bits] |= 1ul << (node % bits);
+    return true;
+}
+#endif
+
+bool parseInt(const std::string& text, int& value) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (*end != '\0') return false;
+    value = (int)parsed;
+    return true;
+}
+
+std::string trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return std::string();
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (true) {
+        size_t end = text.find(separator, start);
+        parts.push_back(trim(text.substr(start, end == std::string::npos ? std::string::npos : end - start)));
+        if (end == std::string::npos) return parts;
+        start = end + 1;
+    }
+}
+
+} // namespace
+
+bool parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    std::vector<int> parsed;
+    std::vector<std::string> ranges = split(trim(text), ',');
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (ranges[i].empty()) continue;
+        size_t dash = ranges[i].find('-');
+        int first, last;
+        if (dash == std::string::npos) {
+            if (!parseInt(ranges[i], first)) return false;
+            last = first;
+        } else if (!parseInt(trim(ranges[i].substr(0, dash)), first) ||
+                   !parseInt(trim(ranges[i].substr(dash + 1)), last)) {
+            return false;
+        }
+        if (first < 0 || last < first) return false;
+        for (int cpu = first; cpu <= last; cpu++) parsed.push_back(cpu);
+    }
+    cpus.swap(parsed);
+    return true;
+}
+
+std::vector<int> numaNodeCpus(int node) {
+    std::vector<int> cpus;
+    if (node < 0) return cpus;
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string line;
+    if (file && std::getline(file, line)) parseCpuList(line, cpus);
+    return cpus;
+}
+
+bool bindToNumaNode(void* data, size_t bytes, int node) {
+#ifdef __linux__
+    std::vector<unsigned long> mask;
+    if (!data || bytes == 0 || !nodeMask(node, mask)) return false;
+    // mbind works on whole pages
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)data & ~(page - 1);
+    uintptr_t last = ((uintptr_t)data + bytes + page - 1) & ~(page - 1);
+    if (bindMemory((void*)first, last - first, MPOL_PREFERRED, mask.data(),
+                   kMaxNumaNodes, MPOL_MF_MOVE) != 0) {
+        std::cerr << "Could not move buffer to NUMA node " << node << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)data; (void)bytes; (void)node;
+    return false;
+#endif
+}
+
+bool ThreadPlacement::apply(const char* threadName) const {
+    bool ok = true;
+    const char* name = threadName ? threadName : "thread";
+#ifdef __linux__
+    if (threadName) {
+        char truncated[16];
+        strncpy(truncated, threadName, sizeof(truncated) - 1);
+        truncated[sizeof(truncated) - 1] = '\0';
+        pthread_setname_np(pthread_self(), truncated);
+    }
+
+    std::vector<int> allowed = cpus.empty() ? numaNodeCpus(numaNode) : cpus;
+    if (!allowed.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < allowed.size(); i++) {
+            if (allowed[i] < CPU_SETSIZE) CPU_SET(allowed[i], &set);
+        }
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (result != 0) {
+            std::cerr << "Could not set CPU affinity of " << name << ": " << strerror(result) << std::endl;
+            ok = false;
+        }
+    } else if (numaNode >= 0) {
+        std::cerr << "NUMA node " << numaNode << " for " << name << " has no CPUs" << std::endl;
+        ok = false;
+    }
+
+    if (numaNode >= 0) {
+        // Preferred rather than bound, so allocations fall back to other
+        // nodes instead of failing when the local one is full
+        std::vector<unsigned long> mask;
+        if (!nodeMask(numaNode, mask) ||
+            setMemoryPolicy(MPOL_PREFERRED, mask.data(), kMaxNumaNodes) != 0) {
+            std::cerr << "Could not set NUMA memory policy of " << name << ": " << strerror(errno) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (nice != 0 && fifoPriority <= 0) {
+        // On Linux nice is per thread, addressed by thread id
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) != 0) {
+            std::cerr << "Could not set nice " << nice << " for " << name << ": " << strerror(errno) << std::endl;
+            ok = false;
+        }
+    }
+#else
+    if (!cpus.empty() || numaNode >= 0 || nice != 0) {
+        std::cerr << "CPU affinity, NUMA and nice placement are only supported on Linux" << std::endl;
+        ok = false;
+    }
+#endif
+
+    if (fifoPriority > 0) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = fifoPriority;
+        int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (result != 0) {
+            std::cerr << "Could not run " << name << " as SCHED_FIFO " << fifoPriority << ": "
+                      << strerror(result) << " (needs CAP_SYS_NICE or an rtprio limit)" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+const char* ThreadPlacementConfig::roleName(Role role) {
+    switch (role) {
+        case RENDER: return "render";
+        case AUDIO: return "audio";
+        case CAPTURE: return "capture";
+        case REPLICATION_SEND: return "replication_send";
+        case REPLICATION_RECEIVE: return "replication_receive";
+        case ENCODE: return "encode";
+        default: return "unknown";
+    }
+}
+
+bool ThreadPlacementConfig::parse(const std::string& spec) {
+    ThreadPlacement roles[ROLE_COUNT];
+    for (int i = 0; i < ROLE_COUNT; i++) roles[i] = mRoles[i];
+
+    std::vector<std::string> entries = split(spec, ';');
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].empty()) continue;
+        size_t colon = entries[i].find(':');
+        std::string roleText = trim(entries[i].substr(0, colon));
+        int role = 0;
+        while (role < ROLE_COUNT && roleText != roleName((Role)role)) role++;
+        if (role == ROLE_COUNT) {
+            std::cerr << "Unknown thread role '" << roleText << "'" << std::endl;
+            return false;
+        }
+
+        ThreadPlacement placement;
+        if (colon != std::string::npos) {
+            // "cpus=0-3,8" contains commas, so a key starts only at "name="
+            std::string fields = entries[i].substr(colon + 1);
+            std::string key, value;
+            std::vector<std::string> parts = split(fields, ',');
+            for (size_t p = 0; p <= parts.size(); p++) {
+                bool newKey = p < parts.size() && parts[p].find('=') != std::string::npos;
+                if ((newKey || p == parts.size()) && !key.empty()) {
+                    bool valid;
+                    if (key == "cpus") valid = parseCpuList(value, placement.cpus);
+                    else if (key == "fifo") valid = parseInt(value, placement.fifoPriority);
+                    else if (key == "nice") valid = parseInt(value, placement.nice);
+                    else if (key == "node") valid = parseInt(value, placement.numaNode);
+                    else valid = false;
+                    if (!valid) {
+                        std::cerr << "Invalid thread placement '" << key << "=" << value
+                                  << "' for " << roleText << std::endl;
+                        return false;
+                    }
+                    key.clear();
+                }
+                if (p == parts.size() || parts[p].empty()) continue;
+                if (newKey) {
+                    size_t equals = parts[p].find('=');
+                    key = trim(parts[p].substr(0, equals));
+                    value = trim(parts[p].substr(equals + 1));
+                } else if (!key.empty()) {
+                    value += "," + parts[p];
+                } else {
+                    std::cerr << "Invalid thread placement '" << parts[p] << "' for " << roleText << std::endl;
+                    return false;
+                }
+            }
+        }
+        roles[role] = placement;
+    }
+
+    for (int i = 0; i < ROLE_COUNT; i++) mRoles[i] = roles[i];
+    return true;
+}
+
+} // namespace al
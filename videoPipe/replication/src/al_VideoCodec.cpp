@@ -0,0 +1,851 @@
+#include "al_ext/replication/al_VideoCodec.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iostream>
+
+#ifdef AL_HAVE_LIBAVCODEC
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/log.h>
+#include <libavutil/opt.h>
+}
+#endif
+
+namespace al {
+
+namespace {
+
+// Chroma row pairs a conversion thread claims at a time
+const int kPairsPerTask = 8;
+// Coded frames kept for receive() before the oldest is discarded
+const size_t kMaxOutputPackets = 8;
+// Recycled buffers kept per coder
+const size_t kMaxSpare = 4;
+
+// Adds bytes to a one-second window; returns the window's Mbit/s when it
+// closes, -1 while it is open
+double rateWindow(int64_t& windowNs, uint64_t& windowBytes, size_t bytes, int64_t nowNs) {
+    if (windowNs == 0) windowNs = nowNs;
+    windowBytes += bytes;
+    double seconds = (nowNs - windowNs) / 1e9;
+    if (seconds < 1.0) return -1.0;
+    double mbps = windowBytes * 8.0 / 1e6 / seconds;
+    windowNs = nowNs;
+    windowBytes = 0;
+    return mbps;
+}
+
+#ifdef AL_HAVE_LIBAVCODEC
+double smooth(double average, double sample) {
+    return average > 0.0 ? average + 0.1 * (sample - average) : sample;
+}
+
+uint8_t clamp8(int v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// BT.709 limited range, the same coefficients as the NDI format
+// conversions. Converts luma row pairs [firstPair, lastPair) of a frame
+// padded to codedWidth x codedHeight (both even) by repeating the edges.
+void rgbaToYUV420(const uint8_t* rgba, int width, int height, int codedWidth,
+                  uint8_t* y, int yStride, uint8_t* u, int uStride, uint8_t* v, int vStride,
+                  int firstPair, int lastPair) {
+    for (int pair = firstPair; pair < lastPair; pair++) {
+        const uint8_t* rows[2];
+        for (int r = 0; r < 2; r++) {
+            rows[r] = rgba + (size_t)std::min(pair * 2 + r, height - 1) * width * 4;
+        }
+        uint8_t* yRows[2] = {y + (size_t)pair * 2 * yStride, y + ((size_t)pair * 2 + 1) * yStride};
+        uint8_t* uRow = u + (size_t)pair * uStride;
+        uint8_t* vRow = v + (size_t)pair * vStride;
+        for (int x = 0; x < codedWidth; x += 2) {
+            int r = 0, g = 0, b = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    const uint8_t* p = rows[dy] + (size_t)std::min(x + dx, width - 1) * 4;
+                    yRows[dy][x + dx] = (uint8_t)(((47 * p[0] + 157 * p[1] + 16 * p[2] + 128) >> 8) + 16);
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+            }
+            uRow[x / 2] = clamp8(((-26 * r - 87 * g + 112 * b) / 4 + 128) / 256 + 128);
+            vRow[x / 2] = clamp8(((112 * r - 102 * g - 10 * b) / 4 + 128) / 256 + 128);
+        }
+    }
+}
+
+// Inverse of rgbaToYUV420 for the visible width x height
+void yuv420ToRGBA(const uint8_t* y, int yStride, const uint8_t* u, int uStride,
+                  const uint8_t* v, int vStride, int width, int height, uint8_t* rgba,
+                  int firstPair, int lastPair) {
+    for (int pair = firstPair; pair < lastPair; pair++) {
+        const uint8_t* uRow = u + (size_t)pair * uStride;
+        const uint8_t* vRow = v + (size_t)pair * vStride;
+        for (int row = pair * 2; row < pair * 2 + 2 && row < height; row++) {
+            const uint8_t* yRow = y + (size_t)row * yStride;
+            uint8_t* out = rgba + (size_t)row * width * 4;
+            for (int x = 0; x < width; x++, out += 4) {
+                int c = 298 * (yRow[x] - 16) + 128;
+                int d = uRow[x / 2] - 128;
+                int e = vRow[x / 2] - 128;
+                out[0] = clamp8((c + 459 * e) >> 8);
+                out[1] = clamp8((c - 55 * d - 136 * e) >> 8);
+                out[2] = clamp8((c + 541 * d) >> 8);
+                out[3] = 255;
+            }
+        }
+    }
+}
+
+AVCodecID codecId(uint8_t codec) {
+    switch (codec) {
+    case VideoEncoder::H264: return AV_CODEC_ID_H264;
+    case VideoEncoder::HEVC: return AV_CODEC_ID_HEVC;
+    case VideoEncoder::MPEG4: return AV_CODEC_ID_MPEG4;
+    default: return AV_CODEC_ID_NONE;
+    }
+}
+
+std::string errorString(int error) {
+    char text[AV_ERROR_MAX_STRING_SIZE] = {};
+    av_strerror(error, text, sizeof(text));
+    return text;
+}
+#endif
+
+} // namespace
+
+class VideoRowPool {
+public:
+    VideoRowPool(int threads, const ThreadPlacement& placement, const char* name)
+        : mPlacement(placement), mName(name), mJob(0), mBusyWorkers(0), mRunning(true)
+        , mTask(nullptr), mRows(0), mNextRow(0) {
+        if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+        // The calling thread converts too
+        for (int i = 1; i < threads; i++) {
+            mWorkers.emplace_back(&VideoRowPool::workerLoop, this);
+        }
+    }
+
+    ~VideoRowPool() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mRunning = false;
+        }
+        mWake.notify_all();
+        for (size_t i = 0; i < mWorkers.size(); i++) {
+            mWorkers[i].join();
+        }
+    }
+
+    // Calls task(first, last) over bands of [0, rows) until every row is
+    // done, on the workers and the calling thread
+    void run(int rows, const std::function<void(int, int)>& task) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mTask = &task;
+            mRows = rows;
+            mNextRow = 0;
+            mBusyWorkers = (int)mWorkers.size();
+            mJob++;
+        }
+        mWake.notify_all();
+
+        runTasks();
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mDone.wait(lock, [this] { return mBusyWorkers == 0; });
+        mTask = nullptr;
+    }
+
+private:
+    void workerLoop() {
+        if (!mPlacement.isDefault()) mPlacement.apply(mName);
+
+        uint64_t seenJob = 0;
+        std::unique_lock<std::mutex> lock(mLock);
+        while (true) {
+            mWake.wait(lock, [&] { return !mRunning || mJob != seenJob; });
+            if (!mRunning) return;
+            seenJob = mJob;
+
+            lock.unlock();
+            runTasks();
+            lock.lock();
+
+            if (--mBusyWorkers == 0) mDone.notify_one();
+        }
+    }
+
+    void runTasks() {
+        while (true) {
+            int first = mNextRow.fetch_add(kPairsPerTask);
+            if (first >= mRows) return;
+            (*mTask)(first, std::min(first + kPairsPerTask, mRows));
+        }
+    }
+
+    ThreadPlacement mPlacement;
+    const char* mName;
+    std::vector<std::thread> mWorkers;
+
+    // Current job, published to the workers under mLock
+    std::mutex mLock;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    uint64_t mJob;
+    int mBusyWorkers;
+    bool mRunning;
+    const std::function<void(int, int)>* mTask;
+    int mRows;
+    std::atomic<int> mNextRow;
+};
+
+bool VideoEncoder::available() {
+#ifdef AL_HAVE_LIBAVCODEC
+    return true;
+#else
+    return false;
+#endif
+}
+
+VideoEncoder::VideoEncoder()
+    : mInitialized(false)
+    , mContext(nullptr)
+    , mPacket(nullptr)
+    , mCodecWidth(0)
+    , mCodecHeight(0)
+    , mPts(0)
+    , mSequence(0)
+    , mRunning(false)
+    , mStats()
+    , mRateWindowNs(0)
+    , mRateWindowBytes(0)
+{}
+
+VideoEncoder::~VideoEncoder() {
+    shutdown();
+}
+
+bool VideoEncoder::init(const Config& config) {
+    shutdown();
+#ifndef AL_HAVE_LIBAVCODEC
+    (void)config;
+    std::cerr << "Video compression unavailable: al_replication was built without libavcodec" << std::endl;
+    return false;
+#else
+    // libav and the encoders it wraps print banners and stream details at
+    // info level; keep the show console to errors (the level is process-wide)
+    av_log_set_level(AV_LOG_ERROR);
+    mConfig = config;
+    if (mConfig.pipelineDepth < 1) mConfig.pipelineDepth = 1;
+    if (mConfig.keyframeInterval < 1) mConfig.keyframeInterval = 1;
+    if (mConfig.frameRate < 1) mConfig.frameRate = 60;
+    if (!avcodec_find_encoder(codecId(mConfig.codec))) {
+        std::cerr << "This libavcodec has no encoder for video codec " << (int)mConfig.codec << std::endl;
+        return false;
+    }
+
+    mPacket = av_packet_alloc();
+    // One slot converting in submit(), pipelineDepth queued for the coder
+    mSlots.resize(mConfig.pipelineDepth + 1);
+    for (size_t i = 0; i < mSlots.size(); i++) {
+        mSlots[i].frame = av_frame_alloc();
+        mFree.push_back((int)i);
+    }
+    if (!mPacket || !mSlots.back().frame) {
+        std::cerr << "Could not allocate video encoder frames" << std::endl;
+        shutdown();
+        return false;
+    }
+    mPool.reset(new VideoRowPool(mConfig.threads, mConfig.placement, "encode"));
+    mStats = Stats();
+    mRunning = true;
+    mThread = std::thread(&VideoEncoder::encodeLoop, this);
+    mInitialized = true;
+    return true;
+#endif
+}
+
+void VideoEncoder::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mRunning = false;
+    }
+    mWake.notify_all();
+    if (mThread.joinable()) mThread.join();
+    closeCodec();
+#ifdef AL_HAVE_LIBAVCODEC
+    for (size_t i = 0; i < mSlots.size(); i++) {
+        av_frame_free(&mSlots[i].frame);
+    }
+    av_packet_free(&mPacket);
+#endif
+    mSlots.clear();
+    mFree.clear();
+    mQueued.clear();
+    mOutput.clear();
+    mSpare.clear();
+    mPool.reset();
+    mInitialized = false;
+}
+
+bool VideoEncoder::submit(const uint8_t* rgba, int width, int height, uint32_t generation,
+                          int64_t timestampNs, const uint8_t* metadata, size_t metadataBytes) {
+    if (!mInitialized || !rgba || width <= 0 || height <= 0) return false;
+#ifndef AL_HAVE_LIBAVCODEC
+    (void)generation;
+    (void)timestampNs;
+    (void)metadata;
+    (void)metadataBytes;
+    return false;
+#else
+    int64_t start = steadyClockNs();
+    int index;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStats.framesSubmitted++;
+        if (mFree.empty()) {
+            mStats.framesDropped++;
+            return false;
+        }
+        index = mFree.front();
+        mFree.pop_front();
+    }
+
+    // 4:2:0 needs even dimensions; the padding repeats the edge pixels
+    Slot& slot = mSlots[index];
+    AVFrame* f = slot.frame;
+    int codedWidth = (width + 1) & ~1;
+    int codedHeight = (height + 1) & ~1;
+    int ok;
+    if (f->width != codedWidth || f->height != codedHeight || !f->data[0]) {
+        av_frame_unref(f);
+        f->format = AV_PIX_FMT_YUV420P;
+        f->width = codedWidth;
+        f->height = codedHeight;
+        ok = av_frame_get_buffer(f, 32);
+    } else {
+        // Planes the coder still references are replaced, not overwritten
+        ok = av_frame_make_writable(f);
+    }
+    if (ok < 0) {
+        std::cerr << "Could not allocate a video frame: " << errorString(ok) << std::endl;
+        std::lock_guard<std::mutex> lock(mLock);
+        mFree.push_back(index);
+        return false;
+    }
+
+    std::function<void(int, int)> convert = [&](int first, int last) {
+        rgbaToYUV420(rgba, width, height, codedWidth, f->data[0], f->linesize[0],
+                     f->data[1], f->linesize[1], f->data[2], f->linesize[2], first, last);
+    };
+    mPool->run(codedHeight / 2, convert);
+
+    FrameInfo& info = slot.info;
+    info.width = width;
+    info.height = height;
+    info.generation = generation;
+    info.timestampNs = timestampNs ? timestampNs : frameClockNs();
+    info.submittedNs = start;
+    if (!metadata) metadataBytes = 0;
+    info.metadata.assign(metadata, metadata + metadataBytes);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mQueued.push_back(index);
+        mStats.convertMs = (steadyClockNs() - start) / 1e6;
+    }
+    mWake.notify_one();
+    return true;
+#endif
+}
+
+bool VideoEncoder::receive(Packet& packet) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mOutput.empty()) return false;
+    std::swap(packet, mOutput.front());
+    // The caller's previous buffers are reused for a later packet
+    if (mSpare.size() < kMaxSpare) mSpare.push_back(std::move(mOutput.front()));
+    mOutput.pop_front();
+    return true;
+}
+
+VideoEncoder::Stats VideoEncoder::stats() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mStats;
+}
+
+void VideoEncoder::encodeLoop() {
+    if (!mConfig.placement.isDefault()) mConfig.placement.apply("encode");
+
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mWake.wait(lock, [this] { return !mRunning || !mQueued.empty(); });
+        if (!mRunning) return;
+        int index = mQueued.front();
+        mQueued.pop_front();
+
+        lock.unlock();
+        encodeSlot(mSlots[index]);
+        lock.lock();
+
+        mFree.push_back(index);
+    }
+}
+
+bool VideoEncoder::openCodec(int width, int height) {
+#ifdef AL_HAVE_LIBAVCODEC
+    closeCodec();
+    const AVCodec* codec = avcodec_find_encoder(codecId(mConfig.codec));
+    if (!codec) return false;
+    mContext = avcodec_alloc_context3(codec);
+    if (!mContext) return false;
+
+    AVCodecContext* c = mContext;
+    c->width = (width + 1) & ~1;
+    c->height = (height + 1) & ~1;
+    c->pix_fmt = AV_PIX_FMT_YUV420P;
+    c->color_range = AVCOL_RANGE_MPEG;
+    c->colorspace = AVCOL_SPC_BT709;
+    c->color_primaries = AVCOL_PRI_BT709;
+    c->color_trc = AVCOL_TRC_BT709;
+    c->time_base.num = 1;
+    c->time_base.den = mConfig.frameRate;
+    c->framerate.num = mConfig.frameRate;
+    c->framerate.den = 1;
+    c->bit_rate = (int64_t)mConfig.bitrateKbps * 1000;
+    // Cap the rate over half a second, so a keyframe cannot burst the link.
+    // The cap sits a quarter above the average: mpegvideo's rate control
+    // rejects a ceiling equal to the target as impossible to meet.
+    c->rc_max_rate = c->bit_rate + c->bit_rate / 4;
+    c->rc_buffer_size = (int)std::min<int64_t>(c->rc_max_rate / 2, 0x7FFFFFFF);
+    c->gop_size = mConfig.keyframeInterval;
+    c->max_b_frames = 0; // B-frames would hold pictures back for reordering
+    c->thread_count = mConfig.codecThreads;
+    c->thread_type = FF_THREAD_SLICE; // frame threads add a frame of latency each
+    // Options of the x264/x265 wrappers; other encoders ignore them
+    av_opt_set(c->priv_data, "preset", mConfig.preset.c_str(), 0);
+    av_opt_set(c->priv_data, "tune", "zerolatency", 0);
+    // x265 logs through its own printer rather than av_log
+    av_opt_set(c->priv_data, "x265-params", "log-level=error", 0);
+
+    int error = avcodec_open2(c, codec, nullptr);
+    if (error < 0) {
+        std::cerr << "Could not open " << codec->name << " for " << width << "x" << height
+                  << ": " << errorString(error) << std::endl;
+        avcodec_free_context(&mContext);
+        return false;
+    }
+    mCodecWidth = width;
+    mCodecHeight = height;
+    mPts = 0;
+    return true;
+#else
+    (void)width;
+    (void)height;
+    return false;
+#endif
+}
+
+void VideoEncoder::closeCodec() {
+#ifdef AL_HAVE_LIBAVCODEC
+    avcodec_free_context(&mContext);
+#endif
+    mContext = nullptr;
+    mCodecWidth = 0;
+    mCodecHeight = 0;
+    mInFlight.clear();
+}
+
+void VideoEncoder::encodeSlot(Slot& slot) {
+#ifdef AL_HAVE_LIBAVCODEC
+    // A new size starts a new stream, which opens with a keyframe
+    if (!mContext || slot.info.width != mCodecWidth || slot.info.height != mCodecHeight) {
+        if (!openCodec(slot.info.width, slot.info.height)) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mStats.framesDropped++;
+            return;
+        }
+    }
+
+    int64_t start = steadyClockNs();
+    slot.frame->pts = mPts++;
+    int error = avcodec_send_frame(mContext, slot.frame);
+    if (error < 0) {
+        std::cerr << "Video encoding failed: " << errorString(error) << std::endl;
+        std::lock_guard<std::mutex> lock(mLock);
+        mStats.framesDropped++;
+        return;
+    }
+    slot.info.pts = slot.frame->pts;
+    mInFlight.push_back(std::move(slot.info));
+    drainPackets(start);
+#else
+    (void)slot;
+#endif
+}
+
+void VideoEncoder::drainPackets(int64_t startNs) {
+#ifdef AL_HAVE_LIBAVCODEC
+    while (avcodec_receive_packet(mContext, mPacket) == 0) {
+        // Without B-frames packets come out in submission order; frames the
+        // encoder skipped have no packet
+        while (!mInFlight.empty() && mInFlight.front().pts < mPacket->pts) {
+            mInFlight.pop_front();
+        }
+        if (mInFlight.empty() || mInFlight.front().pts != mPacket->pts) {
+            av_packet_unref(mPacket);
+            continue;
+        }
+        FrameInfo& info = mInFlight.front();
+        int64_t now = steadyClockNs();
+
+        Packet packet;
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            if (!mSpare.empty()) {
+                std::swap(packet, mSpare.back());
+                mSpare.pop_back();
+            }
+        }
+        VideoPacketHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic = kVideoPacketMagic;
+        h.codec = mConfig.codec;
+        h.flags = (mPacket->flags & AV_PKT_FLAG_KEY) ? VideoPacketHeader::KEYFRAME : 0;
+        h.sequence = mSequence++;
+        h.bytes = (uint32_t)mPacket->size;
+        packet.data.resize(sizeof(h) + mPacket->size);
+        memcpy(packet.data.data(), &h, sizeof(h));
+        memcpy(packet.data.data() + sizeof(h), mPacket->data, mPacket->size);
+        packet.metadata.swap(info.metadata);
+        packet.width = info.width;
+        packet.height = info.height;
+        packet.generation = info.generation;
+        packet.timestampNs = info.timestampNs;
+        packet.keyframe = h.flags != 0;
+        int64_t submittedNs = info.submittedNs;
+        mInFlight.pop_front();
+        av_packet_unref(mPacket);
+
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mOutput.size() >= kMaxOutputPackets) {
+            mOutput.pop_front();
+            mStats.framesDropped++;
+        }
+        mOutput.push_back(std::move(packet));
+        mStats.framesEncoded++;
+        if (h.flags) mStats.keyframes++;
+        mStats.bytesEncoded += mOutput.back().data.size();
+        mStats.encodeMs = (now - startNs) / 1e6;
+        mStats.latencyMs = smooth(mStats.latencyMs, (now - submittedNs) / 1e6);
+        double mbps = rateWindow(mRateWindowNs, mRateWindowBytes, mOutput.back().data.size(), now);
+        if (mbps >= 0.0) mStats.bitrateMbps = mbps;
+    }
+#else
+    (void)startNs;
+#endif
+}
+
+VideoDecoder::VideoDecoder()
+    : mInitialized(false)
+    , mContext(nullptr)
+    , mFrame(nullptr)
+    , mPacket(nullptr)
+    , mCodec(0)
+    , mHaveSequence(false)
+    , mNextSequence(0)
+    , mWaitingForKeyframe(true)
+    , mPts(0)
+    , mRunning(false)
+    , mReadyIsNew(false)
+    , mStats()
+    , mRateWindowNs(0)
+    , mRateWindowBytes(0)
+{}
+
+VideoDecoder::~VideoDecoder() {
+    shutdown();
+}
+
+bool VideoDecoder::init(const Config& config) {
+    shutdown();
+#ifndef AL_HAVE_LIBAVCODEC
+    (void)config;
+    std::cerr << "Video decompression unavailable: al_replication was built without libavcodec" << std::endl;
+    return false;
+#else
+    av_log_set_level(AV_LOG_ERROR); // see VideoEncoder::init
+    mConfig = config;
+    if (mConfig.queueDepth < 1) mConfig.queueDepth = 1;
+    mFrame = av_frame_alloc();
+    mPacket = av_packet_alloc();
+    if (!mFrame || !mPacket) {
+        std::cerr << "Could not allocate video decoder frames" << std::endl;
+        shutdown();
+        return false;
+    }
+    mPool.reset(new VideoRowPool(mConfig.threads, mConfig.placement, "decode"));
+    mStats = Stats();
+    mCodec = 0;
+    mHaveSequence = false;
+    mWaitingForKeyframe = true;
+    mRunning = true;
+    mThread = std::thread(&VideoDecoder::decodeLoop, this);
+    mInitialized = true;
+    return true;
+#endif
+}
+
+void VideoDecoder::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mRunning = false;
+    }
+    mWake.notify_all();
+    if (mThread.joinable()) mThread.join();
+    closeCodec();
+#ifdef AL_HAVE_LIBAVCODEC
+    av_frame_free(&mFrame);
+    av_packet_free(&mPacket);
+#endif
+    mQueue.clear();
+    mSpare.clear();
+    mReadyIsNew = false;
+    mPool.reset();
+    mInitialized = false;
+}
+
+bool VideoDecoder::submit(const ReplicatedFrame& frame) {
+    if (!mInitialized || frame.format != ReplicatedFrame::VIDEO || !frame.data) return false;
+    VideoPacketHeader h;
+    if (frame.bytes < sizeof(h)) return false;
+    memcpy(&h, frame.data, sizeof(h));
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mStats.packetsSubmitted++;
+    if (h.magic != kVideoPacketMagic || h.bytes > frame.bytes - sizeof(h) ||
+        frame.width <= 0 || frame.height <= 0) {
+        mStats.packetsDropped++;
+        return false;
+    }
+    // The gap this leaves in the sequence makes the decoder wait for a keyframe
+    if ((int)mQueue.size() >= mConfig.queueDepth) {
+        if (mSpare.size() < kMaxSpare) mSpare.push_back(std::move(mQueue.front()));
+        mQueue.pop_front();
+        mStats.packetsDropped++;
+    }
+
+    Input input;
+    if (!mSpare.empty()) {
+        std::swap(input, mSpare.back());
+        mSpare.pop_back();
+    }
+    input.data.assign(frame.data, frame.data + sizeof(h) + h.bytes);
+    if (frame.metadata) {
+        input.metadata.assign(frame.metadata, frame.metadata + frame.metadataBytes);
+    } else {
+        input.metadata.clear();
+    }
+    input.width = frame.width;
+    input.height = frame.height;
+    input.generation = frame.generation;
+    input.timestampNs = frame.timestampNs;
+    input.submittedNs = steadyClockNs();
+    double mbps = rateWindow(mRateWindowNs, mRateWindowBytes, frame.bytes, input.submittedNs);
+    mQueue.push_back(std::move(input));
+    mStats.bytesReceived += frame.bytes;
+    if (mbps >= 0.0) mStats.bitrateMbps = mbps;
+    mWake.notify_one();
+    return true;
+}
+
+bool VideoDecoder::latestFrame(ReplicatedFrame& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mReadyIsNew) return false;
+        std::swap(mReady, mFront);
+        mReadyIsNew = false;
+    }
+    frame.data = mFront.rgba.data();
+    frame.bytes = mFront.rgba.size();
+    frame.metadata = mFront.metadata.empty() ? nullptr : mFront.metadata.data();
+    frame.metadataBytes = mFront.metadata.size();
+    frame.width = mFront.width;
+    frame.height = mFront.height;
+    frame.format = ReplicatedFrame::RGBA8;
+    frame.generation = mFront.generation;
+    frame.timestampNs = mFront.timestampNs;
+    frame.receivedNs = mFront.receivedNs;
+    return true;
+}
+
+VideoDecoder::Stats VideoDecoder::stats() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mStats;
+}
+
+void VideoDecoder::decodeLoop() {
+    if (!mConfig.placement.isDefault()) mConfig.placement.apply("decode");
+
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mWake.wait(lock, [this] { return !mRunning || !mQueue.empty(); });
+        if (!mRunning) return;
+        Input input = std::move(mQueue.front());
+        mQueue.pop_front();
+
+        lock.unlock();
+        decodeInput(input);
+        lock.lock();
+
+        if (mSpare.size() < kMaxSpare) mSpare.push_back(std::move(input));
+    }
+}
+
+void VideoDecoder::decodeInput(Input& input) {
+#ifdef AL_HAVE_LIBAVCODEC
+    VideoPacketHeader h;
+    memcpy(&h, input.data.data(), sizeof(h));
+    bool keyframe = (h.flags & VideoPacketHeader::KEYFRAME) != 0;
+
+    // A lost packet leaves every picture up to the next keyframe without
+    // its reference; showing them would smear the image
+    if (mHaveSequence && h.sequence != mNextSequence) mWaitingForKeyframe = true;
+    mHaveSequence = true;
+    mNextSequence = h.sequence + 1;
+
+    if (h.codec != mCodec) {
+        closeCodec();
+        mCodec = h.codec;
+        openCodec(h.codec);
+        mWaitingForKeyframe = true;
+    }
+    if (!mContext || (mWaitingForKeyframe && !keyframe)) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStats.packetsSkipped++;
+        return;
+    }
+    mWaitingForKeyframe = false;
+
+    // Not reference counted, so libavcodec copies what it keeps
+    int64_t start = steadyClockNs();
+    mPacket->data = input.data.data() + sizeof(h);
+    mPacket->size = (int)h.bytes;
+    mPacket->pts = mPts++;
+    mPacket->flags = keyframe ? AV_PKT_FLAG_KEY : 0;
+    int error = avcodec_send_packet(mContext, mPacket);
+    int64_t pts = mPacket->pts;
+    mPacket->data = nullptr;
+    mPacket->size = 0;
+    if (error < 0) {
+        mWaitingForKeyframe = true;
+        std::lock_guard<std::mutex> lock(mLock);
+        mStats.packetsSkipped++;
+        return;
+    }
+
+    mInFlight.push_back(FrameInfo());
+    FrameInfo& info = mInFlight.back();
+    info.pts = pts;
+    info.width = input.width;
+    info.height = input.height;
+    info.generation = input.generation;
+    info.timestampNs = input.timestampNs;
+    info.submittedNs = input.submittedNs;
+    info.metadata.swap(input.metadata);
+    drainFrames(start);
+#else
+    (void)input;
+#endif
+}
+
+bool VideoDecoder::openCodec(uint8_t codec) {
+#ifdef AL_HAVE_LIBAVCODEC
+    const AVCodec* decoder = avcodec_find_decoder(codecId(codec));
+    if (!decoder) {
+        std::cerr << "This libavcodec has no decoder for video codec " << (int)codec << std::endl;
+        return false;
+    }
+    mContext = avcodec_alloc_context3(decoder);
+    if (!mContext) return false;
+    mContext->thread_count = mConfig.codecThreads;
+    mContext->thread_type = FF_THREAD_SLICE;
+    mContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    int error = avcodec_open2(mContext, decoder, nullptr);
+    if (error < 0) {
+        std::cerr << "Could not open " << decoder->name << ": " << errorString(error) << std::endl;
+        avcodec_free_context(&mContext);
+        return false;
+    }
+    mPts = 0;
+    return true;
+#else
+    (void)codec;
+    return false;
+#endif
+}
+
+void VideoDecoder::closeCodec() {
+#ifdef AL_HAVE_LIBAVCODEC
+    avcodec_free_context(&mContext);
+#endif
+    mContext = nullptr;
+    mInFlight.clear();
+}
+
+void VideoDecoder::drainFrames(int64_t startNs) {
+#ifdef AL_HAVE_LIBAVCODEC
+    while (avcodec_receive_frame(mContext, mFrame) == 0) {
+        int64_t pts = mFrame->pts != AV_NOPTS_VALUE ? mFrame->pts : mFrame->best_effort_timestamp;
+        while (!mInFlight.empty() && mInFlight.front().pts < pts) mInFlight.pop_front();
+        bool planar = mFrame->format == AV_PIX_FMT_YUV420P || mFrame->format == AV_PIX_FMT_YUVJ420P;
+        if (mInFlight.empty() || mInFlight.front().pts != pts || !planar) {
+            av_frame_unref(mFrame);
+            continue;
+        }
+        FrameInfo& info = mInFlight.front();
+        int64_t decoded = steadyClockNs();
+
+        int width = std::min(info.width, mFrame->width);
+        int height = std::min(info.height, mFrame->height);
+        mDecoded.rgba.resize((size_t)width * height * 4);
+        AVFrame* f = mFrame;
+        uint8_t* rgba = mDecoded.rgba.data();
+        std::function<void(int, int)> convert = [&](int first, int last) {
+            yuv420ToRGBA(f->data[0], f->linesize[0], f->data[1], f->linesize[1],
+                         f->data[2], f->linesize[2], width, height, rgba, first, last);
+        };
+        mPool->run((height + 1) / 2, convert);
+        av_frame_unref(mFrame);
+
+        int64_t now = steadyClockNs();
+        mDecoded.metadata.swap(info.metadata);
+        mDecoded.width = width;
+        mDecoded.height = height;
+        mDecoded.generation = info.generation;
+        mDecoded.timestampNs = info.timestampNs;
+        mDecoded.receivedNs = frameClockNs();
+        int64_t submittedNs = info.submittedNs;
+        mInFlight.pop_front();
+
+        std::lock_guard<std::mutex> lock(mLock);
+        std::swap(mReady, mDecoded);
+        mReadyIsNew = true;
+        mStats.framesDecoded++;
+        mStats.decodeMs = (decoded - startNs) / 1e6;
+        mStats.convertMs = (now - decoded) / 1e6;
+        mStats.latencyMs = smooth(mStats.latencyMs, (now - submittedNs) / 1e6);
+    }
+#else
+    (void)startNs;
+#endif
+}
+
+} // namespace al